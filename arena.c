@@ -0,0 +1,141 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * arena module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_CHUNK (16 * 1024)  /* Minimum chunk size */
+#define ARENA_ALIGN 16           /* Alignment of every allocation */
+
+/**
+ * Allocator counters. malloc() and friends are interposed here and forward
+ * to the glibc implementation, so every allocation of the process is
+ * counted, including the ones made inside the C library (stdio, strdup,
+ * posix_spawn file actions...).
+ **/
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t n, size_t size);
+extern void * __libc_realloc(void * ptr, size_t size);
+extern void __libc_free(void * ptr);
+
+static alloc_stats counters;
+
+#define count(field)  __atomic_fetch_add(&counters.field, 1, __ATOMIC_RELAXED)
+
+void * malloc(size_t size)
+{
+	count(mallocs);
+	return __libc_malloc(size);
+}
+
+void * calloc(size_t n, size_t size)
+{
+	count(mallocs);
+	return __libc_calloc(n, size);
+}
+
+void * realloc(void * ptr, size_t size)
+{
+	count(reallocs);
+	return __libc_realloc(ptr, size);
+}
+
+void free(void * ptr)
+{
+	if (ptr) count(frees);
+	__libc_free(ptr);
+}
+
+const alloc_stats * get_alloc_stats(void)
+{
+	return &counters;
+}
+
+/**
+ * Returns size bytes aligned to ARENA_ALIGN, valid until the next
+ * arena_reset(). Chunks kept from earlier commands are reused before new
+ * ones are allocated.
+ * Returns NULL if memory allocation fails.
+ **/
+void * arena_alloc(arena * a, size_t size)
+{
+	arena_chunk * chunk = a->current;
+	void * ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+	while (chunk && chunk->size - chunk->used < size)
+	{
+		chunk = chunk->next;
+		if (chunk) chunk->used = 0; /* Kept from a previous command */
+	}
+	if (!chunk)
+	{
+		size_t chunk_size = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+		chunk = (arena_chunk *) malloc(sizeof(arena_chunk) + chunk_size);
+		if (!chunk) return NULL;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = NULL;
+		if (a->current)
+		{
+			/* Append after the last chunk */
+			arena_chunk * last = a->current;
+			while (last->next) last = last->next;
+			last->next = chunk;
+		}
+		else
+		{
+			a->first = chunk;
+		}
+		a->capacity += chunk_size;
+	}
+	a->current = chunk;
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+/**
+ * Copies str into the arena
+ **/
+char * arena_strdup(arena * a, const char * str)
+{
+	size_t len = strlen(str) + 1;
+	char * copy = (char *) arena_alloc(a, len);
+	if (copy) memcpy(copy, str, len);
+	return copy;
+}
+
+/**
+ * Releases everything allocated since the previous reset in one step. The
+ * chunks are kept for the next command.
+ **/
+void arena_reset(arena * a)
+{
+	a->current = a->first;
+	if (a->first) a->first->used = 0;
+}
+
+/**
+ * Returns the chunks of the arena to the C allocator
+ **/
+void arena_release(arena * a)
+{
+	while (a->first)
+	{
+		arena_chunk * next = a->first->next;
+		free(a->first);
+		a->first = next;
+	}
+	a->current = NULL;
+	a->capacity = 0;
+}
@@ -0,0 +1,64 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the arena module
+ *
+ * An arena hands out memory for everything parsed from one command line
+ * (pipeline stages, pid arrays, job labels...) by bumping a pointer, and
+ * releases all of it at once with arena_reset(). Its chunks are kept for
+ * the next command, so the command loop stops calling malloc() once the
+ * arena has grown to the size of the largest command.
+ *
+ * The module also counts the calls to the C allocator of the whole shell.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+/* Block of arena memory */
+typedef struct arena_chunk_
+{
+	struct arena_chunk_ * next;
+	size_t size;               /* Bytes in data */
+	size_t used;               /* Bytes handed out since the last reset */
+	char data[];
+} arena_chunk;
+
+/* Arena: chunks in allocation order, current is the one being filled */
+typedef struct arena_
+{
+	arena_chunk * first;
+	arena_chunk * current;
+	size_t capacity;           /* Total bytes of all chunks */
+} arena;
+
+/* Calls to the C allocator since the shell started */
+typedef struct alloc_stats_
+{
+	unsigned long mallocs;     /* malloc() and calloc() */
+	unsigned long reallocs;
+	unsigned long frees;       /* free() of non NULL pointers */
+} alloc_stats;
+
+/**
+ * Public Functions
+ **/
+void * arena_alloc(arena * a, size_t size);
+char * arena_strdup(arena * a, const char * str);
+void arena_reset(arena * a);
+void arena_release(arena * a);
+const alloc_stats * get_alloc_stats(void);
+
+/**
+ * Public macros
+ **/
+#define ARENA_INITIALIZER  { NULL, NULL, 0 }
+#define arena_new(a, type, n)  ((type *) arena_alloc((a), (n) * sizeof(type)))
+
+#endif
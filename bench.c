@@ -0,0 +1,298 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Benchmarks for the shell internals
+ *
+ * - parse: get_command() + parse_redirections() + parse_pipeline() on
+ *   generated command lines.
+ * - job table: add_job, get_item_bypid, get_item_bypos and delete_job with
+ *   10 to 100k jobs. The cost per operation must stay flat as it grows.
+ * - reap: one SIGCHLD sweep (reap_children() and applying the events to
+ *   their jobs) with 0 to 256 children changed.
+ * - spawn: launch + wait latency of /bin/true with every spawn backend.
+ *
+ * Every benchmark takes many samples (single operations or small batches,
+ * in ns per operation) and prints mean and percentiles, as CSV by default or
+ * as JSON with -j, so results can be compared from one build to the next.
+ *
+ * To compile and run:
+ *   $ make bench
+ *   $ ./bench [-j] [-q]     (-j: JSON output, -q: quick run with fewer samples)
+ **/
+#define _GNU_SOURCE
+#include <time.h>
+#include "job_control.h"
+#include "spawn_engine.h"
+
+#define BATCH 64 /* Fast operations are timed in batches, clock_gettime() costs ~20 ns */
+
+static int json = 0;         /* Output format */
+static int quick = 0;        /* Fewer samples */
+static int results = 0;      /* Results printed so far */
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_samples(const void * a, const void * b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Prints one result: the distribution of n samples (ns per operation) of
+ * benchmark name with parameter param. Sorts the samples.
+ **/
+static void report(const char * name, long param, double * samples, int n)
+{
+	double sum = 0;
+	int i;
+
+	if (n == 0) return;
+	qsort(samples, n, sizeof(double), compare_samples);
+	for (i = 0; i < n; i++) sum += samples[i];
+#define pct(q) samples[(int) ((q) * (n - 1))]
+	if (json)
+	{
+		printf("%s\n  {\"benchmark\": \"%s\", \"param\": %ld, \"samples\": %d, \"mean_ns\": %.1f, "
+			"\"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f}",
+			results ? "," : "[", name, param, n, sum / n, pct(0.5), pct(0.9), pct(0.99), samples[n - 1]);
+	}
+	else
+	{
+		if (!results) printf("benchmark,param,samples,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+		printf("%s,%ld,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+			name, param, n, sum / n, pct(0.5), pct(0.9), pct(0.99), samples[n - 1]);
+	}
+#undef pct
+	results++;
+	fflush(stdout);
+}
+
+/**
+ * Parses n generated command lines, mixing arguments, redirections,
+ * pipelines, comments and background marks. Samples are batches of BATCH
+ * lines.
+ **/
+static void bench_parse(int n)
+{
+	static const char * templates[] = {
+		"ls -l /usr/bin\n",
+		"grep -n pattern file1.txt file2.txt file3.txt > out.txt &\n",
+		"cat < input.txt | sort -r | uniq -c | head -n 20 >> log.txt\n",
+		"make -j8 CFLAGS=-O2 all install # build everything\n",
+		"echo a b c d e f g h i j k l m n o p q r s t u v w x y z\n",
+	};
+	int num_templates = sizeof(templates) / sizeof(templates[0]);
+	int num_samples = n / BATCH, i, j;
+	double * samples = (double *) malloc(num_samples * sizeof(double));
+	size_t size = 0;
+	char * text, * p;
+	command_reader reader;
+
+	for (i = 0; i < n; i++) size += strlen(templates[i % num_templates]);
+	text = (char *) malloc(size + 1);
+	for (p = text, i = 0; i < n; i++) p = stpcpy(p, templates[i % num_templates]);
+	init_string_reader(&reader, text);
+	free(text);
+
+	for (i = 0; i < num_samples; i++)
+	{
+		long long start = now_ns();
+		for (j = 0; j < BATCH; j++)
+		{
+			char ** stages[64];
+			redirection redirections[16];
+			int background;
+			char ** args = get_command(&reader, &background);
+			parse_redirections(args, redirections, 16);
+			parse_pipeline(args, stages, 64);
+		}
+		samples[i] = (double) (now_ns() - start) / BATCH;
+	}
+	report("parse_line", n, samples, num_samples);
+	free(samples);
+}
+
+/**
+ * Runs every job table operation n times on a table holding n jobs.
+ * Samples are batches of BATCH operations (or one batch if n is smaller);
+ * small tables are filled and emptied several times to get enough samples.
+ **/
+static void bench_job_table(int n)
+{
+	job_list * list = new_list("Bench");
+	job ** items = (job **) malloc(n * sizeof(job *));
+	int batch = n < BATCH ? n : BATCH;
+	int per_round = n / batch;
+	int rounds = per_round >= 100 ? 1 : (100 + per_round - 1) / per_round;
+	int num_samples = 0, i, r, s;
+	double * samples[4];
+	volatile job * sink;
+
+	for (i = 0; i < 4; i++) samples[i] = (double *) malloc(rounds * per_round * sizeof(double));
+	srand(n);
+	for (r = 0; r < rounds; r++)
+	{
+		for (s = 0, i = 0; s < per_round; s++)
+		{
+			long long start = now_ns();
+			for (; i < (s + 1) * batch; i++)
+			{
+				items[i] = new_job(1000 + i, "bench", BACKGROUND);
+				add_job(list, items[i]);
+			}
+			samples[0][num_samples + s] = (double) (now_ns() - start) / batch;
+		}
+		for (; i < n; i++)
+		{
+			items[i] = new_job(1000 + i, "bench", BACKGROUND);
+			add_job(list, items[i]);
+		}
+
+		for (s = 0; s < per_round; s++)
+		{
+			long long start = now_ns();
+			for (i = 0; i < batch; i++) sink = get_item_bypid(list, 1000 + rand() % n);
+			samples[1][num_samples + s] = (double) (now_ns() - start) / batch;
+		}
+
+		for (s = 0; s < per_round; s++)
+		{
+			long long start = now_ns();
+			for (i = 0; i < batch; i++) sink = get_item_bypos(list, 1 + rand() % n);
+			samples[2][num_samples + s] = (double) (now_ns() - start) / batch;
+		}
+
+		/* Delete in random order, as jobs finish */
+		for (i = n - 1; i > 0; i--)
+		{
+			int j = rand() % (i + 1);
+			job * aux = items[i];
+			items[i] = items[j];
+			items[j] = aux;
+		}
+		for (s = 0, i = 0; s < per_round; s++)
+		{
+			long long start = now_ns();
+			for (; i < (s + 1) * batch; i++) delete_job(list, items[i]);
+			samples[3][num_samples + s] = (double) (now_ns() - start) / batch;
+		}
+		for (; i < n; i++) delete_job(list, items[i]);
+		num_samples += per_round;
+	}
+	(void) sink;
+
+	report("add_job", n, samples[0], num_samples);
+	report("get_item_bypid", n, samples[1], num_samples);
+	report("get_item_bypos", n, samples[2], num_samples);
+	report("delete_job", n, samples[3], num_samples);
+	for (i = 0; i < 4; i++) free(samples[i]);
+	free(items);
+}
+
+/**
+ * Cost of one SIGCHLD sweep when children processes have finished: reaps
+ * them with reap_children() and applies the events to their jobs, as the
+ * shell does in update_jobs(). With children = 0 it is the cost of a
+ * spurious wake-up. The children are zombies before the clock starts.
+ **/
+static void bench_reap(int children, int rounds)
+{
+	job_list * list = new_list("Bench");
+	double * samples = (double *) malloc(rounds * sizeof(double));
+	job ** items = (job **) malloc((children + 1) * sizeof(job *));
+	int r, i;
+
+	for (r = 0; r < rounds; r++)
+	{
+		long long start;
+		pid_t pid;
+		int status;
+		job_usage usage;
+
+		for (i = 0; i < children; i++)
+		{
+			pid = fork();
+			if (pid == 0) _exit(0);
+			items[i] = new_job(pid, "bench", BACKGROUND);
+			add_job(list, items[i]);
+		}
+		for (i = 0; i < children; i++)
+		{
+			siginfo_t info;
+			waitid(P_PID, items[i]->pgid, &info, WEXITED | WNOWAIT);
+		}
+
+		start = now_ns();
+		reap_children();
+		while (pop_child_event(&pid, &status, &usage))
+		{
+			job * item = apply_child_event(pid, status, &usage);
+			if (item && item->nprocs == 0) delete_job(list, item);
+		}
+		samples[r] = (double) (now_ns() - start);
+	}
+	report("reap_sweep", children, samples, rounds);
+	free(items);
+	free(samples);
+}
+
+/**
+ * Launch + wait latency of /bin/true with the given backend
+ **/
+static void bench_spawn(enum spawn_backend backend, int rounds)
+{
+	char * argv[] = { "/bin/true", NULL };
+	char name[64];
+	double * samples = (double *) malloc(rounds * sizeof(double));
+	spawn_request req;
+	int r;
+
+	set_spawn_backend(backend);
+	init_spawn_request(&req, argv, 1);
+	for (r = 0; r < rounds; r++)
+	{
+		long long start = now_ns();
+		pid_t pid = spawn_command(&req);
+		if (pid > 0) waitpid(pid, NULL, 0);
+		samples[r] = (double) (now_ns() - start);
+	}
+	snprintf(name, sizeof(name), "spawn_wait_%s", spawn_backend_name(backend));
+	report(name, 0, samples, rounds);
+	free(samples);
+}
+
+int main(int argc, char * argv[])
+{
+	int i, n;
+
+	spawn_zygote_main(argc, argv);
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-j")) json = 1;
+		else if (!strcmp(argv[i], "-q")) quick = 1;
+		else
+		{
+			fprintf(stderr, "usage: %s [-j] [-q]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	bench_parse(quick ? 20000 : 200000);
+	for (n = 10; n <= (quick ? 10000 : 100000); n *= 10) bench_job_table(n);
+	bench_reap(0, quick ? 100 : 1000);
+	for (n = 1; n <= 256; n *= 16) bench_reap(n, quick ? 10 : 50);
+	bench_spawn(SPAWN_FORK, quick ? 50 : 500);
+	bench_spawn(SPAWN_VFORK, quick ? 50 : 500);
+	bench_spawn(SPAWN_POSIX, quick ? 50 : 500);
+	bench_spawn(SPAWN_ZYGOTE, quick ? 50 : 500);
+
+	if (json) printf("\n]\n");
+	return 0;
+}
@@ -0,0 +1,281 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * builtin_registry module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "builtin_registry.h"
+
+#define BUILTIN_BUCKETS 64 /* Power of two */
+
+/* A registered builtin */
+typedef struct builtin_entry_
+{
+	builtin_definition def;        /* name and usage point into the entry or the library */
+	void * library;                /* dlopen() handle, NULL for the shell's own builtins */
+	char * file;                   /* Library it was loaded from */
+	int enabled;                   /* 0 after enable -n: the name runs the external command */
+	builtin_definition shadowed;   /* Shell builtin of the same name a library replaced */
+	int has_shadowed;
+	int id;                        /* Registration number, see builtin_id() */
+	struct builtin_entry_ * next;  /* Next entry in the same bucket */
+	struct builtin_entry_ * after; /* Next entry in registration order */
+} builtin_entry;
+
+static builtin_entry * buckets[BUILTIN_BUCKETS];
+static builtin_entry * first = NULL, * last = NULL;
+static builtin_entry ** by_id = NULL;  /* Entries by id, NULL for removed ones */
+static int num_ids = 0, max_ids = 0;
+static unsigned int generation = 0;    /* Changes of the table, see builtin_generation() */
+
+static unsigned int name_bucket(const char * name)
+{
+	unsigned int h = 2166136261u; /* FNV-1a */
+	while (*name) h = (h ^ (unsigned char) *name++) * 16777619u;
+	return h & (BUILTIN_BUCKETS - 1);
+}
+
+static builtin_entry * find_entry(const char * name)
+{
+	builtin_entry * entry = buckets[name_bucket(name)];
+	while (entry && strcmp(entry->def.name, name)) entry = entry->next;
+	return entry;
+}
+
+/**
+ * Adds def to the table, replacing a builtin with the same name (a library
+ * may override one of the shell's own). Returns 0 on success or -1.
+ **/
+static int add_entry(const builtin_definition * def, void * library, const char * file)
+{
+	builtin_entry * entry = find_entry(def->name);
+
+	if (entry)
+	{
+		if (entry->library) dlclose(entry->library);
+		else if (library)
+		{
+			entry->shadowed = entry->def; /* Back when the library is unloaded */
+			entry->has_shadowed = 1;
+		}
+		free(entry->file);
+	}
+	else
+	{
+		unsigned int b = name_bucket(def->name);
+		if (num_ids == max_ids)
+		{
+			int size = max_ids ? max_ids * 2 : 64;
+			builtin_entry ** aux = (builtin_entry **) realloc(by_id, size * sizeof(builtin_entry *));
+			if (!aux) return -1;
+			by_id = aux;
+			max_ids = size;
+		}
+		entry = (builtin_entry *) calloc(1, sizeof(builtin_entry));
+		if (!entry) return -1;
+		entry->id = num_ids;
+		by_id[num_ids++] = entry;
+		entry->next = buckets[b];
+		buckets[b] = entry;
+		if (last) last->after = entry;
+		else first = entry;
+		last = entry;
+	}
+	entry->def = *def;
+	entry->library = library;
+	entry->file = file ? strdup(file) : NULL;
+	entry->enabled = 1;
+	generation++;
+	return 0;
+}
+
+/**
+ * Registers one of the shell's own builtins. name and usage must outlive
+ * the registry (string literals).
+ * Returns 0 on success or -1.
+ **/
+int register_builtin(const char * name, builtin_function function, const char * usage)
+{
+	builtin_definition def = { BUILTIN_ABI_VERSION, name, function, usage };
+	return add_entry(&def, NULL, NULL);
+}
+
+/**
+ * Returns the enabled builtin called name, or NULL if name is not a builtin.
+ **/
+const builtin_definition * find_builtin(const char * name)
+{
+	builtin_entry * entry = find_entry(name);
+	return entry && entry->enabled ? &entry->def : NULL;
+}
+
+/**
+ * Returns the id of the enabled builtin called name, or -1 if name is not
+ * a builtin. Ids are given in registration order and never reused, so the
+ * shell's own builtins get the same ids in every run.
+ **/
+int builtin_id(const char * name)
+{
+	builtin_entry * entry = find_entry(name);
+	return entry && entry->enabled ? entry->id : -1;
+}
+
+/**
+ * Returns the enabled builtin with the given id, or NULL if there is none.
+ **/
+const builtin_definition * builtin_by_id(int id)
+{
+	builtin_entry * entry = id >= 0 && id < num_ids ? by_id[id] : NULL;
+	return entry && entry->enabled ? &entry->def : NULL;
+}
+
+/**
+ * Returns a number that changes whenever a builtin is registered, loaded,
+ * enabled, disabled or removed: ids resolved while it stays the same are
+ * still valid.
+ **/
+unsigned int builtin_generation(void)
+{
+	return generation;
+}
+
+/**
+ * Loads builtin name from the shared object file, which must export a
+ * builtin_definition called <name>_builtin. A file without '/' is searched
+ * as dlopen() does (LD_LIBRARY_PATH and the system directories).
+ * Returns 0 on success or -1 after printing the reason.
+ **/
+int load_builtin(const char * file, const char * name)
+{
+	char symbol[256];
+	const builtin_definition * def;
+	void * library;
+
+	if (snprintf(symbol, sizeof(symbol), "%s_builtin", name) >= (int) sizeof(symbol))
+	{
+		fprintf(stderr, "enable: %s: name too long\n", name);
+		return -1;
+	}
+	library = dlopen(file, RTLD_NOW | RTLD_LOCAL);
+	if (!library)
+	{
+		fprintf(stderr, "enable: %s\n", dlerror());
+		return -1;
+	}
+	def = (const builtin_definition *) dlsym(library, symbol);
+	if (!def)
+	{
+		fprintf(stderr, "enable: %s: %s not found\n", file, symbol);
+		dlclose(library);
+		return -1;
+	}
+	if (def->abi_version < 1 || def->abi_version > BUILTIN_ABI_VERSION || !def->function
+		|| !def->name || strcmp(def->name, name))
+	{
+		fprintf(stderr, "enable: %s: %s is not a valid builtin (ABI version %d, shell %d)\n",
+			file, symbol, def->abi_version, BUILTIN_ABI_VERSION);
+		dlclose(library);
+		return -1;
+	}
+	if (add_entry(def, library, file) == -1)
+	{
+		perror("enable");
+		dlclose(library);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Enables (on = 1) or disables (on = 0) builtin name. A disabled builtin is
+ * run as an external command.
+ * Returns 0 on success or -1 if name is not a builtin.
+ **/
+int enable_builtin(const char * name, int on)
+{
+	builtin_entry * entry = find_entry(name);
+	if (!entry) return -1;
+	entry->enabled = on;
+	generation++;
+	return 0;
+}
+
+/**
+ * Unloads a builtin loaded with load_builtin(). If it had replaced one of
+ * the shell's own builtins, that one is back; the shell's own builtins can
+ * only be disabled.
+ * Returns 0 on success or -1 if name was not loaded from a library.
+ **/
+int remove_builtin(const char * name)
+{
+	builtin_entry ** link = &buckets[name_bucket(name)], ** order = &first;
+	builtin_entry * entry, * prev = NULL;
+
+	while (*link && strcmp((*link)->def.name, name)) link = &(*link)->next;
+	entry = *link;
+	if (!entry || !entry->library) return -1;
+	if (entry->has_shadowed)
+	{
+		dlclose(entry->library);
+		free(entry->file);
+		entry->def = entry->shadowed; /* Same name, so the same bucket and id */
+		entry->library = NULL;
+		entry->file = NULL;
+		entry->has_shadowed = 0;
+		entry->enabled = 1;
+		generation++;
+		return 0;
+	}
+	*link = entry->next;
+	while (*order != entry)
+	{
+		prev = *order;
+		order = &prev->after;
+	}
+	*order = entry->after;
+	if (last == entry) last = prev;
+	by_id[entry->id] = NULL;
+	generation++;
+
+	dlclose(entry->library); /* One reference per load_builtin() */
+	free(entry->file);
+	free(entry);
+	return 0;
+}
+
+/**
+ * Calls function with the name of every enabled builtin, in registration
+ * order.
+ **/
+void for_each_builtin(void (*function)(const char * name))
+{
+	builtin_entry * entry;
+	for (entry = first; entry; entry = entry->after)
+	{
+		if (entry->enabled) function(entry->def.name);
+	}
+}
+
+/**
+ * Lists the builtins in registration order, with the library of the
+ * loaded ones.
+ **/
+void print_builtins(void)
+{
+	builtin_entry * entry;
+	for (entry = first; entry; entry = entry->after)
+	{
+		printf("%-10s %s%s%s%s\n", entry->def.name, entry->enabled ? "" : "(disabled) ",
+			entry->def.usage ? entry->def.usage : "", entry->file ? "  from " : "",
+			entry->file ? entry->file : "");
+	}
+}
@@ -0,0 +1,90 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the builtin_registry module
+ *
+ * Builtin commands are found by name in a hash table instead of a chain of
+ * string comparisons. Besides the shell's own builtins, more of them can be
+ * loaded at run time from shared objects (enable -f lib.so name), so a
+ * frequent command runs inside the shell without fork() and exec().
+ *
+ * This header is also the ABI for loadable builtins: a library exports a
+ * builtin_definition named <name>_builtin, and its function receives the
+ * arguments, the descriptors to use and read-only access to the job table
+ * through builtin_context. Only plain C types cross the boundary and new
+ * fields are only ever appended, so libraries built against an older
+ * version keep working; abi_version tells which fields they know about.
+ *
+ *     #include "builtin_registry.h"
+ *     static int hello(int argc, char ** argv, builtin_context * ctx)
+ *     {
+ *         dprintf(ctx->fd_out, "hello, %d jobs\n", ctx->job_count());
+ *         return 0;
+ *     }
+ *     builtin_definition hello_builtin = { BUILTIN_ABI_VERSION, "hello", hello, "hello" };
+ *
+ *     $ gcc -shared -fPIC hello.c -o hello.so
+ *     COMMAND->enable -f ./hello.so hello
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _BUILTIN_REGISTRY_H
+#define _BUILTIN_REGISTRY_H
+
+#define BUILTIN_ABI_VERSION 1
+
+/* Job states seen by builtins (same values as enum job_state) */
+enum builtin_job_state { BUILTIN_JOB_FOREGROUND, BUILTIN_JOB_BACKGROUND, BUILTIN_JOB_STOPPED };
+
+/* Copy of a job of the job table */
+typedef struct builtin_job_
+{
+	int pgid;                /* Process group of the job */
+	int state;               /* enum builtin_job_state */
+	int nprocs;              /* Processes still alive */
+	const char * command;    /* Valid until the job finishes */
+	long long start_ns;      /* CLOCK_MONOTONIC launch time */
+} builtin_job;
+
+/* What the shell hands to a builtin */
+typedef struct builtin_context_
+{
+	int abi_version;         /* BUILTIN_ABI_VERSION of the shell */
+	int fd_in;               /* Descriptors to use, redirections already applied */
+	int fd_out;
+	int fd_err;
+	int background;          /* 1 if the command ended with '&' */
+	int (*job_count)(void);                    /* Jobs in the job table */
+	int (*get_job)(int pos, builtin_job * out); /* Job at position pos (1 = current), 0 if none */
+} builtin_context;
+
+/* Runs the builtin, returns its exit status */
+typedef int (*builtin_function)(int argc, char ** argv, builtin_context * ctx);
+
+/* A builtin: what a library exports as <name>_builtin */
+typedef struct builtin_definition_
+{
+	int abi_version;         /* BUILTIN_ABI_VERSION the library was built with */
+	const char * name;
+	builtin_function function;
+	const char * usage;      /* One line, listed by enable */
+} builtin_definition;
+
+/**
+ * Public Functions (shell side)
+ **/
+int register_builtin(const char * name, builtin_function function, const char * usage);
+const builtin_definition * find_builtin(const char * name);
+int builtin_id(const char * name);
+const builtin_definition * builtin_by_id(int id);
+unsigned int builtin_generation(void);
+int load_builtin(const char * file, const char * name);
+int enable_builtin(const char * name, int on);
+int remove_builtin(const char * name);
+void print_builtins(void);
+void for_each_builtin(void (*function)(const char * name));
+
+#endif
@@ -0,0 +1,234 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * child_inventory module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "child_inventory.h"
+
+#define INVENTORY_BUFFER (64 * 1024) /* Read size for children lists and directories */
+
+/* Record returned by getdents64 (not exported by glibc headers) */
+struct linux_dirent64
+{
+	unsigned long long d_ino;
+	long long d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+/**
+ * Appends a child to the growing array
+ **/
+static int push_child(child_info ** list, int * count, int * size, const child_info * item)
+{
+	if (*count == *size)
+	{
+		int new_size = *size ? *size * 2 : 64;
+		child_info * aux = (child_info *) realloc(*list, new_size * sizeof(child_info));
+		if (!aux) return 0;
+		*list = aux;
+		*size = new_size;
+	}
+	(*list)[(*count)++] = *item;
+	return 1;
+}
+
+/**
+ * Reads /proc/<pid>/stat with a single read() and extracts the command name,
+ * state and parent pid. The command name is between the first '(' and the
+ * last ')', as it may contain spaces or parentheses.
+ * Returns 0 if the process is gone or the file cannot be parsed.
+ **/
+static int read_stat(pid_t pid, child_info * item, pid_t * ppid)
+{
+	char path[64], buff[512];
+	char *open_paren, *close_paren;
+	int fd, n, len;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) return 0;
+	n = read(fd, buff, sizeof(buff) - 1);
+	close(fd);
+	if (n <= 0) return 0;
+	buff[n] = '\0';
+
+	open_paren = strchr(buff, '(');
+	close_paren = strrchr(buff, ')');
+	if (!open_paren || !close_paren || close_paren < open_paren || close_paren[1] != ' ') return 0;
+
+	len = close_paren - open_paren - 1;
+	if (len >= CHILD_COMM_LEN) len = CHILD_COMM_LEN - 1;
+	memcpy(item->comm, open_paren + 1, len);
+	item->comm[len] = '\0';
+	item->pid = pid;
+	item->state = close_paren[2];
+	*ppid = (pid_t) strtol(close_paren + 3, NULL, 10);
+	return 1;
+}
+
+/**
+ * Reads the space separated pid list of /proc/self/task/<tid>/children for
+ * every thread of the shell.
+ * Returns 0 if the kernel does not provide the children files.
+ **/
+static int children_from_task(child_info ** list, int * count, int * size)
+{
+	char path[64];
+	char * buff;
+	int dir_fd, found = 0, n;
+
+	dir_fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir_fd == -1) return 0;
+	buff = (char *) malloc(INVENTORY_BUFFER + 1);
+	if (!buff)
+	{
+		close(dir_fd);
+		return 0;
+	}
+
+	/* The shell has a single thread, but walk them all for correctness */
+	char dents[4096];
+	while ((n = syscall(SYS_getdents64, dir_fd, dents, sizeof(dents))) > 0)
+	{
+		int pos = 0;
+		while (pos < n)
+		{
+			struct linux_dirent64 * d = (struct linux_dirent64 *) (dents + pos);
+			pos += d->d_reclen;
+			if (d->d_name[0] < '0' || d->d_name[0] > '9') continue;
+
+			snprintf(path, sizeof(path), "/proc/self/task/%s/children", d->d_name);
+			int fd = open(path, O_RDONLY | O_CLOEXEC);
+			if (fd == -1) continue;
+			found = 1;
+
+			/* The list may exceed the buffer: keep an incomplete pid for the next read */
+			int len = 0, r;
+			while ((r = read(fd, buff + len, INVENTORY_BUFFER - len)) > 0)
+			{
+				char *p = buff, *end = buff + len + r;
+				while (p < end)
+				{
+					char * start = p;
+					while (p < end && *p >= '0' && *p <= '9') p++;
+					if (p == end)
+					{
+						p = start; /* Pid may continue in the next read */
+						break;
+					}
+					if (p > start)
+					{
+						child_info item;
+						pid_t ppid;
+						if (read_stat((pid_t) strtol(start, NULL, 10), &item, &ppid))
+							push_child(list, count, size, &item);
+					}
+					p++;
+				}
+				len = end - p;
+				memmove(buff, p, len);
+			}
+			if (len > 0)
+			{
+				child_info item;
+				pid_t ppid;
+				buff[len] = '\0';
+				if (read_stat((pid_t) strtol(buff, NULL, 10), &item, &ppid))
+					push_child(list, count, size, &item);
+			}
+			close(fd);
+		}
+	}
+	free(buff);
+	close(dir_fd);
+	return found;
+}
+
+/**
+ * Fallback when the children files are not available: walks /proc with
+ * large getdents64() buffers and keeps the processes whose parent is the
+ * shell.
+ **/
+static void children_from_proc(child_info ** list, int * count, int * size)
+{
+	pid_t self = getpid();
+	char * dents;
+	int dir_fd, n;
+
+	dir_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir_fd == -1)
+	{
+		perror("Failed to open the /proc directory");
+		return;
+	}
+	dents = (char *) malloc(INVENTORY_BUFFER);
+	if (!dents)
+	{
+		close(dir_fd);
+		return;
+	}
+	while ((n = syscall(SYS_getdents64, dir_fd, dents, INVENTORY_BUFFER)) > 0)
+	{
+		int pos = 0;
+		while (pos < n)
+		{
+			struct linux_dirent64 * d = (struct linux_dirent64 *) (dents + pos);
+			child_info item;
+			pid_t ppid;
+			pos += d->d_reclen;
+			if (d->d_type != DT_DIR || d->d_name[0] < '0' || d->d_name[0] > '9') continue;
+			if (read_stat((pid_t) strtol(d->d_name, NULL, 10), &item, &ppid) && ppid == self)
+				push_child(list, count, size, &item);
+		}
+	}
+	free(dents);
+	close(dir_fd);
+}
+
+/**
+ * Returns an array with the children of the shell and their state, and
+ * stores its length in *count. The caller frees the array.
+ * Returns NULL (with *count = 0) if the shell has no children.
+ **/
+child_info * get_children(int * count)
+{
+	child_info * list = NULL;
+	int size = 0;
+	*count = 0;
+	if (!children_from_task(&list, count, &size)) children_from_proc(&list, count, &size);
+	return list;
+}
+
+/**
+ * Returns a readable name for a /proc state letter
+ **/
+const char * child_state_name(char state)
+{
+	switch (state)
+	{
+	case 'R': return "Running";
+	case 'S': return "Sleeping";
+	case 'D': return "Disk sleep";
+	case 'T': return "Stopped";
+	case 't': return "Traced";
+	case 'Z': return "Zombie";
+	case 'X': return "Dead";
+	case 'I': return "Idle";
+	default: return "Unknown";
+	}
+}
@@ -0,0 +1,37 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the child_inventory module
+ *
+ * Lists the children of the shell with their state without looking at the
+ * other processes of the system: the pids come from
+ * /proc/self/task/<tid>/children and only their stat files are read, using
+ * plain read() on large buffers instead of stdio.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _CHILD_INVENTORY_H
+#define _CHILD_INVENTORY_H
+
+#include <sys/types.h>
+
+#define CHILD_COMM_LEN 64 /* Longer command names are truncated */
+
+/* A child of the shell */
+typedef struct child_info_
+{
+	pid_t pid;
+	char state;                  /* R (running), S (sleeping), T (stopped), Z (zombie)... */
+	char comm[CHILD_COMM_LEN];   /* Command name */
+} child_info;
+
+/**
+ * Public Functions
+ **/
+child_info * get_children(int * count);
+const char * child_state_name(char state);
+
+#endif
@@ -0,0 +1,521 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * completion module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "completion.h"
+
+#define DIR_BUFFER (64 * 1024) /* getdents64() buffer */
+#define LISTING_CACHE 16       /* Directory listings kept for file completion */
+
+/* Record returned by getdents64 (not exported by glibc headers) */
+struct linux_dirent64
+{
+	unsigned long long d_ino;
+	long long d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+/* Trie node: children are chained through sibling, 0 = none (node 0 is the root) */
+typedef struct trie_node_
+{
+	unsigned int child, sibling;
+	char c;
+	char end;          /* A name ends here */
+} trie_node;
+
+typedef struct trie_
+{
+	trie_node * nodes;
+	unsigned int count, size;
+} trie;
+
+/* Executables of a PATH directory */
+typedef struct path_trie_
+{
+	char * dir;
+	int exists;
+	struct timespec mtime;   /* When it was read */
+	trie names;
+} path_trie;
+
+/* Cached listing of a directory, names sorted and directories ending in '/' */
+typedef struct dir_listing_
+{
+	dev_t dev;               /* Found by identity, relative names change with the directory */
+	ino_t ino;
+	struct timespec mtime;
+	char ** names;
+	int count;
+	char * strings;
+	unsigned long last_use;
+} dir_listing;
+
+static path_trie * path_tries = NULL;
+static int num_path_tries = 0;
+static char * indexed_path = NULL;  /* PATH the tries were made for */
+static trie builtins;
+static pthread_t index_thread;
+static int index_running = 0;       /* The first build has not been joined yet */
+
+static dir_listing listings[LISTING_CACHE];
+static unsigned long use_clock = 0;
+
+static int is_dot_entry(const char * name)
+{
+	return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+static int same_time(const struct timespec * a, const struct timespec * b)
+{
+	return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+/**
+ * Adds name to t. Returns 0 on success or -1 if there is no memory.
+ **/
+static int trie_insert(trie * t, const char * name)
+{
+	unsigned int node = 0, i;
+
+	if (!t->nodes)
+	{
+		t->nodes = (trie_node *) calloc(64, sizeof(trie_node));
+		if (!t->nodes) return -1;
+		t->size = 64;
+		t->count = 1;
+	}
+	for (; *name; name++)
+	{
+		for (i = t->nodes[node].child; i && t->nodes[i].c != *name; i = t->nodes[i].sibling);
+		if (!i)
+		{
+			if (t->count == t->size)
+			{
+				trie_node * aux = (trie_node *) realloc(t->nodes, t->size * 2 * sizeof(trie_node));
+				if (!aux) return -1;
+				t->nodes = aux;
+				t->size *= 2;
+			}
+			i = t->count++;
+			t->nodes[i].c = *name;
+			t->nodes[i].end = 0;
+			t->nodes[i].child = 0;
+			t->nodes[i].sibling = t->nodes[node].child;
+			t->nodes[node].child = i;
+		}
+		node = i;
+	}
+	t->nodes[node].end = 1;
+	return 0;
+}
+
+static void trie_free(trie * t)
+{
+	free(t->nodes);
+	t->nodes = NULL;
+	t->count = t->size = 0;
+}
+
+/**
+ * Adds the names under node to out, completing the length bytes of buff.
+ **/
+static void trie_collect(const trie * t, unsigned int node, char * buff, size_t length, completions * out)
+{
+	unsigned int i;
+
+	if (t->nodes[node].end) add_completion(out, buff, length, "");
+	if (length + 1 >= PATH_MAX) return;
+	for (i = t->nodes[node].child; i; i = t->nodes[i].sibling)
+	{
+		buff[length] = t->nodes[i].c;
+		trie_collect(t, i, buff, length + 1, out);
+	}
+}
+
+/**
+ * Adds the names of t starting with prefix to out.
+ **/
+static void trie_complete(const trie * t, const char * prefix, completions * out)
+{
+	char buff[PATH_MAX];
+	size_t length = strlen(prefix);
+	unsigned int node = 0, i;
+	const char * p;
+
+	if (!t->nodes || length >= PATH_MAX) return;
+	for (p = prefix; *p; p++)
+	{
+		for (i = t->nodes[node].child; i && t->nodes[i].c != *p; i = t->nodes[i].sibling);
+		if (!i) return;
+		node = i;
+	}
+	memcpy(buff, prefix, length);
+	trie_collect(t, node, buff, length, out);
+}
+
+/**
+ * Reads the executables of a PATH directory into its trie. Subdirectories
+ * are left out, as execvp() does not run them.
+ **/
+static void read_commands(path_trie * p)
+{
+	struct stat st;
+	char * buffer;
+	long n;
+	int fd;
+
+	trie_free(&p->names);
+	p->exists = 0;
+	fd = open(p->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1) return;
+	buffer = (char *) malloc(DIR_BUFFER);
+	if (!buffer || fstat(fd, &st) == -1)
+	{
+		free(buffer);
+		close(fd);
+		return;
+	}
+	p->exists = 1;
+	p->mtime = st.st_mtim; /* Before reading: a change meanwhile is seen next time */
+
+	while ((n = syscall(SYS_getdents64, fd, buffer, DIR_BUFFER)) > 0)
+	{
+		long pos = 0;
+		while (pos < n)
+		{
+			struct linux_dirent64 * d = (struct linux_dirent64 *) (buffer + pos);
+			pos += d->d_reclen;
+			if (is_dot_entry(d->d_name) || d->d_type == DT_DIR) continue;
+			if (faccessat(fd, d->d_name, X_OK, 0) == -1) continue;
+			if (d->d_type != DT_REG && (fstatat(fd, d->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode))) continue;
+			trie_insert(&p->names, d->d_name);
+		}
+	}
+	free(buffer);
+	close(fd);
+}
+
+/**
+ * Splits path into the directories to index, as execvp() searches them.
+ **/
+static void snapshot_commands(const char * path)
+{
+	const char * p;
+	int i;
+
+	for (i = 0; i < num_path_tries; i++)
+	{
+		free(path_tries[i].dir);
+		trie_free(&path_tries[i].names);
+	}
+	free(path_tries);
+	free(indexed_path);
+	num_path_tries = 0;
+	indexed_path = strdup(path);
+	for (p = path, i = 1; *p; p++) if (*p == ':') i++;
+	path_tries = (path_trie *) calloc(i, sizeof(path_trie));
+	if (!path_tries || !indexed_path) return;
+
+	p = path;
+	while (1)
+	{
+		const char * end = strchrnul(p, ':');
+		path_tries[num_path_tries].dir = end == p ? strdup(".") : strndup(p, end - p);
+		if (path_tries[num_path_tries].dir) num_path_tries++;
+		if (!*end) break;
+		p = end + 1;
+	}
+}
+
+static void * index_commands(void * arg)
+{
+	int i;
+	for (i = 0; i < num_path_tries; i++) read_commands(&path_tries[i]);
+	return NULL;
+}
+
+/**
+ * Starts building the command tries of PATH in a background thread, so the
+ * first completion finds them ready.
+ **/
+void start_command_index(void)
+{
+	const char * path = getenv("PATH");
+
+	snapshot_commands(path ? path : "");
+	if (pthread_create(&index_thread, NULL, index_commands, NULL) == 0) index_running = 1;
+	else index_commands(NULL);
+}
+
+/**
+ * Makes the tries current: waits for the first build, rebuilds them all
+ * for a new PATH and reads again only the directories modified since.
+ **/
+static void refresh_commands(void)
+{
+	const char * path = getenv("PATH");
+	int i;
+
+	if (index_running)
+	{
+		pthread_join(index_thread, NULL);
+		index_running = 0;
+	}
+	if (!path) path = "";
+	if (!indexed_path || strcmp(path, indexed_path))
+	{
+		snapshot_commands(path);
+		index_commands(NULL);
+		return;
+	}
+	for (i = 0; i < num_path_tries; i++)
+	{
+		struct stat st;
+		int exists = stat(path_tries[i].dir, &st) == 0;
+		if (exists != path_tries[i].exists || (exists && !same_time(&st.st_mtim, &path_tries[i].mtime)))
+			read_commands(&path_tries[i]);
+	}
+}
+
+/**
+ * Adds a command that is not in PATH (a builtin) to command completion.
+ **/
+void add_command_name(const char * name)
+{
+	trie_insert(&builtins, name);
+}
+
+/**
+ * Fills out with the commands (builtins and executables in PATH) starting
+ * with prefix. Returns the number of candidates.
+ **/
+int complete_command(const char * prefix, completions * out)
+{
+	int i;
+
+	refresh_commands();
+	trie_complete(&builtins, prefix, out);
+	for (i = 0; i < num_path_tries; i++) trie_complete(&path_tries[i].names, prefix, out);
+	sort_completions(out);
+	return out->count;
+}
+
+static int compare_names(const void * a, const void * b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/**
+ * Reads directory fd into listing l: the names in a single block of
+ * strings, subdirectories (also through symbolic links) with a '/' added.
+ * Returns 0 on success or -1.
+ **/
+static int read_listing(dir_listing * l, int fd)
+{
+	char * buffer = (char *) malloc(DIR_BUFFER), * strings = NULL;
+	size_t used = 0, size = 0;
+	long n;
+	int count = 0, i;
+
+	if (!buffer) return -1;
+	while ((n = syscall(SYS_getdents64, fd, buffer, DIR_BUFFER)) > 0)
+	{
+		long pos = 0;
+		while (pos < n)
+		{
+			struct linux_dirent64 * d = (struct linux_dirent64 *) (buffer + pos);
+			size_t length = strlen(d->d_name);
+			int is_dir = d->d_type == DT_DIR;
+			struct stat st;
+			pos += d->d_reclen;
+			if (is_dot_entry(d->d_name)) continue;
+			if ((d->d_type == DT_LNK || d->d_type == DT_UNKNOWN) && fstatat(fd, d->d_name, &st, 0) == 0)
+				is_dir = S_ISDIR(st.st_mode);
+			if (used + length + 2 > size)
+			{
+				char * aux = (char *) realloc(strings, size ? size * 2 : DIR_BUFFER);
+				if (!aux) break;
+				strings = aux;
+				size = size ? size * 2 : DIR_BUFFER;
+			}
+			memcpy(strings + used, d->d_name, length);
+			used += length;
+			if (is_dir) strings[used++] = '/';
+			strings[used++] = '\0';
+			count++;
+		}
+	}
+	free(buffer);
+
+	l->names = (char **) malloc((count ? count : 1) * sizeof(char *));
+	if (!l->names)
+	{
+		free(strings);
+		return -1;
+	}
+	for (i = 0, used = 0; i < count; i++)
+	{
+		l->names[i] = strings + used;
+		used += strlen(strings + used) + 1;
+	}
+	qsort(l->names, count, sizeof(char *), compare_names);
+	l->strings = strings;
+	l->count = count;
+	return 0;
+}
+
+/**
+ * Returns the listing of directory dir, from the cache while its
+ * modification time is the same, or NULL if it cannot be read.
+ **/
+static dir_listing * get_listing(const char * dir)
+{
+	dir_listing * l = NULL;
+	struct stat st;
+	int i, fd;
+
+	if (stat(dir, &st) == -1 || !S_ISDIR(st.st_mode)) return NULL;
+	for (i = 0; i < LISTING_CACHE; i++)
+	{
+		if (listings[i].names && listings[i].dev == st.st_dev && listings[i].ino == st.st_ino)
+		{
+			l = &listings[i];
+			break;
+		}
+		if (!l || listings[i].last_use < l->last_use) l = &listings[i]; /* Least recently used */
+	}
+	l->last_use = ++use_clock;
+	if (l->names && l->dev == st.st_dev && l->ino == st.st_ino && same_time(&l->mtime, &st.st_mtim))
+		return l;
+
+	free(l->names);
+	free(l->strings);
+	l->names = NULL;
+	l->strings = NULL;
+	fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1) return NULL;
+	if (read_listing(l, fd) == -1)
+	{
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+	l->dev = st.st_dev;
+	l->ino = st.st_ino;
+	l->mtime = st.st_mtim;
+	return l;
+}
+
+/**
+ * Fills out with the files completing word, a path whose last component
+ * is incomplete. Hidden files are only offered for a component starting
+ * with '.'. Returns the number of candidates.
+ **/
+int complete_file(const char * word, completions * out)
+{
+	const char * slash = strrchr(word, '/');
+	const char * base = slash ? slash + 1 : word;
+	size_t dir_length = slash ? (size_t) (slash - word + 1) : 0, base_length = strlen(base);
+	char dir[PATH_MAX], candidate[PATH_MAX];
+	dir_listing * l;
+	int low, high;
+
+	if (dir_length >= sizeof(dir)) return 0;
+	if (!slash) strcpy(dir, ".");
+	else
+	{
+		memcpy(dir, word, dir_length);
+		dir[dir_length] = '\0';
+	}
+	l = get_listing(dir);
+	if (!l) return 0;
+
+	/* First name not below base, then every name starting with it */
+	low = 0;
+	high = l->count;
+	while (low < high)
+	{
+		int mid = low + (high - low) / 2;
+		if (strcmp(l->names[mid], base) < 0) low = mid + 1;
+		else high = mid;
+	}
+	for (; low < l->count && !strncmp(l->names[low], base, base_length); low++)
+	{
+		if (l->names[low][0] == '.' && base[0] != '.') continue;
+		if (dir_length + strlen(l->names[low]) >= sizeof(candidate)) continue;
+		memcpy(candidate, word, dir_length);
+		strcpy(candidate + dir_length, l->names[low]);
+		add_completion(out, candidate, strlen(candidate), "");
+	}
+	return out->count;
+}
+
+/**
+ * Adds the first length bytes of name, followed by suffix, to out.
+ * Returns 0 on success or -1 if there is no memory.
+ **/
+int add_completion(completions * out, const char * name, size_t length, const char * suffix)
+{
+	size_t suffix_length = strlen(suffix);
+	char * copy;
+
+	if (out->count == out->size)
+	{
+		int size = out->size ? out->size * 2 : 64;
+		char ** aux = (char **) realloc(out->names, size * sizeof(char *));
+		if (!aux) return -1;
+		out->names = aux;
+		out->size = size;
+	}
+	copy = (char *) malloc(length + suffix_length + 1);
+	if (!copy) return -1;
+	memcpy(copy, name, length);
+	memcpy(copy + length, suffix, suffix_length + 1);
+	out->names[out->count++] = copy;
+	return 0;
+}
+
+/**
+ * Sorts the candidates and removes the repeated ones (a command in several
+ * PATH directories).
+ **/
+void sort_completions(completions * out)
+{
+	int i, kept = 0;
+
+	if (out->count == 0) return;
+	qsort(out->names, out->count, sizeof(char *), compare_names);
+	for (i = 1; i < out->count; i++)
+	{
+		if (!strcmp(out->names[i], out->names[kept])) free(out->names[i]);
+		else out->names[++kept] = out->names[i];
+	}
+	out->count = kept + 1;
+}
+
+void free_completions(completions * out)
+{
+	int i;
+	for (i = 0; i < out->count; i++) free(out->names[i]);
+	free(out->names);
+	out->names = NULL;
+	out->count = out->size = 0;
+}
@@ -0,0 +1,41 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the completion module
+ *
+ * Completion candidates for the line editor:
+ * - Commands: a trie per PATH directory with its executables, built once by
+ *   a background thread when the shell starts. Afterwards a directory is
+ *   read again only when its modification time changes, and a new PATH
+ *   rebuilds them all. Builtins live in a trie of their own.
+ * - Files: directory listings read with getdents64() and cached, sorted,
+ *   until the directory's modification time changes, so a prefix is found
+ *   with a binary search.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _COMPLETION_H
+#define _COMPLETION_H
+
+/* Candidates found, sorted and without duplicates */
+typedef struct completions_
+{
+	char ** names;     /* Whole words, directories end in '/' */
+	int count, size;
+} completions;
+
+/**
+ * Public Functions
+ **/
+void start_command_index(void);
+void add_command_name(const char * name);
+int complete_command(const char * prefix, completions * out);
+int complete_file(const char * word, completions * out);
+int add_completion(completions * out, const char * name, size_t length, const char * suffix);
+void sort_completions(completions * out);
+void free_completions(completions * out);
+
+#endif
@@ -0,0 +1,230 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * cpu_affinity module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cpu_affinity.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#define SYSFS_NODE "/sys/devices/system/node"
+
+/**
+ * Parses a CPU list as used by taskset and sysfs: numbers and ranges
+ * separated by commas ("0-3,8,10-11").
+ * Returns 0 on success or -1 if the list is malformed, out of range or
+ * empty.
+ **/
+int parse_cpu_list(const char * text, cpu_set_t * set)
+{
+	const char * p = text;
+
+	CPU_ZERO(set);
+	while (*p && *p != '\n')
+	{
+		char * end;
+		long first = strtol(p, &end, 10), last;
+		if (end == p || first < 0 || first >= CPU_SETSIZE) return -1;
+		last = first;
+		p = end;
+		if (*p == '-')
+		{
+			last = strtol(p + 1, &end, 10);
+			if (end == p + 1 || last < first || last >= CPU_SETSIZE) return -1;
+			p = end;
+		}
+		for (; first <= last; first++) CPU_SET(first, set);
+		if (*p == ',') p++;
+		else if (*p && *p != '\n') return -1;
+	}
+	return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+/**
+ * Writes set as a CPU list with ranges ("0-3,8"). A list that does not
+ * fit in buffer (at least 4 bytes) is cut and ends with "...".
+ **/
+void format_cpu_list(const cpu_set_t * set, char * buffer, size_t size)
+{
+	size_t len = 0;
+	int cpu = 0;
+
+	buffer[0] = '\0';
+	while (cpu < CPU_SETSIZE)
+	{
+		char item[32];
+		int last, n;
+		if (!CPU_ISSET(cpu, set))
+		{
+			cpu++;
+			continue;
+		}
+		for (last = cpu; last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set); last++);
+		if (last == cpu) n = snprintf(item, sizeof(item), "%s%d", len ? "," : "", cpu);
+		else n = snprintf(item, sizeof(item), "%s%d-%d", len ? "," : "", cpu, last);
+		if (len + n >= size)
+		{
+			strcpy(buffer + (len + 4 <= size ? len : size - 4), "...");
+			return;
+		}
+		memcpy(buffer + len, item, n + 1);
+		len += n;
+		cpu = last + 1;
+	}
+}
+
+/**
+ * Reads a CPU list file of sysfs into set.
+ * Returns 0 on success or -1.
+ **/
+static int read_cpu_list(const char * path, cpu_set_t * set)
+{
+	char buff[4096];
+	int fd = open(path, O_RDONLY | O_CLOEXEC), n;
+	if (fd == -1) return -1;
+	n = read(fd, buff, sizeof(buff) - 1);
+	close(fd);
+	if (n <= 0) return -1;
+	buff[n] = '\0';
+	return parse_cpu_list(buff, set);
+}
+
+static int compare_ints(const void * a, const void * b)
+{
+	return *(const int *) a - *(const int *) b;
+}
+
+/**
+ * Builds the placement slots of a spread team, in round-robin order:
+ * - SPREAD_CORE: one slot per physical core, holding its hardware threads.
+ * - SPREAD_NODE: one slot per NUMA node, holding its CPUs.
+ * Only the CPUs the shell may run on are used. Without topology
+ * information every CPU is a core and all of them a single node.
+ * Returns the number of slots, stored in a malloc()ed array in *slots, or
+ * -1 on error.
+ **/
+int cpu_slots(enum cpu_spread spread, cpu_set_t ** slots)
+{
+	cpu_set_t allowed, pending;
+	int count = 0, cpu;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) return -1;
+	*slots = (cpu_set_t *) malloc(CPU_COUNT(&allowed) * sizeof(cpu_set_t));
+	if (!*slots) return -1;
+
+	if (spread == SPREAD_NODE)
+	{
+		DIR * dir = opendir(SYSFS_NODE);
+		struct dirent * entry;
+		int nodes[CPU_SETSIZE], num_nodes = 0, i;
+
+		while (dir && (entry = readdir(dir)) && num_nodes < CPU_SETSIZE)
+		{
+			char * end;
+			if (strncmp(entry->d_name, "node", 4)) continue;
+			nodes[num_nodes] = (int) strtol(entry->d_name + 4, &end, 10);
+			if (end != entry->d_name + 4 && *end == '\0') num_nodes++;
+		}
+		if (dir) closedir(dir);
+		qsort(nodes, num_nodes, sizeof(int), compare_ints);
+		for (i = 0; i < num_nodes; i++)
+		{
+			char path[64];
+			cpu_set_t node, cpus;
+			snprintf(path, sizeof(path), SYSFS_NODE "/node%d/cpulist", nodes[i]);
+			if (read_cpu_list(path, &node) == -1) continue;
+			CPU_AND(&cpus, &node, &allowed);
+			if (CPU_COUNT(&cpus) > 0) (*slots)[count++] = cpus; /* Memory-only or not allowed: no slot */
+		}
+		if (count == 0) (*slots)[count++] = allowed;
+		return count;
+	}
+
+	pending = allowed;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		char path[96];
+		cpu_set_t core;
+		if (!CPU_ISSET(cpu, &pending)) continue;
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/thread_siblings_list", cpu);
+		if (read_cpu_list(path, &core) == -1 || !CPU_ISSET(cpu, &core))
+		{
+			CPU_ZERO(&core);
+			CPU_SET(cpu, &core);
+		}
+		CPU_AND(&(*slots)[count], &core, &pending);
+		CPU_XOR(&pending, &pending, &(*slots)[count]);
+		count++;
+	}
+	return count;
+}
+
+/**
+ * Moves every thread of every process in process group pgid (the children
+ * of the job's processes included) to the CPUs of set. The group members
+ * are found by the pgrp field of /proc/<pid>/stat.
+ * Returns the number of threads moved (0 if the group has no processes) or
+ * -1 with errno set if none of them could be moved.
+ **/
+int pin_process_group(pid_t pgid, const cpu_set_t * set)
+{
+	DIR * proc = opendir("/proc");
+	struct dirent * entry;
+	int moved = 0, failed = 0, error = 0;
+
+	if (!proc) return -1;
+	while ((entry = readdir(proc)))
+	{
+		char path[288], buff[512], * paren;
+		int fd, n, pgrp = 0, ppid;
+		char state;
+		DIR * tasks;
+		struct dirent * task;
+
+		if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+		snprintf(path, sizeof(path), "/proc/%s/stat", entry->d_name);
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1) continue;
+		n = read(fd, buff, sizeof(buff) - 1);
+		close(fd);
+		if (n <= 0) continue;
+		buff[n] = '\0';
+		/* The command name may contain spaces: the fields go on after the last ')' */
+		paren = strrchr(buff, ')');
+		if (!paren || sscanf(paren + 1, " %c %d %d", &state, &ppid, &pgrp) != 3) continue;
+		if (pgrp != pgid) continue;
+
+		snprintf(path, sizeof(path), "/proc/%s/task", entry->d_name);
+		tasks = opendir(path);
+		while (tasks && (task = readdir(tasks)))
+		{
+			if (task->d_name[0] < '0' || task->d_name[0] > '9') continue;
+			if (sched_setaffinity((pid_t) atoi(task->d_name), sizeof(cpu_set_t), set) == 0) moved++;
+			else if (errno != ESRCH) /* The thread may have just exited */
+			{
+				failed++;
+				error = errno;
+			}
+		}
+		if (tasks) closedir(tasks);
+	}
+	closedir(proc);
+	if (moved == 0 && failed > 0)
+	{
+		errno = error;
+		return -1;
+	}
+	return moved;
+}
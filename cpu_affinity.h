@@ -0,0 +1,36 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the cpu_affinity module
+ *
+ * CPU sets for launched jobs: parsing and printing CPU lists ("0-3,8"),
+ * the placement slots used to spread a bgteam (one per physical core or
+ * per NUMA node, read from sysfs and limited to the CPUs the shell may
+ * use), and moving every thread of a running process group to a new set.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _CPU_AFFINITY_H
+#define _CPU_AFFINITY_H
+
+#include <sched.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Enumerations
+ **/
+enum cpu_spread { SPREAD_CORE, SPREAD_NODE };
+
+/**
+ * Public Functions
+ **/
+int parse_cpu_list(const char * text, cpu_set_t * set);
+void format_cpu_list(const cpu_set_t * set, char * buffer, size_t size);
+int cpu_slots(enum cpu_spread spread, cpu_set_t ** slots);
+int pin_process_group(pid_t pgid, const cpu_set_t * set);
+
+#endif
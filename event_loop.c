@@ -0,0 +1,145 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * event_loop module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include "event_loop.h"
+
+#define MAX_EVENTS 64 /* Events handled per epoll_wait() call */
+
+/* Handler registered for a descriptor */
+typedef struct watch_
+{
+	event_handler handler; /* NULL if the descriptor is not watched */
+	void * data;
+} watch;
+
+static int epoll_fd = -1;
+static watch * watches = NULL; /* Indexed by descriptor */
+static int num_watches = 0;
+static long long wakeup_ns = 0; /* When the current batch of events was returned */
+
+/**
+ * Creates the epoll instance.
+ * Returns 0 on success or -1 with errno set.
+ **/
+int event_loop_init(void)
+{
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	return epoll_fd == -1 ? -1 : 0;
+}
+
+/**
+ * Watches fd for input (and hangup or errors), calling handler with data
+ * when it is ready. Watching an already watched descriptor replaces its
+ * handler.
+ * Returns 0 on success or -1 with errno set (EPERM for regular files).
+ **/
+int event_loop_add(int fd, event_handler handler, void * data)
+{
+	struct epoll_event ev;
+	int op = EPOLL_CTL_ADD;
+
+	if (fd >= num_watches)
+	{
+		int size = num_watches ? num_watches : 64, i;
+		watch * aux;
+		while (size <= fd) size *= 2;
+		aux = (watch *) realloc(watches, size * sizeof(watch));
+		if (!aux) return -1;
+		for (i = num_watches; i < size; i++) aux[i].handler = NULL;
+		watches = aux;
+		num_watches = size;
+	}
+	if (watches[fd].handler) op = EPOLL_CTL_MOD;
+
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, op, fd, &ev) == -1)
+	{
+		/* The old descriptor was closed without event_loop_remove() and the number reused */
+		if (op != EPOLL_CTL_MOD || errno != ENOENT) return -1;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) return -1;
+	}
+	watches[fd].handler = handler;
+	watches[fd].data = data;
+	return 0;
+}
+
+/**
+ * Stops watching fd. Closing a descriptor also stops the kernel side, but
+ * only when no other process shares it, so remove shared ones first.
+ **/
+void event_loop_remove(int fd)
+{
+	if (fd < 0 || fd >= num_watches || !watches[fd].handler) return;
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	watches[fd].handler = NULL;
+}
+
+/**
+ * Waits up to timeout_ms (-1 = forever) for ready descriptors and runs their
+ * handlers. A descriptor removed by an earlier handler of the same batch is
+ * skipped.
+ * Returns the number of ready descriptors, 0 on timeout or -1 on error.
+ **/
+int event_loop_wait(int timeout_ms)
+{
+	struct epoll_event events[MAX_EVENTS];
+	int n, i;
+
+	do
+	{
+		n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+	} while (n == -1 && errno == EINTR); /* Only from a debugger stop */
+	if (n > 0)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		wakeup_ns = (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		int fd = events[i].data.fd;
+		if (fd < num_watches && watches[fd].handler)
+			watches[fd].handler(fd, events[i].events, watches[fd].data);
+	}
+	return n;
+}
+
+/**
+ * Returns the CLOCK_MONOTONIC time (ns) at which the batch being dispatched
+ * was received: the earliest the shell knew about any of its events.
+ **/
+long long event_loop_wakeup_ns(void)
+{
+	return wakeup_ns;
+}
+
+/**
+ * Returns a pidfd for process pid (readable once it exits), or -1 if the
+ * kernel does not support them.
+ **/
+int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return (int) syscall(SYS_pidfd_open, pid, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
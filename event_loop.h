@@ -0,0 +1,35 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the event_loop module
+ *
+ * The event loop is the core of the shell: it waits with epoll on every
+ * descriptor the shell cares about (stdin, a signalfd, one pidfd per job,
+ * and later timerfds or control sockets) and calls the handler registered
+ * for each ready descriptor. Everything runs synchronously in the main loop,
+ * so there is no signal handler reentrancy and no EINTR.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _EVENT_LOOP_H
+#define _EVENT_LOOP_H
+
+#include <sys/types.h>
+
+/* Called when fd is ready; events is the epoll event mask */
+typedef void (*event_handler)(int fd, unsigned int events, void * data);
+
+/**
+ * Public Functions
+ **/
+int event_loop_init(void);
+int event_loop_add(int fd, event_handler handler, void * data);
+void event_loop_remove(int fd);
+int event_loop_wait(int timeout_ms);
+long long event_loop_wakeup_ns(void);
+int open_pidfd(pid_t pid);
+
+#endif
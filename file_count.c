@@ -0,0 +1,293 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * file_count module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "file_count.h"
+
+#define DIR_BUFFER (64 * 1024) /* getdents64() buffer per thread */
+
+/* Record returned by getdents64 (not exported by glibc headers) */
+struct linux_dirent64
+{
+	unsigned long long d_ino;
+	long long d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+/* Directory waiting to be read */
+typedef struct dir_work_
+{
+	char path[1];                /* Allocated with the length of the path */
+} dir_work;
+
+/* Queue of a worker: the owner pushes and pops at the bottom, thieves take from the top */
+typedef struct worker_
+{
+	pthread_mutex_t lock;
+	dir_work ** items;           /* Circular array */
+	unsigned int size, top, bottom;
+	struct pool_ * pool;
+	int index;
+	long count;                  /* Files counted by this worker */
+	char * buffer;
+} worker;
+
+/* Thread pool for one recursive count */
+typedef struct pool_
+{
+	worker * workers;
+	int num_workers;
+	const char * prefix;
+	size_t prefix_len;
+	int recursive;
+	long pending;                /* Directories queued or being read */
+} pool;
+
+/**
+ * Queues a directory in a worker's queue.
+ * Returns 0 if memory allocation fails.
+ **/
+static int push_work(worker * w, dir_work * item)
+{
+	pthread_mutex_lock(&w->lock);
+	if (w->bottom - w->top == w->size)
+	{
+		unsigned int size = w->size ? w->size * 2 : 64, i;
+		dir_work ** items = (dir_work **) malloc(size * sizeof(dir_work *));
+		if (!items)
+		{
+			pthread_mutex_unlock(&w->lock);
+			return 0;
+		}
+		for (i = 0; i < w->bottom - w->top; i++) items[i] = w->items[(w->top + i) % w->size];
+		free(w->items);
+		w->items = items;
+		w->bottom -= w->top;
+		w->top = 0;
+		w->size = size;
+	}
+	w->items[w->bottom++ % w->size] = item;
+	pthread_mutex_unlock(&w->lock);
+	return 1;
+}
+
+/**
+ * Takes the newest directory of the worker's own queue (depth first keeps
+ * the queues short), or the oldest one of a victim's queue (the biggest
+ * subtrees are near the root).
+ **/
+static dir_work * pop_work(worker * w, int steal)
+{
+	dir_work * item = NULL;
+	pthread_mutex_lock(&w->lock);
+	if (w->bottom != w->top)
+	{
+		if (steal) item = w->items[w->top++ % w->size];
+		else item = w->items[--w->bottom % w->size];
+	}
+	pthread_mutex_unlock(&w->lock);
+	return item;
+}
+
+static dir_work * new_work(const char * parent, const char * name)
+{
+	size_t parent_len = strlen(parent), name_len = strlen(name);
+	dir_work * item = (dir_work *) malloc(sizeof(dir_work) + parent_len + name_len + 1);
+	if (!item) return NULL;
+	memcpy(item->path, parent, parent_len);
+	item->path[parent_len] = '/';
+	memcpy(item->path + parent_len + 1, name, name_len + 1);
+	return item;
+}
+
+/**
+ * Reads a directory: counts its regular files matching the prefix and, in
+ * recursive mode, queues its subdirectories (symbolic links are not
+ * followed, like find).
+ * Returns 0 if the directory cannot be read.
+ **/
+static int scan_directory(worker * w, const char * path)
+{
+	pool * p = w->pool;
+	int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+	long n;
+
+	if (fd == -1) return 0;
+	while ((n = syscall(SYS_getdents64, fd, w->buffer, DIR_BUFFER)) > 0)
+	{
+		long pos = 0;
+		while (pos < n)
+		{
+			struct linux_dirent64 * d = (struct linux_dirent64 *) (w->buffer + pos);
+			unsigned char type = d->d_type;
+			pos += d->d_reclen;
+
+			if (d->d_name[0] == '.' && (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0')))
+				continue;
+			if (type == DT_UNKNOWN)
+			{
+				/* The file system does not fill d_type */
+				struct stat st;
+				if (fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1) continue;
+				type = S_ISREG(st.st_mode) ? DT_REG : S_ISDIR(st.st_mode) ? DT_DIR : DT_UNKNOWN;
+			}
+			if (type == DT_REG)
+			{
+				if (strncmp(d->d_name, p->prefix, p->prefix_len) == 0) w->count++;
+			}
+			else if (type == DT_DIR && p->recursive)
+			{
+				dir_work * item = new_work(path, d->d_name);
+				__atomic_fetch_add(&p->pending, 1, __ATOMIC_RELAXED);
+				if (!item || !push_work(w, item))
+				{
+					free(item);
+					__atomic_fetch_sub(&p->pending, 1, __ATOMIC_RELAXED);
+					fprintf(stderr, "fico: %s/%s: %s\n", path, d->d_name, strerror(ENOMEM));
+				}
+			}
+		}
+	}
+	close(fd);
+	return n == 0;
+}
+
+/**
+ * Worker thread: reads directories from its own queue, steals from the
+ * others when it is empty, and ends when no directory is queued or being
+ * read anywhere.
+ **/
+static void * worker_main(void * arg)
+{
+	worker * w = (worker *) arg;
+	pool * p = w->pool;
+	int idle = 0;
+
+	while (1)
+	{
+		dir_work * item = pop_work(w, 0);
+		int i;
+		for (i = 1; !item && i < p->num_workers; i++)
+			item = pop_work(&p->workers[(w->index + i) % p->num_workers], 1);
+
+		if (item)
+		{
+			idle = 0;
+			if (!scan_directory(w, item->path))
+				fprintf(stderr, "fico: %s: %s\n", item->path, strerror(errno));
+			free(item);
+			__atomic_fetch_sub(&p->pending, 1, __ATOMIC_RELEASE);
+		}
+		else if (__atomic_load_n(&p->pending, __ATOMIC_ACQUIRE) == 0)
+		{
+			break;
+		}
+		else if (++idle > 64)
+		{
+			usleep(100); /* Others are reading big directories */
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Counts the regular files in dir whose names start with prefix (all of
+ * them if prefix is NULL or empty). With recursive, subdirectories are
+ * included and walked by threads workers (0 = one per CPU).
+ * Returns the number of files, or -1 with errno set if dir cannot be read.
+ * Unreadable subdirectories are reported on stderr and skipped.
+ **/
+long count_files(const char * dir, const char * prefix, int recursive, int threads)
+{
+	pthread_t tids[FILE_COUNT_MAX_THREADS];
+	pool p;
+	long total = 0;
+	int i, started;
+
+	p.prefix = prefix ? prefix : "";
+	p.prefix_len = strlen(p.prefix);
+	p.recursive = recursive;
+	p.pending = 0;
+	if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	if (threads > FILE_COUNT_MAX_THREADS) threads = FILE_COUNT_MAX_THREADS;
+	if (!recursive) threads = 1;
+
+	p.num_workers = threads;
+	p.workers = (worker *) calloc(threads, sizeof(worker));
+	if (!p.workers) return -1;
+	for (i = 0; i < threads; i++)
+	{
+		p.workers[i].buffer = (char *) malloc(DIR_BUFFER);
+		if (!p.workers[i].buffer) break; /* Run with fewer */
+		pthread_mutex_init(&p.workers[i].lock, NULL);
+		p.workers[i].pool = &p;
+		p.workers[i].index = i;
+	}
+	threads = p.num_workers = i;
+
+	if (threads == 0)
+	{
+		total = -1;
+		errno = ENOMEM;
+	}
+	else if (!recursive)
+	{
+		if (!scan_directory(&p.workers[0], dir)) total = -1;
+		else total = p.workers[0].count;
+	}
+	else
+	{
+		/* The first directory is read like the others, so a failure on it is an error */
+		int error = 0;
+		if (!scan_directory(&p.workers[0], dir))
+		{
+			error = errno;
+			total = -1;
+		}
+		started = 0;
+		while (!error && started < threads - 1 &&
+			pthread_create(&tids[started], NULL, worker_main, &p.workers[started + 1]) == 0)
+			started++;
+		if (!error) worker_main(&p.workers[0]);
+		for (i = 0; i < started; i++) pthread_join(tids[i], NULL);
+		if (!error)
+			for (i = 0; i < threads; i++) total += p.workers[i].count;
+		errno = error;
+	}
+
+	for (i = 0; i < p.num_workers; i++)
+	{
+		dir_work * item;
+		while ((item = pop_work(&p.workers[i], 0))) free(item); /* Left after an error */
+		free(p.workers[i].items);
+		free(p.workers[i].buffer);
+		pthread_mutex_destroy(&p.workers[i].lock);
+	}
+	free(p.workers);
+	return total;
+}
@@ -0,0 +1,28 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the file_count module
+ *
+ * Counts regular files (optionally only those whose name starts with a
+ * prefix) inside the shell, for the fico builtin. Directories are read with
+ * getdents64() into large buffers and entries are classified by d_type, so
+ * no file is stat()ed unless the file system does not report types.
+ * Recursive counts walk the tree with a pool of threads that steal
+ * directories from each other's queues.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _FILE_COUNT_H
+#define _FILE_COUNT_H
+
+#define FILE_COUNT_MAX_THREADS 64
+
+/**
+ * Public Functions
+ **/
+long count_files(const char * dir, const char * prefix, int recursive, int threads);
+
+#endif
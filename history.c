@@ -0,0 +1,302 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * history module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+#define HISTORY_BUCKETS (1 << 16) /* Trigram buckets, power of two */
+
+/* Entries containing a trigram (or another one in the same bucket), ascending */
+typedef struct posting_
+{
+	unsigned int * ids;
+	unsigned int count, size;
+} posting;
+
+static char * path = NULL;
+static int append_fd = -1, read_fd = -1;
+static char * last_added = NULL;     /* Not added twice in a row */
+
+static dev_t append_dev, read_dev;   /* Files open in append_fd and read_fd */
+static ino_t append_ino, read_ino;
+static char * map = NULL;            /* The file, mapped read-only */
+static size_t mapped = 0;
+static size_t indexed = 0;           /* Bytes indexed, up to the last complete line */
+static size_t * starts = NULL;       /* Offset of every entry */
+static long num_entries = 0, max_entries = 0;
+static posting * trigrams = NULL;    /* HISTORY_BUCKETS lists, built by the first search */
+static long trigram_entries = 0;     /* Entries already in the trigram lists */
+
+static unsigned int trigram_bucket(const char * p)
+{
+	unsigned int t = (unsigned char) p[0] << 16 | (unsigned char) p[1] << 8 | (unsigned char) p[2];
+	return (t * 2654435761u) >> 16 & (HISTORY_BUCKETS - 1);
+}
+
+/**
+ * Sets the history file. It is not opened until it is used.
+ **/
+void history_file(const char * name)
+{
+	free(path);
+	path = strdup(name);
+}
+
+/**
+ * Appends line to the history file, unless it repeats the previous line
+ * added by this shell. The line and its newline go in a single write to a
+ * descriptor opened with O_APPEND, so lines of several shells never mix.
+ * The descriptor is opened again when the file was replaced or removed.
+ * Returns 0 on success or -1.
+ **/
+int history_add(const char * line)
+{
+	size_t len = strlen(line);
+	struct stat st;
+	char * record;
+	ssize_t n;
+
+	if (!path || (last_added && !strcmp(last_added, line))) return -1;
+	if (append_fd != -1 && (stat(path, &st) == -1 || st.st_dev != append_dev || st.st_ino != append_ino))
+	{
+		close(append_fd);
+		append_fd = -1;
+	}
+	if (append_fd == -1)
+	{
+		append_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+		if (append_fd == -1) return -1;
+		if (fstat(append_fd, &st) == -1)
+		{
+			close(append_fd);
+			append_fd = -1;
+			return -1;
+		}
+		append_dev = st.st_dev;
+		append_ino = st.st_ino;
+	}
+
+	record = (char *) malloc(len + 1);
+	if (!record) return -1;
+	memcpy(record, line, len);
+	record[len] = '\n';
+	n = write(append_fd, record, len + 1);
+	free(record);
+	if (n != (ssize_t) len + 1) return -1;
+
+	free(last_added);
+	last_added = strdup(line);
+	return 0;
+}
+
+/**
+ * Records the start of a new entry.
+ * Returns 0 on success or -1 if there is no memory.
+ **/
+static int add_entry(size_t start)
+{
+	if (num_entries == max_entries)
+	{
+		long size = max_entries ? max_entries * 2 : 1024;
+		size_t * aux = (size_t *) realloc(starts, size * sizeof(size_t));
+		if (!aux) return -1;
+		starts = aux;
+		max_entries = size;
+	}
+	starts[num_entries++] = start;
+	return 0;
+}
+
+/**
+ * Adds the entries not indexed yet to the trigram lists. Only searches
+ * need them, so listing the history does not pay for them.
+ * Returns 0 on success or -1 if there is no memory.
+ **/
+static int index_trigrams(void)
+{
+	if (!trigrams)
+	{
+		trigrams = (posting *) calloc(HISTORY_BUCKETS, sizeof(posting));
+		if (!trigrams) return -1;
+	}
+	for (; trigram_entries < num_entries; trigram_entries++)
+	{
+		unsigned int id = (unsigned int) trigram_entries;
+		const char * p = map + starts[id];
+		const char * end = (id + 1 < num_entries ? map + starts[id + 1] : map + indexed) - 1;
+		for (; p + 3 <= end; p++)
+		{
+			posting * t = &trigrams[trigram_bucket(p)];
+			if (t->count > 0 && t->ids[t->count - 1] == id) continue; /* Repeated in this entry */
+			if (t->count == t->size)
+			{
+				unsigned int size = t->size ? t->size * 2 : 4;
+				unsigned int * aux = (unsigned int *) realloc(t->ids, size * sizeof(unsigned int));
+				if (!aux) return -1;
+				t->ids = aux;
+				t->size = size;
+			}
+			t->ids[t->count++] = id;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Drops the mapping and the index, to read the file again from the start.
+ **/
+static void history_forget(void)
+{
+	int i;
+	if (map) munmap(map, mapped);
+	map = NULL;
+	mapped = 0;
+	for (i = 0; trigrams && i < HISTORY_BUCKETS; i++) trigrams[i].count = 0;
+	num_entries = trigram_entries = 0;
+	indexed = 0;
+}
+
+/**
+ * Brings the mapping and the entry starts up to date with the file: maps
+ * it on first use, extends the mapping when the file has grown (other
+ * shells append too) and indexes only the new complete lines. A file that
+ * shrank was truncated, and one with another inode was replaced: both are
+ * mapped and indexed again from the start, since pages past the end of a
+ * shrunk file raise SIGBUS.
+ * Returns 0 on success or -1.
+ **/
+static int history_sync(void)
+{
+	struct stat st;
+	const char * p, * end, * newline;
+
+	if (!path) return -1;
+	if (stat(path, &st) == -1) return errno == ENOENT ? 0 : -1; /* Nothing added yet */
+	if (read_fd != -1 && (st.st_dev != read_dev || st.st_ino != read_ino))
+	{
+		close(read_fd);
+		read_fd = -1;
+		history_forget();
+	}
+	if (read_fd == -1)
+	{
+		read_fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (read_fd == -1) return errno == ENOENT ? 0 : -1;
+		if (fstat(read_fd, &st) == -1) return -1;
+		read_dev = st.st_dev;
+		read_ino = st.st_ino;
+	}
+
+	if ((size_t) st.st_size < mapped) history_forget();
+	if (st.st_size == 0) return 0; /* Nothing to map */
+	if ((size_t) st.st_size > mapped)
+	{
+		void * aux = map ? mremap(map, mapped, st.st_size, MREMAP_MAYMOVE)
+			: mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, read_fd, 0);
+		if (aux == MAP_FAILED) return -1;
+		map = (char *) aux;
+		mapped = st.st_size;
+	}
+
+	p = map + indexed;
+	end = map + mapped;
+	while ((newline = memchr(p, '\n', end - p)) != NULL)
+	{
+		if (add_entry(p - map) == -1) return -1;
+		p = newline + 1;
+		indexed = p - map;
+	}
+	return 0;
+}
+
+/**
+ * Returns the number of entries in the history file.
+ **/
+long history_count(void)
+{
+	history_sync();
+	return num_entries;
+}
+
+/**
+ * Returns entry n (1 = the oldest) with its length in *length. It is not
+ * terminated, and is valid until the next call to the module.
+ * Returns NULL if there is no entry n.
+ **/
+const char * history_entry(long n, size_t * length)
+{
+	size_t end;
+	if (n < 1 || n > num_entries) return NULL;
+	end = (n < num_entries ? starts[n] : indexed) - 1;
+	*length = end - starts[n - 1];
+	return map + starts[n - 1];
+}
+
+static int entry_contains(long n, const char * text, size_t len)
+{
+	size_t length;
+	const char * entry = history_entry(n, &length);
+	return entry && memmem(entry, length, text, len) != NULL;
+}
+
+/**
+ * Returns the newest entry before entry before (0 = search them all) that
+ * contains text, or 0 if there is none. Calling it again with the entry
+ * found goes on to older ones, as a reverse search does.
+ * Texts of three or more characters only visit the entries of their rarest
+ * trigram; shorter ones are searched entry by entry.
+ **/
+long history_search(const char * text, long before)
+{
+	size_t len = strlen(text), i;
+	posting * rarest = NULL;
+	unsigned int low, high;
+	long n;
+
+	history_sync();
+	if (before <= 0 || before > num_entries) before = num_entries + 1;
+	if (len < 3 || index_trigrams() == -1)
+	{
+		for (n = before - 1; n >= 1; n--)
+		{
+			if (entry_contains(n, text, len)) return n;
+		}
+		return 0;
+	}
+
+	for (i = 0; i + 3 <= len; i++)
+	{
+		posting * t = &trigrams[trigram_bucket(text + i)];
+		if (!rarest || t->count < rarest->count) rarest = t;
+	}
+	if (rarest->count == 0) return 0;
+
+	/* Last position of an id below before - 1 (ids are entry numbers - 1) */
+	low = 0;
+	high = rarest->count;
+	while (low < high)
+	{
+		unsigned int mid = low + (high - low) / 2;
+		if (rarest->ids[mid] < (unsigned long) before - 1) low = mid + 1;
+		else high = mid;
+	}
+	while (low-- > 0)
+	{
+		if (entry_contains(rarest->ids[low] + 1, text, len)) return rarest->ids[low] + 1;
+	}
+	return 0;
+}
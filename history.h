@@ -0,0 +1,34 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes for the history module
+ *
+ * Persistent command history shared by every shell that uses the same
+ * file. Lines are appended with a single O_APPEND write each, so several
+ * shells can add to it at once without mixing their lines. Reading maps
+ * the file and indexes it lazily: nothing is opened at startup, the first
+ * lookup pages the file in, and later lookups only index what has been
+ * appended since (by any shell). The index holds the start of every entry
+ * and, per trigram, the entries that contain it, so a substring search
+ * only looks at the entries of its rarest trigram.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _HISTORY_H
+#define _HISTORY_H
+
+#include <stddef.h>
+
+/**
+ * Public Functions
+ **/
+void history_file(const char * name);
+int history_add(const char * line);
+long history_count(void);
+const char * history_entry(long n, size_t * length);
+long history_search(const char * text, long before);
+
+#endif
@@ -1,317 +1,1037 @@
-// FELIPE OEHLER GUZMÁN
-
-/**
- * Linux Control Job Shell Project
- * job_control module
- *
- * Operating Systems
- * Grados Ing. Informatica, Computadores & Software
- * Dept. de Arquitectura de Computadores - UMA
- *
- * Some code adapted from "Operating System Concepts Essentials", Silberschatz et al.
- **/
-#include "job_control.h"
-
-/**
- *  get_command() reads in the next command line, separating it into distinct
- *  tokens using whitespace as delimiters. setup() sets the args parameter as a
- *  null-terminated string.
- **/
-void get_command(char inputBuffer[], int size, char *args[],int *background)
-{
-	int length, /* # of characters in the command line */
-		i,      /* Loop index for accessing inputBuffer array */
-		start,  /* Index where beginning of next command parameter is */
-		ct;     /* Index of where to place the next parameter into args[] */
-
-	ct = 0;
-	*background=0;
-
-	/* Read what the user enters on the command line */
-	length = read(STDIN_FILENO, inputBuffer, size);  
-
-	start = -1;
-	if (length == 0)
-	{
-		printf("\nBye\n");
-		exit(0);            /* ^d was entered, end of user command stream */
-	} 
-	if (length < 0){
-		perror("error reading the command");
-		exit(-1);           /* Terminate with error code of -1 */
-	}
-
-	/* Examine every character in the inputBuffer */
-	int end = 0, iesc=0;
-	for (i=0;i<length;i++) 
-	{
-		if (end) break;
-        if (i>1 && i>iesc) inputBuffer[i-1-iesc] = inputBuffer[i-1];
-		switch (inputBuffer[i])
-		{
-		case ' ':
-		case '\t' :               /* Argument separators */
-			if(start != -1)
-			{
-				args[ct] = &inputBuffer[start];    /* Set up pointer */
-				ct++;
-			}
-			inputBuffer[i] = '\0'; /* Add a null char; make a C string */
-			start = -1;
-			inputBuffer[i-iesc] = '\0'; /* add a null char; make a C string */
-            iesc = 0;
-			break;
-		case '#':                  /* Comment found */
-            if (i>0 && '\\' == inputBuffer[i-1]){
-                iesc++;            /* Escaped comment symbol */
-			    if (start == -1) start = i;  // Start of new argument
-                break;
-            }
-		case '\n':                 /* Should be the final char examined */
-			if (start != -1)
-			{
-				args[ct] = &inputBuffer[start];     
-				ct++;
-			}
-			inputBuffer[i] = '\0';
-			args[ct] = NULL; 	   /* No more arguments to this command */
-			end = 1;
-			break;
-		default :             /* Some other character */
-			if (inputBuffer[i] == '&') /* Background indicator */
-			{
-				*background  = 1;
-				if (start != -1)
-				{
-					args[ct] = &inputBuffer[start];     
-					ct++;
-				}
-				inputBuffer[i] = '\0';
-				args[ct] = NULL; /* No more arguments to this command */
-				i=length; 		 /* Make sure the for loop ends now */
-			}
-			else if (start == -1) start = i;  /* Start of new argument */
-		}  /* End switch */
-	}  /* End for */
-	args[ct] = NULL; /* Just in case the input line was > MAXLINE */
-	if (i>1 && i>iesc) inputBuffer[i-1-iesc] = inputBuffer[i-1];
-}
-
-/**
- * Parse redirections operators '<' '>' once args structure has been built.
- * Call the function immediately after get_commad():
- *      ...
- *     while(...){
- *          // Shell main loop
- *          ...
- *          get_command(...);
- *          char *file_in, *file_out;
- *          parse_redirections(args, &file_in, &file_out);
- *          ...
- *     }
- *
- * For a valid redirection, a blank space is required before and after
- * redirection operators '<' or '>'.
- **/
-void parse_redirections(char **args,  char **file_in, char **file_out){
-    *file_in = NULL;
-    *file_out = NULL;
-    char **args_start = args;
-    while (*args) {
-        int is_in = !strcmp(*args, "<");
-        int is_out = !strcmp(*args, ">");
-        if (is_in || is_out) {
-            args++;
-            if (*args){
-                if (is_in)  *file_in = *args;
-                if (is_out) *file_out = *args;
-                char **aux = args + 1;
-                while (*aux) {
-                   *(aux-2) = *aux;
-                   aux++;
-                }
-                *(aux-2) = NULL;
-                args--;
-            } else {
-                /* Syntax error */
-                fprintf(stderr, "syntax error in redirection\n");
-                args_start[0] = NULL; // Do nothing
-            }
-        } else {
-            args++;
-        }
-    }
-    /* Debug:
-     * *file_in && fprintf(stderr, "[parse_redirections] file_in='%s'\n", *file_in);
-     * *file_out && fprintf(stderr, "[parse_redirections] file_out='%s'\n", *file_out);
-	 */
-}
-
-/**
- * Returns a pointer to a list item with its fields initialized.
- * Returns NULL if memory allocation fails
- **/
-job * new_job(pid_t pid, const char * command, enum job_state state)
-{
-	job * aux;
-	aux=(job *) malloc(sizeof(job));
-	if (!aux) return NULL;
-	aux->pgid=pid;
-	aux->state=state;
-	aux->command=strdup(command);
-	aux->next=NULL;
-	return aux;
-}
-
-/**
- * Inserts an item as head of the list
- **/
-void add_job (job * list, job * item)
-{
-	job * aux=list->next;
-	list->next=item;
-	item->next=aux;
-	list->pgid++;
-
-}
-
-/**
- * Deletes from the list the item passed as second argument.
- * Returns 0 if the item does not exist.
- **/
-int delete_job(job * list, job * item)
-{
-	job * aux=list;
-	while(aux->next!= NULL && aux->next!= item) aux=aux->next;
-	if(aux->next)
-	{
-		aux->next=item->next;
-		free(item->command);
-		free(item);
-		list->pgid--;
-		return 1;
-	}
-	else
-		return 0;
-
-}
-
-/**
- * Looks an item up by its PID and returns it.
- * Returns NULL if the item is not found.
- **/
-job * get_item_bypid  (job * list, pid_t pid)
-{
-	job * aux=list;
-	while(aux->next!= NULL && aux->next->pgid != pid) aux=aux->next;
-	return aux->next;
-}
-
-/**
- * Looks an item up by its position inside the list, beginning with 1 (as item 0
- * is devoted to hold the name and number of items of the list), and returns it.
- * Returns NULL if the item is not found.
- **/
-job * get_item_bypos( job * list, int n)
-{
-	job * aux=list;
-	if(n<1 || n>list->pgid) return NULL;
-	n--;
-	while(aux->next!= NULL && n) { aux=aux->next; n--;}
-	return aux->next;
-}
-
-/**
- * Prints a line with the info o an item: pid, command name and state
- **/
-void print_item(job * item)
-{
-
-	printf("pid: %d, command: %s, state: %s\n", item->pgid, item->command, state_strings[item->state]);
-}
-
-/**
- * Walks the list and call print function for each item in it
- **/
-void print_list(job * list, void (*print)(job *))
-{
-	int n=1;
-	job * aux=list;
-	printf("Contents of %s:\n",list->command);
-	while(aux->next!= NULL) 
-	{
-		printf(" [%d] ",n);
-		print(aux->next);
-		n++;
-		aux=aux->next;
-	}
-}
-
-/**
- * Interpret the status value returned by wait */
-enum status analyze_status(int status, int *info)
-{
-	/* Suspended process */
-	if (WIFSTOPPED (status))
-	{
-		*info=WSTOPSIG(status);
-		return(SUSPENDED);
-	}
-	/* Continued process */
-    else if (WIFCONTINUED(status))
-    { 
-        *info=0; 
-        return(CONTINUED);
-    }
-    /* Terminated process by signal*/
-	else if (WIFSIGNALED (status))
-	{
-		*info=WTERMSIG (status);
-		return(SIGNALED);
-	}
-	/*Terminated process by exit */
-	else if (WIFEXITED (status))
-	{
-		*info=WEXITSTATUS(status);
-		return(EXITED);
-	}
-	/* Should never get here*/
-	return -1;
-}
-
-/**
- * Changes default action for terminal related signals
- **/
-void terminal_signals(void (*func) (int))
-{
-	signal (SIGINT,  func); /* crtl+c Interrupt from keyboard */
-	signal (SIGQUIT, func); /* ctrl+\ Quit from keyboard */
-	signal (SIGTSTP, func); /* crtl+z Stop typed at keyboard */
-	signal (SIGTTIN, func); /* Background process tries terminal input */
-	signal (SIGTTOU, func); /* Background process tries terminal output */
-}		
-
-/**
- * Blocks or masks a signal.
- * The signal handler execution for the signal is deferred until the signal
- * is unblocked.
- * If several instances of the signal ocurred after being blocked, when
- * unblocked, the handler for that signal executes only once.
- **/
-void block_signal(int signal, int block)
-{
-	/* Declare and initialize signal masks */
-	sigset_t block_sigchld;
-	sigemptyset(&block_sigchld);
-	sigaddset(&block_sigchld,signal);
-	if(block)
-	{
-		/* Blocks signal */
-		sigprocmask(SIG_BLOCK, &block_sigchld, NULL);
-	}
-	else
-	{
-		/* Unblocks signal */
-		sigprocmask(SIG_UNBLOCK, &block_sigchld, NULL);
-	}
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Control Job Shell Project
+ * job_control module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica, Computadores & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ *
+ * Some code adapted from "Operating System Concepts Essentials", Silberschatz et al.
+ **/
+#include <errno.h>
+#include <time.h>
+#include "job_control.h"
+#include "trace.h"
+
+char* status_strings[] = { "Suspended", "Signaled", "Exited", "Continued"};
+char* state_strings[] = { "Foreground", "Background", "Stopped" };
+
+/**
+ * Command reader: input is read in large blocks and the bytes after the
+ * first newline are kept for the next call, so pasted or piped lines are
+ * never lost. The buffer and the args array grow as needed: there is no
+ * limit on line length or number of arguments.
+ **/
+#define READER_BUFFER (64 * 1024) /* Initial buffer size and minimum read size */
+#define READER_ARGS 64            /* Initial size of the args array */
+
+/**
+ * Prepares a reader for descriptor fd (stdin, a script...)
+ **/
+void init_command_reader(command_reader * reader, int fd)
+{
+	reader->fd = fd;
+	reader->size = READER_BUFFER;
+	reader->buffer = (char *) malloc(reader->size);
+	reader->start = reader->end = 0;
+	reader->max_args = READER_ARGS;
+	reader->args = (char **) malloc(reader->max_args * sizeof(char *));
+	reader->num_args = 0;
+	reader->record = NULL;
+	if (!reader->buffer || !reader->args)
+	{
+		perror("error allocating the command reader");
+		exit(-1);
+	}
+}
+
+/**
+ * Prepares a reader whose whole input is text (e.g. the argument of -c)
+ **/
+void init_string_reader(command_reader * reader, const char * text)
+{
+	size_t len = strlen(text);
+	init_command_reader(reader, -1);
+	if (len + 1 > reader->size)
+	{
+		reader->size = len + 1;
+		reader->buffer = (char *) realloc(reader->buffer, reader->size);
+		if (!reader->buffer)
+		{
+			perror("error allocating the command reader");
+			exit(-1);
+		}
+	}
+	memcpy(reader->buffer, text, len);
+	reader->end = len;
+}
+
+/**
+ * Adds text to the reader's input as a complete line, as if it had been
+ * read (a line typed in the line editor).
+ **/
+void feed_command_reader(command_reader * reader, const char * text)
+{
+	size_t len = strlen(text);
+
+	if (reader->start > 0)
+	{
+		memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+		reader->end -= reader->start;
+		reader->start = 0;
+	}
+	if (reader->end + len + 1 > reader->size)
+	{
+		size_t size = reader->size;
+		char * aux;
+		while (reader->end + len + 1 > size) size *= 2;
+		aux = (char *) realloc(reader->buffer, size);
+		if (!aux)
+		{
+			perror("error reading the command");
+			exit(-1);
+		}
+		reader->buffer = aux;
+		reader->size = size;
+	}
+	memcpy(reader->buffer + reader->end, text, len);
+	reader->end += len;
+	reader->buffer[reader->end++] = '\n';
+}
+
+/**
+ * Returns 1 if a complete line is already buffered, so it can be read
+ * without waiting for input.
+ **/
+int command_pending(command_reader * reader)
+{
+	return reader->fd == -1 || memchr(reader->buffer + reader->start, '\n', reader->end - reader->start) != NULL;
+}
+
+/**
+ * Returns the next line (without its newline) as a string inside the
+ * reader's buffer, valid until the next call. A last line without newline
+ * is returned too. Returns NULL at the end of the input.
+ **/
+static char * read_line(command_reader * reader)
+{
+	char * newline;
+	char * line;
+
+	while ((newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start)) == NULL)
+	{
+		ssize_t length;
+		if (reader->fd == -1) break; /* String reader: nothing more to read */
+
+		/* Move the incomplete line to the front and make room for a full read */
+		if (reader->start > 0)
+		{
+			memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+			reader->end -= reader->start;
+			reader->start = 0;
+		}
+		if (reader->size - reader->end < READER_BUFFER / 2)
+		{
+			char * aux = (char *) realloc(reader->buffer, reader->size * 2);
+			if (!aux)
+			{
+				perror("error reading the command");
+				exit(-1);
+			}
+			reader->buffer = aux;
+			reader->size *= 2;
+		}
+
+		/* Read what the user enters on the command line */
+		length = read(reader->fd, reader->buffer + reader->end, reader->size - reader->end - 1);
+		if (length < 0)
+		{
+			if (errno == EINTR) continue;
+			perror("error reading the command");
+			exit(-1);           /* Terminate with error code of -1 */
+		}
+		if (length == 0) break; /* ^d was entered, end of user command stream */
+		reader->end += length;
+	}
+
+	line = reader->buffer + reader->start;
+	if (newline)
+	{
+		*newline = '\0';
+		reader->start = newline - reader->buffer + 1;
+	}
+	else
+	{
+		if (reader->start == reader->end) return NULL;
+		/* Last line without newline: there is always a spare byte to terminate it */
+		if (reader->end == reader->size)
+		{
+			char * aux = (char *) realloc(reader->buffer, reader->size + 1);
+			if (!aux) return NULL;
+			line = aux + (line - reader->buffer);
+			reader->buffer = aux;
+			reader->size++;
+		}
+		reader->buffer[reader->end] = '\0';
+		reader->start = reader->end;
+	}
+	return line;
+}
+
+/**
+ * Appends an argument to the reader's args array, keeping room for NULL
+ **/
+static void push_arg(command_reader * reader, char * arg)
+{
+	if (reader->num_args + 1 >= reader->max_args)
+	{
+		char ** aux = (char **) realloc(reader->args, reader->max_args * 2 * sizeof(char *));
+		if (!aux)
+		{
+			perror("error reading the command");
+			exit(-1);
+		}
+		reader->args = aux;
+		reader->max_args *= 2;
+	}
+	reader->args[reader->num_args++] = arg;
+}
+
+/**
+ *  get_command() reads in the next command line, separating it into distinct
+ *  tokens using whitespace as delimiters. '|' is a token by itself, '&' marks
+ *  a background command and ends the line (unless it follows '>' or '<', as
+ *  in 2>&1), and '#' starts a comment unless escaped as '\#'.
+ *  Returns the null-terminated args array (owned by the reader, valid until
+ *  the next call) or NULL at the end of the input. The number of arguments
+ *  is left in reader->num_args.
+ **/
+char ** get_command(command_reader * reader, int * background)
+{
+	char * line = read_line(reader);
+	char * r;      /* Next character examined */
+	char * w;      /* Where the next character of the current argument goes */
+	char * start;  /* Beginning of the current argument, NULL if none */
+
+	*background = 0;
+	reader->num_args = 0;
+	if (line == NULL) return NULL;
+	if (reader->record && line[strspn(line, " \t\r")] != '\0') reader->record(line);
+
+	/* Examine every character in the line, rewriting arguments in place */
+	start = NULL;
+	for (r = w = line; ; r++)
+	{
+		char c = *r;
+		if (c == '\\' && r[1] == '#')       /* Escaped comment symbol */
+		{
+			if (!start) start = w;
+			*w++ = '#';
+			r++;
+			continue;
+		}
+		if (c == '&' && start && (w[-1] == '>' || w[-1] == '<')) /* Descriptor copy, as in 2>&1 */
+		{
+			*w++ = c;
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\r' || c == '|' || c == '&' || c == '#' || c == '\0')
+		{
+			if (start)                      /* End of the current argument */
+			{
+				*w++ = '\0';
+				push_arg(reader, start);
+				start = NULL;
+			}
+			if (c == '|') push_arg(reader, "|");  /* Pipe is a token itself */
+			if (c == '&') *background = 1;        /* Background indicator */
+			if (c == '&' || c == '#' || c == '\0') break; /* Nothing else in this command */
+			continue;
+		}
+		if (!start) start = w;              /* Start of new argument */
+		*w++ = c;
+	}
+	reader->args[reader->num_args] = NULL; /* No more arguments to this command */
+	return reader->args;
+}
+
+static const char * syntax_error = NULL; /* Of the last parse that failed */
+
+/**
+ * Returns the message of the last syntax error found by
+ * parse_redirections() or parse_pipeline(). It is returned rather than
+ * printed, so a script can be compiled and its errors reported when the
+ * line is reached.
+ **/
+const char * parse_error(void)
+{
+	return syntax_error;
+}
+
+/**
+ * Recognizes a redirection operator token: an optional descriptor number
+ * followed by '<', '>' or '>>', or by '<&M' or '>&M' to copy descriptor M.
+ * Fills r and returns 1 if the operator takes a file name from the next
+ * argument, 2 if it is complete, or 0 if arg is not an operator.
+ **/
+static int redirection_operator(const char * arg, redirection * r)
+{
+	const char * p = arg;
+	int fd = -1;
+
+	if (*p >= '0' && *p <= '9')
+	{
+		fd = 0;
+		while (*p >= '0' && *p <= '9' && fd < 100000) fd = fd * 10 + (*p++ - '0');
+	}
+	if (*p == '<')
+	{
+		r->fd = fd == -1 ? STDIN_FILENO : fd;
+		r->flags = O_RDONLY;
+	}
+	else if (*p == '>')
+	{
+		r->fd = fd == -1 ? STDOUT_FILENO : fd;
+		r->flags = O_RDWR | O_CREAT | O_TRUNC;
+		if (p[1] == '>')
+		{
+			r->flags = O_RDWR | O_CREAT | O_APPEND;
+			p++;
+		}
+	}
+	else return 0;
+	p++;
+	r->file = NULL;
+	r->source = -1;
+	if (*p == '\0') return 1;
+
+	/* Copy of another descriptor, not for '>>' */
+	if (*p != '&' || p[1] < '0' || p[1] > '9' || (r->flags & O_APPEND)) return 0;
+	r->source = 0;
+	for (p++; *p >= '0' && *p <= '9' && r->source < 100000; p++) r->source = r->source * 10 + (*p - '0');
+	return *p == '\0' ? 2 : 0;
+}
+
+/**
+ * Extracts the redirections of a command line once args structure has been
+ * built, in a single pass. Call the function immediately after get_command():
+ *      ...
+ *     while(...){
+ *          // Shell main loop
+ *          ...
+ *          get_command(...);
+ *          redirection list[MAX];
+ *          int n = parse_redirections(args, list, MAX);
+ *          ...
+ *     }
+ *
+ * The operators and their file names are removed from args and stored in
+ * list in their order of appearance, which is the order they are applied
+ * in: "> log 2>&1" sends both outputs to log. Each one is tagged with the
+ * pipeline stage it was written in.
+ * For a valid redirection, a blank space is required before and after
+ * redirection operators, except '&' in "N>&M".
+ * Returns the number of redirections, or -1 if a file name is missing or
+ * there are more than max_redirections (see parse_error()).
+ **/
+int parse_redirections(char **args, redirection *list, int max_redirections)
+{
+	char **r, **w;  /* Next argument examined, where the next kept argument goes */
+	int n = 0, stage = 0;
+
+	for (r = w = args; *r; r++)
+	{
+		redirection item;
+		int kind = redirection_operator(*r, &item);
+		if (kind == 0)
+		{
+			if (!strcmp(*r, "|")) stage++;
+			*w++ = *r;
+			continue;
+		}
+		if (kind == 1)
+		{
+			if (r[1] == NULL || !strcmp(r[1], "|"))
+			{
+				syntax_error = "syntax error in redirection";
+				return -1;
+			}
+			item.file = *++r;
+		}
+		if (n == max_redirections)
+		{
+			syntax_error = "too many redirections";
+			return -1;
+		}
+		item.stage = stage;
+		list[n++] = item;
+	}
+	*w = NULL;
+	return n;
+}
+
+/**
+ * Splits a command line at the '|' tokens produced by get_command(). Call it
+ * after parse_redirections(), so the redirections keep the stage they were
+ * written in.
+ * Each '|' is replaced by NULL and stages[i] points to the arguments of the
+ * i-th stage. Returns the number of stages (0 for an empty command), or -1
+ * if a stage is empty or there are more than max_stages (see parse_error()).
+ **/
+int parse_pipeline(char **args, char **stages[], int max_stages)
+{
+	int n = 0;
+	if (args[0] == NULL) return 0;
+	stages[n++] = args;
+	while (*args)
+	{
+		if (!strcmp(*args, "|"))
+		{
+			*args = NULL;
+			if (*stages[n-1] == NULL || args[1] == NULL || n == max_stages)
+			{
+				syntax_error = "syntax error in pipeline";
+				return -1;
+			}
+			stages[n++] = args + 1;
+		}
+		args++;
+	}
+	return n;
+}
+
+/**
+ * Job records are carved out of slabs and recycled through a free list, so
+ * launching and finishing jobs does not call malloc() for each record (nor
+ * for its command, stored in the record when it is short).
+ **/
+#define JOB_SLAB_SIZE 256       /* Job records per slab */
+#define JOB_LIST_INITIAL 64     /* Initial buckets and slots of a job list */
+
+static job * free_jobs = NULL;  /* Recycled records, chained through next */
+
+static job * alloc_job(void)
+{
+	job * aux;
+	if (!free_jobs)
+	{
+		job * slab = (job *) malloc(JOB_SLAB_SIZE * sizeof(job));
+		int i;
+		if (!slab) return NULL;
+		for (i = 0; i < JOB_SLAB_SIZE; i++)
+		{
+			slab[i].next = free_jobs;
+			free_jobs = &slab[i];
+		}
+	}
+	aux = free_jobs;
+	free_jobs = aux->next;
+	return aux;
+}
+
+/**
+ * Process index: every live process of every job (listed or in the
+ * foreground), so a pid returned by waitpid(-1) maps to its job in O(1).
+ * Entries are recycled through a free list like job records.
+ **/
+#define PROCESS_INDEX_INITIAL 256
+
+static process ** proc_buckets = NULL;
+static int proc_num_buckets = 0;
+static int proc_count = 0;
+static process * free_procs = NULL;
+
+static unsigned int proc_bucket(pid_t pid)
+{
+	return ((unsigned int) pid * 2654435761u) & (proc_num_buckets - 1);
+}
+
+static int grow_process_index(void)
+{
+	int size = proc_num_buckets ? proc_num_buckets * 2 : PROCESS_INDEX_INITIAL, i;
+	process ** buckets = (process **) calloc(size, sizeof(process *));
+	if (!buckets) return 0;
+	for (i = 0; i < proc_num_buckets; i++)
+	{
+		process * aux = proc_buckets[i];
+		while (aux)
+		{
+			process * next = aux->hash_next;
+			unsigned int b = ((unsigned int) aux->pid * 2654435761u) & (size - 1);
+			aux->hash_next = buckets[b];
+			buckets[b] = aux;
+			aux = next;
+		}
+	}
+	free(proc_buckets);
+	proc_buckets = buckets;
+	proc_num_buckets = size;
+	return 1;
+}
+
+static process * find_process(pid_t pid)
+{
+	process * aux;
+	if (!proc_num_buckets) return NULL;
+	aux = proc_buckets[proc_bucket(pid)];
+	while (aux && aux->pid != pid) aux = aux->hash_next;
+	return aux;
+}
+
+/**
+ * Returns the process group of a tracked process, 0 if it is unknown
+ **/
+pid_t process_pgid(pid_t pid)
+{
+	process * p = find_process(pid);
+	return p ? p->owner->pgid : 0;
+}
+
+/**
+ * Removes a process from the pid index and from its job
+ **/
+static void untrack_process(process * p)
+{
+	process ** link = &proc_buckets[proc_bucket(p->pid)];
+	while (*link != p) link = &(*link)->hash_next;
+	*link = p->hash_next;
+
+	link = &p->owner->procs;
+	while (*link != p) link = &(*link)->next;
+	*link = p->next;
+
+	p->next = free_procs;
+	free_procs = p;
+	proc_count--;
+}
+
+/**
+ * Registers pid as a process of the job, so its state changes are applied
+ * to it by apply_child_event(). new_job() already registers the leader.
+ **/
+void track_process(job * item, pid_t pid)
+{
+	process * p;
+	unsigned int b;
+
+	if (pid <= 0) return;
+	if (proc_count >= proc_num_buckets && !grow_process_index() && !proc_num_buckets) return;
+	if (free_procs)
+	{
+		p = free_procs;
+		free_procs = p->next;
+	}
+	else
+	{
+		p = (process *) malloc(sizeof(process));
+		if (!p) return;
+	}
+	p->pid = pid;
+	p->owner = item;
+	p->next = item->procs;
+	item->procs = p;
+	b = proc_bucket(pid);
+	p->hash_next = proc_buckets[b];
+	proc_buckets[b] = p;
+	proc_count++;
+}
+
+/**
+ * Bucket of the pgid index for a pid (multiplicative hashing)
+ **/
+static unsigned int pid_bucket(job_list * list, pid_t pid)
+{
+	return ((unsigned int) pid * 2654435761u) & (list->num_buckets - 1);
+}
+
+/**
+ * Fenwick tree helpers over the insertion slots. The tree stores 1 for every
+ * slot holding a job, so the n-th job in slot order is found in O(log n).
+ **/
+static void fenwick_add(job_list * list, int slot, int delta)
+{
+	int i;
+	for (i = slot + 1; i <= list->num_slots; i += i & -i) list->fenwick[i] += delta;
+}
+
+static int fenwick_find(job_list * list, int k)
+{
+	int pos = 0, step = 1;
+	while (step * 2 <= list->num_slots) step *= 2;
+	for (; step; step /= 2)
+	{
+		if (pos + step <= list->num_slots && list->fenwick[pos + step] < k)
+		{
+			pos += step;
+			k -= list->fenwick[pos];
+		}
+	}
+	return pos; /* 0-based slot */
+}
+
+/**
+ * Gives consecutive slots to the live jobs (oldest first) and rebuilds the
+ * Fenwick tree, doubling the capacity when more than half of it is in use.
+ * Called when the slots run out; amortized O(1) per added job. Without
+ * memory to grow, the slots of removed jobs are reused.
+ * Returns 0 if every slot is in use and the capacity could not grow.
+ **/
+static int renumber_slots(job_list * list)
+{
+	int size = list->num_slots, i;
+	job * aux;
+
+	if (list->count * 2 > size) size *= 2;
+	if (size != list->num_slots)
+	{
+		job ** slots = (job **) realloc(list->slots, size * sizeof(job *));
+		int * fenwick = NULL;
+		if (slots)
+		{
+			list->slots = slots;
+			fenwick = (int *) realloc(list->fenwick, (size + 1) * sizeof(int));
+		}
+		if (fenwick)
+		{
+			list->fenwick = fenwick;
+			list->num_slots = size;
+		}
+		else if (list->count == list->num_slots) return 0;
+		size = list->num_slots;
+	}
+	memset(list->slots, 0, size * sizeof(job *));
+	memset(list->fenwick, 0, (size + 1) * sizeof(int));
+
+	i = list->count;
+	for (aux = list->first; aux; aux = aux->next)
+	{
+		aux->slot = --i;
+		list->slots[aux->slot] = aux;
+	}
+	/* Linear construction: every node pushes its sum to its parent */
+	for (i = 1; i <= size; i++)
+	{
+		int parent = i + (i & -i);
+		if (list->slots[i - 1]) list->fenwick[i]++;
+		if (parent <= size) list->fenwick[parent] += list->fenwick[i];
+	}
+	list->next_slot = list->count;
+	return 1;
+}
+
+/**
+ * Doubles the buckets of the pgid index and rehashes every job
+ **/
+static int grow_buckets(job_list * list)
+{
+	job ** buckets = (job **) calloc(list->num_buckets * 2, sizeof(job *));
+	job * aux;
+	if (!buckets) return 0;
+	free(list->buckets);
+	list->buckets = buckets;
+	list->num_buckets *= 2;
+	for (aux = list->first; aux; aux = aux->next)
+	{
+		unsigned int b = pid_bucket(list, aux->pgid);
+		aux->hash_next = list->buckets[b];
+		list->buckets[b] = aux;
+	}
+	return 1;
+}
+
+/**
+ * Returns a new empty job list with the given name.
+ * Returns NULL if memory allocation fails
+ **/
+job_list * new_job_list(const char * name)
+{
+	job_list * list = (job_list *) calloc(1, sizeof(job_list));
+	if (!list) return NULL;
+	list->name = strdup(name);
+	list->num_buckets = JOB_LIST_INITIAL;
+	list->buckets = (job **) calloc(JOB_LIST_INITIAL, sizeof(job *));
+	list->num_slots = JOB_LIST_INITIAL;
+	list->slots = (job **) calloc(JOB_LIST_INITIAL, sizeof(job *));
+	list->fenwick = (int *) calloc(JOB_LIST_INITIAL + 1, sizeof(int));
+	if (!list->name || !list->buckets || !list->slots || !list->fenwick)
+	{
+		free(list->name);
+		free(list->buckets);
+		free(list->slots);
+		free(list->fenwick);
+		free(list);
+		return NULL;
+	}
+	return list;
+}
+
+/**
+ * Returns a pointer to a list item with its fields initialized.
+ * Returns NULL if memory allocation fails
+ **/
+job * new_job(pid_t pid, const char * command, enum job_state state)
+{
+	job * aux;
+	aux=alloc_job();
+	if (!aux) return NULL;
+	aux->pgid=pid;
+	aux->state=state;
+	/* The command lives in the record, like the record lives in its slab */
+	if (strlen(command) < JOB_COMMAND_INLINE)
+		aux->command=strcpy(aux->command_buffer, command);
+	else
+		aux->command=strdup(command);
+	if (!aux->command)
+	{
+		aux->next=free_jobs;
+		free_jobs=aux;
+		return NULL;
+	}
+	aux->nprocs=1;
+	aux->nstopped=0;
+	aux->last_pid=pid;
+	aux->last_status=0;
+	aux->stop_status=0;
+	aux->procs=NULL;
+	aux->pidfd=-1;
+	aux->next=NULL;
+	aux->prev=NULL;
+	aux->hash_next=NULL;
+	aux->slot=-1;
+	aux->team=NULL;
+	aux->timed=0;
+	aux->cpus[0]='\0';
+	aux->start_ns=monotonic_ns();
+	aux->end_ns=0;
+	memset(&aux->usage, 0, sizeof(job_usage));
+	track_process(aux, pid);
+	return aux;
+}
+
+/**
+ * Releases an item that is not (or no longer) in a list. Its processes still
+ * alive are forgotten: their state changes will be discarded. Closing its
+ * pidfd also removes it from the event loop.
+ **/
+void free_job(job * item)
+{
+	while (item->procs) untrack_process(item->procs);
+	if (item->pidfd != -1) close(item->pidfd);
+	if (item->command != item->command_buffer) free(item->command);
+	item->next=free_jobs;
+	free_jobs=item;
+}
+
+/**
+ * Inserts an item as head of the list, O(1) amortized
+ * Returns 0 if it could not be added (out of memory), the item is left to the caller.
+ **/
+int add_job (job_list * list, job * item)
+{
+	unsigned int b;
+
+	if (list->next_slot == list->num_slots && !renumber_slots(list)) return 0;
+	if (list->count >= list->num_buckets) grow_buckets(list);
+
+	item->prev=NULL;
+	item->next=list->first;
+	if (list->first) list->first->prev=item;
+	list->first=item;
+
+	b=pid_bucket(list, item->pgid);
+	item->hash_next=list->buckets[b];
+	list->buckets[b]=item;
+
+	item->slot=list->next_slot++;
+	list->slots[item->slot]=item;
+	fenwick_add(list, item->slot, 1);
+	list->count++;
+	return 1;
+}
+
+/**
+ * Takes the item passed as second argument out of the list without
+ * releasing it (e.g. to run it in the foreground).
+ * Returns 0 if the item does not exist.
+ **/
+int remove_job(job_list * list, job * item)
+{
+	job ** link;
+	if (item->slot < 0 || item->slot >= list->num_slots || list->slots[item->slot] != item) return 0;
+
+	link=&list->buckets[pid_bucket(list, item->pgid)];
+	while (*link != item) link=&(*link)->hash_next;
+	*link=item->hash_next;
+
+	if (item->prev) item->prev->next=item->next;
+	else list->first=item->next;
+	if (item->next) item->next->prev=item->prev;
+
+	list->slots[item->slot]=NULL;
+	fenwick_add(list, item->slot, -1);
+	list->count--;
+	item->next=item->prev=item->hash_next=NULL;
+	item->slot=-1;
+	return 1;
+}
+
+/**
+ * Deletes from the list the item passed as second argument.
+ * Returns 0 if the item does not exist.
+ **/
+int delete_job(job_list * list, job * item)
+{
+	if (!remove_job(list, item)) return 0;
+	free_job(item);
+	return 1;
+}
+
+/**
+ * Looks an item up by its PID and returns it.
+ * Returns NULL if the item is not found.
+ **/
+job * get_item_bypid  (job_list * list, pid_t pid)
+{
+	job * aux=list->buckets[pid_bucket(list, pid)];
+	while(aux != NULL && aux->pgid != pid) aux=aux->hash_next;
+	return aux;
+}
+
+/**
+ * Looks an item up by its position inside the list, beginning with 1 (the
+ * most recent job), and returns it. Position n is the (count-n+1)-th live
+ * slot, found in O(log n) through the Fenwick tree.
+ * Returns NULL if the item is not found.
+ **/
+job * get_item_bypos( job_list * list, int n)
+{
+	if(n<1 || n>list->count) return NULL;
+	return list->slots[fenwick_find(list, list->count - n + 1)];
+}
+
+/**
+ * Prints a line with the info o an item: pid, command name and state
+ **/
+void print_item(job * item)
+{
+
+	printf("pid: %d, command: %s, state: %s", item->pgid, item->command, state_strings[item->state]);
+	if (item->cpus[0]) printf(", cpus: %s", item->cpus);
+	printf("\n");
+}
+
+/**
+ * Prints a job with its elapsed time and the pids of its live processes
+ **/
+void print_item_long(job * item)
+{
+	process * p;
+	long long end = item->end_ns ? item->end_ns : monotonic_ns();
+	printf("pid: %d, command: %s, state: %s, elapsed: %.3f s, ", item->pgid, item->command,
+		state_strings[item->state], (end - item->start_ns) / 1e9);
+	if (item->cpus[0]) printf("cpus: %s, ", item->cpus);
+	printf("processes:");
+	for (p = item->procs; p; p = p->next) printf(" %d", p->pid);
+	printf("\n");
+}
+
+/**
+ * Walks the list and call print function for each item in it
+ **/
+void print_list(job_list * list, void (*print)(job *))
+{
+	int n=1;
+	job * aux=list->first;
+	printf("Contents of %s:\n",list->name);
+	while(aux!= NULL) 
+	{
+		printf(" [%d] ",n);
+		print(aux);
+		n++;
+		aux=aux->next;
+	}
+}
+
+/**
+ * Interpret the status value returned by wait */
+enum status analyze_status(int status, int *info)
+{
+	/* Suspended process */
+	if (WIFSTOPPED (status))
+	{
+		*info=WSTOPSIG(status);
+		return(SUSPENDED);
+	}
+	/* Continued process */
+    else if (WIFCONTINUED(status))
+    { 
+        *info=0; 
+        return(CONTINUED);
+    }
+    /* Terminated process by signal*/
+	else if (WIFSIGNALED (status))
+	{
+		*info=WTERMSIG (status);
+		return(SIGNALED);
+	}
+	/*Terminated process by exit */
+	else if (WIFEXITED (status))
+	{
+		*info=WEXITSTATUS(status);
+		return(EXITED);
+	}
+	/* Should never get here*/
+	return -1;
+}
+
+/**
+ * Queue of child state changes. reap_children() is the only producer and
+ * pop_child_event() the only consumer. Both run in the shell's thread, from
+ * update_jobs() when the signalfd reports SIGCHLD, so the queue needs no locks.
+ * Terminated children carry the resources they used.
+ **/
+#define CHILD_EVENT_QUEUE 4096 /* Power of two */
+
+static struct { pid_t pid; int status; job_usage usage; } child_events[CHILD_EVENT_QUEUE];
+static volatile sig_atomic_t events_head = 0, events_tail = 0;
+
+/**
+ * Collects the children that changed state with wait4(-1), one system
+ * call per event plus the final one that finds nothing, and queues them
+ * with their resource usage. Called by update_jobs() once per SIGCHLD read
+ * from the signalfd. When the queue is full the remaining children are left
+ * waitable and picked up by the next call.
+ **/
+void reap_children(void)
+{
+	int saved_errno = errno, status;
+	struct rusage ru;
+	pid_t pid;
+	while ((unsigned int) (events_tail - events_head) < CHILD_EVENT_QUEUE &&
+		(pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &ru)) > 0)
+	{
+		unsigned int i = events_tail & (CHILD_EVENT_QUEUE - 1);
+		child_events[i].pid = pid;
+		child_events[i].status = status;
+		child_events[i].usage.utime_us = (long long) ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec;
+		child_events[i].usage.stime_us = (long long) ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec;
+		child_events[i].usage.maxrss_kb = ru.ru_maxrss;
+		child_events[i].usage.minflt = ru.ru_minflt;
+		child_events[i].usage.majflt = ru.ru_majflt;
+		child_events[i].usage.nvcsw = ru.ru_nvcsw;
+		child_events[i].usage.nivcsw = ru.ru_nivcsw;
+		events_tail++;
+		trace(TRACE_REAP, pid, process_pgid(pid), status);
+	}
+	errno = saved_errno;
+}
+
+/**
+ * Takes the oldest queued state change and, if usage is not NULL, the
+ * resources used by the child (zero unless it terminated). update_jobs()
+ * calls it right after reap_children().
+ * Returns 0 if the queue is empty.
+ **/
+int pop_child_event(pid_t * pid, int * status, job_usage * usage)
+{
+	unsigned int i = events_head & (CHILD_EVENT_QUEUE - 1);
+	if (events_head == events_tail) return 0;
+	*pid = child_events[i].pid;
+	*status = child_events[i].status;
+	if (usage) *usage = child_events[i].usage;
+	events_head++;
+	return 1;
+}
+
+/**
+ * Applies a state change of process pid to its job: keeps the counts of
+ * live and stopped processes, the latest stop status and the status of the
+ * last stage up to date. The usage of a terminated process (may be NULL)
+ * is added to the job, and the job's end time is set with the last one.
+ * Returns the job, or NULL if the process belongs to no known job.
+ **/
+job * apply_child_event(pid_t pid, int status, const job_usage * usage)
+{
+	process * p = find_process(pid);
+	job * item;
+	if (!p) return NULL;
+	item = p->owner;
+
+	if (WIFSTOPPED(status))
+	{
+		item->nstopped++;
+		item->stop_status = status;
+	}
+	else if (WIFCONTINUED(status))
+	{
+		if (item->nstopped > 0) item->nstopped--;
+	}
+	else
+	{
+		item->nprocs--;
+		if (item->nstopped > item->nprocs) item->nstopped = item->nprocs;
+		if (pid == item->last_pid) item->last_status = status;
+		if (usage)
+		{
+			item->usage.utime_us += usage->utime_us;
+			item->usage.stime_us += usage->stime_us;
+			if (usage->maxrss_kb > item->usage.maxrss_kb) item->usage.maxrss_kb = usage->maxrss_kb;
+			item->usage.minflt += usage->minflt;
+			item->usage.majflt += usage->majflt;
+			item->usage.nvcsw += usage->nvcsw;
+			item->usage.nivcsw += usage->nivcsw;
+		}
+		if (item->nprocs == 0) item->end_ns = monotonic_ns();
+		untrack_process(p);
+	}
+	return item;
+}
+
+/**
+ * CLOCK_MONOTONIC time in nanoseconds
+ **/
+long long monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Changes default action for terminal related signals
+ **/
+void terminal_signals(void (*func) (int))
+{
+	signal (SIGINT,  func); /* crtl+c Interrupt from keyboard */
+	signal (SIGQUIT, func); /* ctrl+\ Quit from keyboard */
+	signal (SIGTSTP, func); /* crtl+z Stop typed at keyboard */
+	signal (SIGTTIN, func); /* Background process tries terminal input */
+	signal (SIGTTOU, func); /* Background process tries terminal output */
+}		
+
+/**
+ * Blocks or masks a signal.
+ * The signal handler execution for the signal is deferred until the signal
+ * is unblocked.
+ * If several instances of the signal ocurred after being blocked, when
+ * unblocked, the handler for that signal executes only once.
+ **/
+void block_signal(int signal, int block)
+{
+	/* Declare and initialize signal masks */
+	sigset_t block_sigchld;
+	sigemptyset(&block_sigchld);
+	sigaddset(&block_sigchld,signal);
+	if(block)
+	{
+		/* Blocks signal */
+		sigprocmask(SIG_BLOCK, &block_sigchld, NULL);
+	}
+	else
+	{
+		/* Unblocks signal */
+		sigprocmask(SIG_UNBLOCK, &block_sigchld, NULL);
+	}
 }
\ No newline at end of file
@@ -1,96 +1,187 @@
-// FELIPE OEHLER GUZMÁN
-
-/**
- * Linux Job Control Shell Project
- * Function prototypes, macros and type declarations for job_control module
- *
- * Operating Systems
- * Grados Ing. Informatica & Software
- * Dept. de Arquitectura de Computadores - UMA
- *
- * Some code adapted from "Operating System Concepts Essentials", Silberschatz et al.
- **/
-#ifndef _JOB_CONTROL_H
-#define _JOB_CONTROL_H
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <termios.h>
-#include <signal.h>
-#include <sys/wait.h>
-#include <dirent.h>
-
-/**
- * Enumerations
- **/
-enum status { SUSPENDED, SIGNALED, EXITED, CONTINUED};
-enum job_state { FOREGROUND, BACKGROUND, STOPPED };
-static char* status_strings[] = { "Suspended", "Signaled", "Exited", "Continued"};
-static char* state_strings[] = { "Foreground", "Background", "Stopped" };
-
-/* Job type for job list */
-typedef struct job_
-{
-	pid_t pgid; /* Group id = process lider id */
-	char * command; /* Program name */
-	enum job_state state;
-	struct job_ *next; /* Next job in the list */
-} job;
-
-/* Type for job list iterator */
-typedef job * job_iterator;
-
-/**
- * Public Functions
- **/
-void get_command(char inputBuffer[], int size, char *args[],int *background);
-void parse_redirections(char **args,  char **file_in, char **file_out);
-job * new_job(pid_t pid, const char * command, enum job_state state);
-void add_job(job * list, job * item);
-int delete_job(job * list, job * item);
-job * get_item_bypid(job * list, pid_t pid);
-job * get_item_bypos(job * list, int n);
-enum status analyze_status(int status, int *info);
-
-/**
- * Private Functions: Better use through macros below
- **/
-void print_item(job * item);
-void print_list(job * list, void (*print)(job *));
-void terminal_signals(void (*func) (int));
-void block_signal(int signal, int block);
-
-/**
- * Public macros
- **/
-
-#define list_size(list)    list->pgid     /* Number of jobs in the list */
-#define empty_list(list)   !(list->pgid)  /* Returns 1 (true) if the list is empty */
-
-#define new_list(name)     new_job(0,name,FOREGROUND)  /* Name must be const char * */
-
-#define get_iterator(list)   list->next   /* Return pointer to first job */
-#define has_next(iterator)   iterator     /* Return pointer to next job */
-#define next(iterator)       ({job_iterator old = iterator; iterator = iterator->next; old;}) /* Updates iterator to point to next job */
-
-#define print_job_list(list)   print_list(list, print_item)
-
-#define restore_terminal_signals()  terminal_signals(SIG_DFL)
-#define ignore_terminal_signals() 	terminal_signals(SIG_IGN)
-
-#define set_terminal(pid)        tcsetpgrp (STDIN_FILENO,pid)
-#define new_process_group(pid)   setpgid (pid, pid)
-
-#define block_SIGCHLD()   	 block_signal(SIGCHLD, 1)
-#define unblock_SIGCHLD() 	 block_signal(SIGCHLD, 0)
-
-/** Macro for debugging
- *    To debug integer i, use:    debug(i,%d);
- *    It will print out:  current line number, function name and file name, and also variable name, value and type
- **/
-#define debug(x,fmt) fprintf(stderr,"\"%s\":%u:%s(): --> %s= " #fmt " (%s)\n", __FILE__, __LINE__, __FUNCTION__, #x, x, #fmt)
-
-#endif
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes, macros and type declarations for job_control module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ *
+ * Some code adapted from "Operating System Concepts Essentials", Silberschatz et al.
+ **/
+#ifndef _JOB_CONTROL_H
+#define _JOB_CONTROL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <dirent.h>
+
+/**
+ * Enumerations
+ **/
+enum status { SUSPENDED, SIGNALED, EXITED, CONTINUED};
+enum job_state { FOREGROUND, BACKGROUND, STOPPED };
+extern char* status_strings[];  /* Names of enum status */
+extern char* state_strings[];   /* Names of enum job_state */
+
+/* Process of a job, indexed by pid so a reaped child can be mapped to its job */
+typedef struct process_
+{
+	pid_t pid;
+	struct job_ *owner;        /* Job the process belongs to */
+	struct process_ *hash_next; /* Next process in the same bucket of the pid index */
+	struct process_ *next;     /* Next process of the same job */
+} process;
+
+/* Resources used by the finished processes of a job (from wait4) */
+typedef struct job_usage_
+{
+	long long utime_us;  /* User CPU time */
+	long long stime_us;  /* System CPU time */
+	long maxrss_kb;      /* Largest resident set of any of its processes */
+	long minflt, majflt; /* Page faults without and with I/O */
+	long nvcsw, nivcsw;  /* Voluntary and involuntary context switches */
+} job_usage;
+
+#define JOB_COMMAND_INLINE 64 /* Commands up to this length are stored inside the job record */
+#define JOB_CPUS_LEN 32       /* Longer CPU lists are shown cut */
+
+/* Job type for job list */
+typedef struct job_
+{
+	pid_t pgid; /* Group id = process lider id */
+	char * command; /* Program name, points to command_buffer unless it is longer */
+	enum job_state state;
+	int nprocs;        /* Processes of the job (pipeline stages) still alive */
+	int nstopped;      /* Processes of the job currently stopped */
+	pid_t last_pid;    /* Last stage of the pipeline, its status is the job's status */
+	int last_status;   /* Status of the last stage once it has finished */
+	int stop_status;   /* Status of the latest stop of any of its processes */
+	process *procs;    /* Processes of the job still alive */
+	int pidfd;         /* pidfd of the leader watched by the event loop, -1 if none */
+	struct job_ *next; /* Next job in the list */
+	struct job_ *prev; /* Previous job in the list */
+	struct job_ *hash_next; /* Next job in the same bucket of the pgid index */
+	int slot;          /* Slot in the position index, -1 when not in a list */
+	void * team;       /* bgteam the job belongs to, NULL if none */
+	int timed;         /* 1 if launched by the time builtin */
+	long long start_ns, end_ns; /* CLOCK_MONOTONIC launch and end times, end_ns = 0 while alive */
+	job_usage usage;   /* Accumulated over its finished processes */
+	char cpus[JOB_CPUS_LEN]; /* CPU list it was pinned to, "" if it runs where the shell does */
+	char command_buffer[JOB_COMMAND_INLINE];
+} job;
+
+/* Job list: jobs in position order plus the indexes used to find them */
+typedef struct job_list_
+{
+	char * name;       /* Name of the list */
+	int count;         /* Number of jobs in the list */
+	job * first;       /* Most recent job, position 1 */
+	job ** buckets;    /* pgid hash index, chained through hash_next */
+	int num_buckets;   /* Always a power of two */
+	job ** slots;      /* Jobs by insertion slot, NULL for deleted ones */
+	int * fenwick;     /* Live slot counts (Fenwick tree) to find the n-th job */
+	int num_slots;     /* Capacity of slots and fenwick */
+	int next_slot;     /* Slot given to the next added job */
+} job_list;
+
+/* Redirection of a command: '<' '>' '>>' 'N>' 'N>>' 'N<' 'N>&M' 'N<&M' */
+typedef struct redirection_
+{
+	int fd;            /* Descriptor of the command that is redirected */
+	const char * file; /* File opened on fd, NULL to copy source instead */
+	int flags;         /* open() flags for file */
+	int source;        /* Descriptor copied on fd when there is no file */
+	int stage;         /* Pipeline stage it belongs to (number of '|' before it) */
+} redirection;
+
+/* Buffered command reader for get_command() */
+typedef struct command_reader_
+{
+	int fd;            /* Input descriptor, -1 for a string reader */
+	char * buffer;     /* Bytes read and not consumed yet are [start, end) */
+	size_t size, start, end;
+	char ** args;      /* Arguments of the last command, NULL terminated */
+	int num_args, max_args;
+	int (*record)(const char * line); /* Given every non-blank line before it is split, NULL = none */
+} command_reader;
+
+/* Type for job list iterator */
+typedef job * job_iterator;
+
+/**
+ * Public Functions
+ **/
+void init_command_reader(command_reader * reader, int fd);
+void init_string_reader(command_reader * reader, const char * text);
+void feed_command_reader(command_reader * reader, const char * text);
+int command_pending(command_reader * reader);
+char ** get_command(command_reader * reader, int * background);
+int parse_redirections(char **args, redirection *list, int max_redirections);
+int parse_pipeline(char **args, char **stages[], int max_stages);
+const char * parse_error(void);
+job_list * new_job_list(const char * name);
+job * new_job(pid_t pid, const char * command, enum job_state state);
+void free_job(job * item);
+void track_process(job * item, pid_t pid);
+pid_t process_pgid(pid_t pid);
+int add_job(job_list * list, job * item);
+int remove_job(job_list * list, job * item);
+int delete_job(job_list * list, job * item);
+job * get_item_bypid(job_list * list, pid_t pid);
+job * get_item_bypos(job_list * list, int n);
+enum status analyze_status(int status, int *info);
+void reap_children(void);
+int pop_child_event(pid_t * pid, int * status, job_usage * usage);
+job * apply_child_event(pid_t pid, int status, const job_usage * usage);
+long long monotonic_ns(void);
+
+/**
+ * Private Functions: Better use through macros below
+ **/
+void print_item(job * item);
+void print_item_long(job * item);
+void print_list(job_list * list, void (*print)(job *));
+void terminal_signals(void (*func) (int));
+void block_signal(int signal, int block);
+
+/**
+ * Public macros
+ **/
+
+#define list_size(list)    list->count     /* Number of jobs in the list */
+#define empty_list(list)   !(list->count)  /* Returns 1 (true) if the list is empty */
+
+#define new_list(name)     new_job_list(name)  /* Name must be const char * */
+
+#define get_iterator(list)   list->first  /* Return pointer to first job */
+#define has_next(iterator)   iterator     /* Return pointer to next job */
+#define next(iterator)       ({job_iterator old = iterator; iterator = iterator->next; old;}) /* Updates iterator to point to next job */
+
+#define print_job_list(list)   print_list(list, print_item)
+#define print_job_list_long(list)   print_list(list, print_item_long)  /* With elapsed time and processes */
+
+#define restore_terminal_signals()  terminal_signals(SIG_DFL)
+#define ignore_terminal_signals() 	terminal_signals(SIG_IGN)
+
+#define set_terminal(pid)        tcsetpgrp (STDIN_FILENO,pid)
+#define new_process_group(pid)   setpgid (pid, pid)
+
+#define block_SIGCHLD()   	 block_signal(SIGCHLD, 1)
+#define unblock_SIGCHLD() 	 block_signal(SIGCHLD, 0)
+
+/** Macro for debugging
+ *    To debug integer i, use:    debug(i,%d);
+ *    It will print out:  current line number, function name and file name, and also variable name, value and type
+ **/
+#define debug(x,fmt) fprintf(stderr,"\"%s\":%u:%s(): --> %s= " #fmt " (%s)\n", __FILE__, __LINE__, __FUNCTION__, #x, x, #fmt)
+
+#endif
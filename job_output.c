@@ -0,0 +1,192 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * job_output module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "job_output.h"
+#include "event_loop.h"
+
+static job_output * oldest = NULL, * newest = NULL;
+static int num_closed = 0;          /* Logs whose pipe reached end of file */
+static unsigned long close_count = 0;
+
+/**
+ * Creates the pipe of a job about to be launched: write_fd goes to the
+ * job's stdout and stderr, and the read end is non-blocking for the shell.
+ * Both ends are close-on-exec. A pipe as large as the ring (when the system
+ * allows it) lets the job write bursts while the shell is busy.
+ * Returns the new log or NULL with errno set.
+ **/
+job_output * open_job_output(size_t size)
+{
+	job_output * out = (job_output *) calloc(1, sizeof(job_output));
+	int fds[2];
+
+	if (!out) return NULL;
+	if (pipe2(fds, O_CLOEXEC) == -1)
+	{
+		free(out);
+		return NULL;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK); /* Not on the job's end: its writes must block */
+	fcntl(fds[1], F_SETPIPE_SZ, (int) size);
+	out->fd = fds[0];
+	out->write_fd = fds[1];
+	out->size = size;
+	return out;
+}
+
+/**
+ * Frees the logs that reached end of file first, so that at most
+ * JOB_OUTPUT_KEEP of them remain.
+ **/
+static void release_old_outputs(void)
+{
+	while (num_closed > JOB_OUTPUT_KEEP)
+	{
+		job_output ** link, ** first = NULL, * prev = NULL, * first_prev = NULL, * out;
+		for (link = &oldest; *link; prev = *link, link = &(*link)->next)
+		{
+			if ((*link)->closed && (!first || (*link)->closed < (*first)->closed))
+			{
+				first = link;
+				first_prev = prev;
+			}
+		}
+		out = *first;
+		*first = out->next;
+		if (newest == out) newest = first_prev;
+		free(out->ring);
+		free(out);
+		num_closed--;
+	}
+}
+
+/**
+ * Keeps the last size bytes of what the job wrote.
+ **/
+static void store_output(job_output * out, const char * data, size_t n)
+{
+	size_t off;
+
+	if (!out->ring) out->ring = (char *) malloc(out->size);
+	out->written += n;
+	if (!out->ring) return; /* Counted but lost */
+	if (n > out->size)
+	{
+		data += n - out->size;
+		n = out->size;
+	}
+	off = (out->written - n) % out->size;
+	if (off + n <= out->size) memcpy(out->ring + off, data, n);
+	else
+	{
+		memcpy(out->ring + off, data, out->size - off);
+		memcpy(out->ring, data + out->size - off, n - (out->size - off));
+	}
+}
+
+/**
+ * Event handler for the read end of a log: drains the pipe until it is
+ * empty. At end of file (every process of the job, and of its children,
+ * closed it) the pipe is closed and the log kept.
+ **/
+static void output_event(int fd, unsigned int events, void * data)
+{
+	job_output * out = (job_output *) data;
+	char buff[8192];
+	ssize_t n;
+
+	while ((n = read(fd, buff, sizeof(buff))) > 0) store_output(out, buff, (size_t) n);
+	if (n == -1 && (errno == EAGAIN || errno == EINTR)) return;
+
+	event_loop_remove(fd);
+	close(fd);
+	out->fd = -1;
+	out->closed = ++close_count;
+	num_closed++;
+	release_old_outputs();
+}
+
+/**
+ * Called once the job has been launched (pgid > 0) or could not be
+ * (pgid <= 0, the log is discarded). The shell's copy of the write end is
+ * closed, so end of file arrives when the job's copies are.
+ **/
+void start_job_output(job_output * out, pid_t pgid, const char * command)
+{
+	close(out->write_fd);
+	out->write_fd = -1;
+	if (pgid <= 0 || event_loop_add(out->fd, output_event, out) == -1)
+	{
+		close(out->fd); /* Without a reader the job gets EPIPE instead of blocking */
+		free(out);
+		return;
+	}
+	out->pgid = pgid;
+	snprintf(out->command, sizeof(out->command), "%s", command);
+	if (newest) newest->next = out;
+	else oldest = out;
+	newest = out;
+}
+
+/**
+ * Returns the newest log of process group pgid, or NULL.
+ **/
+job_output * find_job_output(pid_t pgid)
+{
+	job_output * out, * found = NULL;
+	for (out = oldest; out; out = out->next)
+	{
+		if (out->pgid == pgid) found = out; /* pgids may be reused */
+	}
+	return found;
+}
+
+/**
+ * Returns the oldest log, the rest follow through next.
+ **/
+job_output * job_outputs(void)
+{
+	return oldest;
+}
+
+/**
+ * Writes to fd what the job wrote from position *pos on (0 = the start)
+ * and advances *pos. The part already overwritten in the ring is skipped.
+ * Returns the number of bytes written or -1 on error.
+ **/
+ssize_t copy_job_output(job_output * out, unsigned long long * pos, int fd)
+{
+	unsigned long long first = out->written > out->size ? out->written - out->size : 0;
+	ssize_t total = 0;
+
+	if (*pos < first || !out->ring) *pos = out->ring ? first : out->written;
+	while (*pos < out->written)
+	{
+		size_t off = *pos % out->size, chunk = out->size - off;
+		ssize_t n;
+		if (chunk > out->written - *pos) chunk = out->written - *pos;
+		n = write(fd, out->ring + off, chunk);
+		if (n == -1)
+		{
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		*pos += n;
+		total += n;
+	}
+	return total;
+}
@@ -0,0 +1,51 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the job_output module
+ *
+ * Output capture of background jobs. Each captured job writes its stdout
+ * and stderr to its own pipe instead of the terminal; the shell drains the
+ * pipe from the event loop without blocking and keeps the last bytes in a
+ * bounded ring per job, so workers never contend for the tty and their
+ * output does not interleave with each other or with the job reports.
+ * A log is kept after its job ends; once there are more than
+ * JOB_OUTPUT_KEEP finished ones, those that finished first are released.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _JOB_OUTPUT_H
+#define _JOB_OUTPUT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define JOB_OUTPUT_DEFAULT_SIZE (16 * 1024) /* Bytes kept per job */
+#define JOB_OUTPUT_KEEP 128                 /* Logs of finished jobs kept */
+
+/* Captured output of a job */
+typedef struct job_output_
+{
+	pid_t pgid;                  /* Job it belongs to, 0 until it is started */
+	char command[64];            /* Job label, cut if longer */
+	int fd;                      /* Read end drained by the shell, -1 after end of file */
+	int write_fd;                /* Write end given to the job, -1 once it is started */
+	char * ring;                 /* Last size bytes, allocated with the first ones */
+	size_t size;
+	unsigned long long written;  /* Bytes received, ring[written % size] is the next one */
+	unsigned long closed;        /* Order in which it reached end of file, 0 while open */
+	struct job_output_ * next;   /* Newer log */
+} job_output;
+
+/**
+ * Public Functions
+ **/
+job_output * open_job_output(size_t size);
+void start_job_output(job_output * out, pid_t pgid, const char * command);
+job_output * find_job_output(pid_t pgid);
+job_output * job_outputs(void);
+ssize_t copy_job_output(job_output * out, unsigned long long * pos, int fd);
+
+#endif
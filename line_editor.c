@@ -0,0 +1,600 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * line_editor module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "line_editor.h"
+#include "completion.h"
+#include "history.h"
+
+#define CONTROL(c) ((c) & 0x1f)
+#define LIST_MAX 200 /* More candidates are counted instead of listed */
+
+static struct termios saved_termios;
+static int raw = 0;
+
+static const char * prompt = "";
+static char * line = NULL;          /* Text being edited, always terminated */
+static size_t length = 0, cursor = 0, size = 0;
+static int active = 0, done = 0, at_eof = 0;
+static int num_jobs = 0;
+static int last_was_tab = 0;
+
+static int esc_state = 0;           /* 1 after ESC, 2 inside ESC [ or ESC O */
+static char esc_param[8];
+static size_t esc_length = 0;
+
+static char pending[256];           /* Read after the end of the line, for the next one */
+static size_t pending_start = 0, pending_end = 0;
+
+static long history_pos = 0;        /* Entry shown by Up/Down, 0 = the line being typed */
+static long history_total = 0;
+static char * saved_line = NULL;    /* The line being typed while browsing */
+
+static int searching = 0;           /* ^R mode */
+static char search[128];
+static size_t search_length = 0;
+static long search_found = 0;       /* Entry matched, 0 = none */
+static int search_failed = 0;
+
+static void set_raw(void)
+{
+	struct termios t;
+	if (raw || tcgetattr(STDIN_FILENO, &saved_termios) == -1) return;
+	t = saved_termios;
+	t.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+	t.c_iflag &= ~(IXON | ICRNL | INLCR);
+	t.c_cc[VMIN] = 1;
+	t.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSANOW, &t) == 0) raw = 1;
+}
+
+static void restore_terminal(void)
+{
+	if (!raw) return;
+	tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+	raw = 0;
+}
+
+static void put(const char * s, size_t n)
+{
+	while (n > 0)
+	{
+		ssize_t w = write(STDOUT_FILENO, s, n);
+		if (w == -1)
+		{
+			if (errno == EINTR) continue;
+			return;
+		}
+		s += w;
+		n -= w;
+	}
+}
+
+static void put_string(const char * s)
+{
+	put(s, strlen(s));
+}
+
+/* Columns taken by n bytes of UTF-8 text: continuation bytes take none */
+static size_t text_width(const char * s, size_t n)
+{
+	size_t width = 0, i;
+	for (i = 0; i < n; i++) if (((unsigned char) s[i] & 0xc0) != 0x80) width++;
+	return width;
+}
+
+static int ensure_size(size_t needed)
+{
+	size_t new_size = size ? size : 256;
+	char * aux;
+
+	if (needed + 1 <= size) return 0;
+	while (new_size < needed + 1) new_size *= 2;
+	aux = (char *) realloc(line, new_size);
+	if (!aux) return -1;
+	line = aux;
+	size = new_size;
+	return 0;
+}
+
+static void set_line(const char * text, size_t n)
+{
+	if (ensure_size(n) == -1) return;
+	memcpy(line, text, n);
+	line[n] = '\0';
+	length = cursor = n;
+}
+
+/**
+ * Draws the prompt and the line, scrolled sideways so the cursor stays on a
+ * single terminal row.
+ **/
+static void refresh(void)
+{
+	struct winsize ws;
+	char head[192], move[32];
+	const char * shown_prompt = prompt;
+	size_t columns = 80, avail, start = 0, end, width;
+
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) columns = ws.ws_col;
+	if (searching)
+	{
+		snprintf(head, sizeof(head), "(%sreverse-i-search)`%.*s': ", search_failed ? "failing " : "",
+			(int) search_length, search);
+		shown_prompt = head;
+	}
+	width = text_width(shown_prompt, strlen(shown_prompt));
+	avail = columns > width + 10 ? columns - width - 1 : 10;
+
+	while (text_width(line + start, cursor - start) > avail)
+	{
+		start++;
+		while (start < cursor && ((unsigned char) line[start] & 0xc0) == 0x80) start++;
+	}
+	for (end = start; end < length; end++)
+	{
+		if (((unsigned char) line[end] & 0xc0) != 0x80 && text_width(line + start, end - start) >= avail) break;
+	}
+
+	put_string("\r");
+	put_string(shown_prompt);
+	put(line + start, end - start);
+	put_string("\x1b[K\r");
+	width += text_width(line + start, cursor - start);
+	if (width > 0)
+	{
+		snprintf(move, sizeof(move), "\x1b[%zuC", width);
+		put_string(move);
+	}
+}
+
+static void insert_text(const char * text, size_t n)
+{
+	if (ensure_size(length + n) == -1) return;
+	memmove(line + cursor + n, line + cursor, length - cursor + 1);
+	memcpy(line + cursor, text, n);
+	length += n;
+	cursor += n;
+}
+
+static void delete_range(size_t from, size_t to)
+{
+	memmove(line + from, line + to, length - to + 1);
+	length -= to - from;
+	cursor = from;
+}
+
+static size_t previous_char(size_t pos)
+{
+	if (pos == 0) return 0;
+	pos--;
+	while (pos > 0 && ((unsigned char) line[pos] & 0xc0) == 0x80) pos--;
+	return pos;
+}
+
+static size_t next_char(size_t pos)
+{
+	if (pos >= length) return length;
+	pos++;
+	while (pos < length && ((unsigned char) line[pos] & 0xc0) == 0x80) pos++;
+	return pos;
+}
+
+static void finish_line(void)
+{
+	searching = 0;
+	cursor = length;
+	refresh();
+	put_string("\r\n");
+	restore_terminal();
+	done = 1;
+}
+
+/**
+ * Shows history entry n (history_total + 1 = the line being typed).
+ **/
+static void show_history(long n)
+{
+	size_t entry_length;
+	const char * entry;
+
+	if (history_pos == 0)
+	{
+		free(saved_line);
+		saved_line = strdup(line);
+		history_total = history_count();
+		history_pos = history_total + 1;
+	}
+	if (n < 1 || n > history_total + 1) return;
+	history_pos = n;
+	if (n == history_total + 1) set_line(saved_line ? saved_line : "", saved_line ? strlen(saved_line) : 0);
+	else if ((entry = history_entry(n, &entry_length)) != NULL) set_line(entry, entry_length);
+}
+
+/**
+ * ^R: searches the history backwards for the text typed so far, from entry
+ * before (0 = the newest), and shows the match with the cursor on it.
+ **/
+static void search_history(long before)
+{
+	size_t entry_length;
+	const char * entry, * match;
+	long n;
+
+	search[search_length] = '\0';
+	n = history_search(search, before);
+	search_failed = (n == 0);
+	if (n == 0 || (entry = history_entry(n, &entry_length)) == NULL) return;
+	search_found = n;
+	set_line(entry, entry_length);
+	match = memmem(line, length, search, search_length);
+	cursor = match ? (size_t) (match - line) : length;
+}
+
+/**
+ * Replaces the word being completed, [start, cursor), with the candidate.
+ **/
+static void replace_word(size_t start, const char * text)
+{
+	delete_range(start, cursor);
+	insert_text(text, strlen(text));
+}
+
+static void list_candidates(const completions * c)
+{
+	struct winsize ws;
+	size_t columns = 80, widest = 0, per_row;
+	int i;
+
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) columns = ws.ws_col;
+	put_string("\r\n");
+	if (c->count > LIST_MAX)
+	{
+		char message[64];
+		snprintf(message, sizeof(message), "%d candidates\r\n", c->count);
+		put_string(message);
+		refresh();
+		return;
+	}
+	for (i = 0; i < c->count; i++)
+	{
+		const char * name = c->names[i];
+		size_t n = strlen(name), start = n;
+		while (start > 0 && name[start - 1] == '/') start--; /* A directory keeps its '/' */
+		while (start > 0 && name[start - 1] != '/') start--;
+		if (n - start > widest) widest = n - start;
+	}
+	widest += 2;
+	per_row = columns / widest ? columns / widest : 1;
+	for (i = 0; i < c->count; i++)
+	{
+		const char * name = c->names[i];
+		size_t n = strlen(name), start = n;
+		char cell[PATH_MAX + 2];
+		while (start > 0 && name[start - 1] == '/') start--;
+		while (start > 0 && name[start - 1] != '/') start--;
+		snprintf(cell, sizeof(cell), "%-*s", (int) widest, name + start);
+		put_string(cell);
+		if ((i + 1) % per_row == 0 || i + 1 == c->count) put_string("\r\n");
+	}
+	refresh();
+}
+
+/**
+ * Tab: completes the word before the cursor as a command (first word of a
+ * pipeline stage, without '/'), a job spec (%n) or a file. A single
+ * candidate is inserted whole; several are extended to their common
+ * prefix, and listed by a second Tab that adds nothing.
+ **/
+static void complete(int second_tab)
+{
+	completions c = { NULL, 0, 0 };
+	size_t start = cursor, before, common;
+	char * word;
+	int i;
+
+	while (start > 0 && !strchr(" \t|&", line[start - 1])) start--;
+	for (before = start; before > 0 && (line[before - 1] == ' ' || line[before - 1] == '\t'); before--);
+	word = strndup(line + start, cursor - start);
+	if (!word) return;
+
+	if (word[0] == '%')
+	{
+		for (i = 1; i <= num_jobs; i++)
+		{
+			char spec[16];
+			snprintf(spec, sizeof(spec), "%%%d", i);
+			if (!strncmp(spec, word, strlen(word))) add_completion(&c, spec, strlen(spec), "");
+		}
+	}
+	else if ((before == 0 || line[before - 1] == '|') && !strchr(word, '/'))
+		complete_command(word, &c);
+	else
+		complete_file(word, &c);
+
+	if (c.count == 0)
+	{
+		put_string("\a");
+	}
+	else if (c.count == 1)
+	{
+		replace_word(start, c.names[0]);
+		if (c.names[0][strlen(c.names[0]) - 1] != '/') insert_text(" ", 1);
+		refresh();
+	}
+	else
+	{
+		for (common = strlen(c.names[0]), i = 1; i < c.count; i++)
+		{
+			size_t j = 0;
+			while (j < common && c.names[i][j] == c.names[0][j]) j++;
+			common = j;
+		}
+		if (common > strlen(word))
+		{
+			c.names[0][common] = '\0';
+			replace_word(start, c.names[0]);
+			refresh();
+		}
+		else if (second_tab) list_candidates(&c);
+		else put_string("\a");
+	}
+	free_completions(&c);
+	free(word);
+}
+
+/**
+ * Handles the final byte of an escape sequence (ESC [ ... or ESC O ...).
+ **/
+static void escape_key(char final)
+{
+	int number = atoi(esc_param);
+
+	if (final == 'A') show_history(history_pos ? history_pos - 1 : history_count());
+	else if (final == 'B' && history_pos) show_history(history_pos + 1);
+	else if (final == 'C') cursor = next_char(cursor);
+	else if (final == 'D') cursor = previous_char(cursor);
+	else if (final == 'H' || (final == '~' && (number == 1 || number == 7))) cursor = 0;
+	else if (final == 'F' || (final == '~' && (number == 4 || number == 8))) cursor = length;
+	else if (final == '~' && number == 3 && cursor < length) delete_range(cursor, next_char(cursor));
+}
+
+/**
+ * Handles a key typed during a ^R search. Returns 1 if it was consumed, 0
+ * if it ends the search and has to be handled as a normal key.
+ **/
+static int search_key(unsigned char c)
+{
+	if (c == CONTROL('R'))
+	{
+		if (search_length > 0) search_history(search_found);
+		return 1;
+	}
+	if (c == CONTROL('G') || c == CONTROL('C'))
+	{
+		searching = 0;
+		set_line(saved_line ? saved_line : "", saved_line ? strlen(saved_line) : 0);
+		return 1;
+	}
+	if (c == 127 || c == CONTROL('H'))
+	{
+		if (search_length > 0) search_length--;
+		search_found = 0;
+		if (search_length > 0) search_history(0);
+		else search_failed = 0;
+		return 1;
+	}
+	if (c >= 32 && c != 127 && search_length + 1 < sizeof(search))
+	{
+		search[search_length++] = c;
+		search_history(search_found ? search_found + 1 : 0); /* The current match may still do */
+		return 1;
+	}
+	searching = 0; /* Any other key accepts the match */
+	return 0;
+}
+
+/**
+ * Applies a byte typed by the user.
+ **/
+static void process_byte(unsigned char c)
+{
+	if (esc_state == 1)
+	{
+		esc_state = (c == '[' || c == 'O') ? 2 : 0; /* Other ESC sequences (Alt+key) are ignored */
+		esc_length = 0;
+		esc_param[0] = '\0';
+		return;
+	}
+	if (esc_state == 2)
+	{
+		if (c >= 0x40 && c <= 0x7e)
+		{
+			esc_state = 0;
+			searching = 0;
+			escape_key((char) c);
+			refresh();
+		}
+		else if (esc_length + 1 < sizeof(esc_param))
+		{
+			esc_param[esc_length++] = c;
+			esc_param[esc_length] = '\0';
+		}
+		return;
+	}
+	if (searching && c != 27 && search_key(c))
+	{
+		refresh();
+		return;
+	}
+
+	switch (c)
+	{
+	case 27:
+		searching = 0;
+		esc_state = 1;
+		return;
+	case '\r':
+	case '\n':
+		finish_line();
+		return;
+	case CONTROL('C'):
+		cursor = length;
+		refresh();
+		put_string("^C\r\n");
+		length = cursor = 0;
+		line[0] = '\0';
+		restore_terminal();
+		done = 1;
+		return;
+	case CONTROL('D'):
+		if (length == 0)
+		{
+			at_eof = 1;
+			put_string("\r\n");
+			restore_terminal();
+			done = 1;
+			return;
+		}
+		if (cursor < length) delete_range(cursor, next_char(cursor));
+		break;
+	case 127:
+	case CONTROL('H'):
+		if (cursor > 0) delete_range(previous_char(cursor), cursor);
+		break;
+	case CONTROL('A'): cursor = 0; break;
+	case CONTROL('E'): cursor = length; break;
+	case CONTROL('B'): cursor = previous_char(cursor); break;
+	case CONTROL('F'): cursor = next_char(cursor); break;
+	case CONTROL('K'): delete_range(cursor, length); break;
+	case CONTROL('U'): delete_range(0, cursor); break;
+	case CONTROL('W'):
+	{
+		size_t start = cursor;
+		while (start > 0 && line[start - 1] == ' ') start--;
+		while (start > 0 && line[start - 1] != ' ') start--;
+		delete_range(start, cursor);
+		break;
+	}
+	case CONTROL('L'):
+		put_string("\x1b[H\x1b[2J");
+		break;
+	case CONTROL('P'): show_history(history_pos ? history_pos - 1 : history_count()); break;
+	case CONTROL('N'): if (history_pos) show_history(history_pos + 1); break;
+	case CONTROL('R'):
+		free(saved_line);
+		saved_line = strdup(line);
+		searching = 1;
+		search_length = 0;
+		search_found = 0;
+		search_failed = 0;
+		break;
+	case '\t':
+		complete(last_was_tab);
+		last_was_tab = 1;
+		return;
+	default:
+		if (c < 32) return;
+		insert_text((const char *) &c, 1);
+		break;
+	}
+	last_was_tab = 0;
+	refresh();
+}
+
+/**
+ * Starts editing a new line: puts the terminal in raw mode and shows the
+ * prompt. num_jobs is the number of jobs offered by %n completion.
+ * Returns 1 if input typed ahead already completed the line.
+ **/
+int editor_start(const char * new_prompt, int jobs)
+{
+	fflush(stdout);
+	prompt = new_prompt;
+	num_jobs = jobs;
+	if (ensure_size(0) == -1) return 0;
+	length = cursor = 0;
+	line[0] = '\0';
+	active = 1;
+	done = at_eof = 0;
+	last_was_tab = searching = 0;
+	history_pos = 0;
+	esc_state = 0;
+	set_raw();
+	refresh();
+	while (!done && pending_start < pending_end) process_byte((unsigned char) pending[pending_start++]);
+	return done;
+}
+
+/**
+ * Reads what the terminal has and edits the line with it. Called when the
+ * terminal is readable; does nothing when no line is being edited.
+ * Returns 1 once the line is complete (Enter, ^C or ^D on an empty line).
+ **/
+int editor_input(void)
+{
+	ssize_t n;
+	size_t i;
+
+	if (!active || done) return done;
+	n = read(STDIN_FILENO, pending, sizeof(pending));
+	if (n <= 0)
+	{
+		if (n == -1 && (errno == EINTR || errno == EAGAIN)) return 0;
+		at_eof = 1; /* The terminal is gone */
+		restore_terminal();
+		done = 1;
+		return 1;
+	}
+	pending_start = pending_end = 0;
+	for (i = 0; i < (size_t) n && !done; i++) process_byte((unsigned char) pending[i]);
+	if (i < (size_t) n) /* Lines typed ahead or pasted */
+	{
+		pending_start = i;
+		pending_end = n;
+	}
+	return done;
+}
+
+/**
+ * Returns the completed line, valid until the next editor_start(), or NULL
+ * at the end of the input (^D).
+ **/
+const char * editor_line(void)
+{
+	active = 0;
+	return at_eof ? NULL : line;
+}
+
+/**
+ * Clears the line being edited from the screen so that other output (job
+ * reports) can be printed. Returns 1 if it did, then editor_show() has to
+ * draw it again.
+ **/
+int editor_hide(void)
+{
+	if (!active || done) return 0;
+	put_string("\r\x1b[K");
+	return 1;
+}
+
+void editor_show(void)
+{
+	fflush(stdout);
+	refresh();
+}
@@ -0,0 +1,34 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes for the line_editor module
+ *
+ * Interactive line editing on the terminal in raw mode, driven by the
+ * event loop: the shell calls editor_input() whenever the terminal is
+ * readable, so background jobs keep being handled while a line is typed.
+ * - Moving and deleting: arrows, Home/End, ^A ^E ^B ^F, Backspace, Delete,
+ *   ^D, ^K, ^U, ^W; ^L clears the screen and ^C discards the line.
+ * - History: Up/Down (^P/^N) browse it and ^R searches it backwards.
+ * - Tab completes commands (builtins and PATH), files and job specs (%n);
+ *   a second Tab lists the candidates when there are several.
+ * The terminal is left in its normal mode between lines, while commands
+ * run.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _LINE_EDITOR_H
+#define _LINE_EDITOR_H
+
+/**
+ * Public Functions
+ **/
+int editor_start(const char * prompt, int num_jobs);
+int editor_input(void);
+const char * editor_line(void);
+int editor_hide(void);
+void editor_show(void);
+
+#endif
@@ -0,0 +1,691 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * memo_cache module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "memo_cache.h"
+#include "event_loop.h"
+
+#define MEMO_MAGIC "JCSMEMO1"     /* 8 bytes, without its '\0' */
+#define MEMO_SUFFIX ".memo"
+#define DRAIN_MS 200              /* Wait for the output of a command that has exited */
+#define HASHED_FILES 64           /* Content hashes remembered */
+
+/* Start of an entry file. The output follows it */
+typedef struct entry_header_
+{
+	char magic[8];
+	int32_t status;           /* Exit status of the command */
+	uint32_t reserved;
+	int64_t created;          /* Seconds since the epoch */
+	int64_t run_ns;           /* How long the command took */
+	uint64_t length;          /* Bytes of output */
+} entry_header;
+
+struct memo_recording_
+{
+	memo_key key;
+	int fd;                   /* Read end of the pipe, -1 at end of file or when not piped */
+	int write_fd;             /* The command's stdout, closed once it has been launched */
+	int fd_out;               /* Where the output is shown */
+	int tmp_fd;               /* Entry being written, -1 if it will not be stored */
+	char tmp[PATH_MAX];
+	uint64_t length;
+	long long start_ns;
+	pid_t pgid;
+	int finished;             /* 1 once the command has exited */
+	int status;               /* Its exit status, -1 if it must not be stored */
+	struct memo_recording_ * next;
+};
+
+/* A file's content hash, valid while it has the same inode, size and times */
+typedef struct hashed_file_
+{
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime, ctime;
+	uint64_t hash;
+} hashed_file;
+
+/* An entry of the cache directory, for eviction */
+typedef struct cache_file_
+{
+	char name[64];
+	time_t used;
+	long long size;
+} cache_file;
+
+static memo_recording * recordings = NULL;
+static hashed_file hashed[HASHED_FILES];
+static memo_stats stats = { 0, 0, 0, 0, 0, 0, 0, MEMO_DEFAULT_SIZE, MEMO_DEFAULT_AGE };
+static char cache_dir[PATH_MAX];
+
+static long long monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * 64 bit hash of n bytes, a word at a time, starting from seed
+ **/
+static uint64_t hash_bytes(const unsigned char * p, size_t n, uint64_t seed)
+{
+	uint64_t h = seed ^ (n * 0x9e3779b97f4a7c15ull);
+
+	for (; n >= 8; p += 8, n -= 8)
+	{
+		uint64_t w;
+		memcpy(&w, p, 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+	while (n--) h = (h ^ *p++) * 0x100000001b3ull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	return h ^ (h >> 29);
+}
+
+void memo_key_init(memo_key * key)
+{
+	key->h[0] = 0x6a09e667f3bcc908ull;
+	key->h[1] = 0xbb67ae8584caa73bull;
+}
+
+/**
+ * Adds n bytes to the key. Each lane chains the item into its own state,
+ * so the order of the items and their lengths count.
+ **/
+void memo_key_add(memo_key * key, const void * data, size_t n)
+{
+	key->h[0] = hash_bytes((const unsigned char *) data, n, key->h[0]);
+	key->h[1] = hash_bytes((const unsigned char *) data, n, key->h[1] ^ 0x5851f42d4c957f2dull);
+}
+
+/**
+ * Adds a string with its '\0', or nothing for NULL (which is told apart
+ * from the empty string).
+ **/
+void memo_key_string(memo_key * key, const char * s)
+{
+	memo_key_add(key, s, s ? strlen(s) + 1 : 0);
+}
+
+/**
+ * Hash of the contents of the regular file open in fd. A hash is
+ * remembered while the file keeps its inode, size, mtime and ctime; not
+ * for a file changed within the last second, whose next change could
+ * leave the same times.
+ * Returns 0, or -1 if the file cannot be mapped.
+ **/
+static int content_hash(int fd, const struct stat * st, uint64_t * hash)
+{
+	hashed_file * slot = &hashed[(st->st_ino ^ st->st_dev) % HASHED_FILES];
+	uint64_t h = hash_bytes(NULL, 0, 0);
+	void * map;
+
+	if (slot->ino == st->st_ino && slot->dev == st->st_dev && slot->size == st->st_size &&
+		slot->mtime.tv_sec == st->st_mtim.tv_sec && slot->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+		slot->ctime.tv_sec == st->st_ctim.tv_sec && slot->ctime.tv_nsec == st->st_ctim.tv_nsec)
+	{
+		*hash = slot->hash;
+		return 0;
+	}
+
+	if (st->st_size > 0)
+	{
+		map = mmap(NULL, (size_t) st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) return -1;
+		madvise(map, (size_t) st->st_size, MADV_SEQUENTIAL);
+		h = hash_bytes((const unsigned char *) map, (size_t) st->st_size, 0);
+		munmap(map, (size_t) st->st_size);
+	}
+	if (st->st_ctim.tv_sec < time(NULL) - 1)
+	{
+		slot->dev = st->st_dev;
+		slot->ino = st->st_ino;
+		slot->size = st->st_size;
+		slot->mtime = st->st_mtim;
+		slot->ctime = st->st_ctim;
+		slot->hash = h;
+	}
+	*hash = h;
+	return 0;
+}
+
+/**
+ * Adds the input open in fd to the key: the size, contents and offset of
+ * a regular file, or the device number of /dev/null, which always reads
+ * the same (nothing).
+ * Returns 0 for a regular file, 1 for /dev/null, or -1 if the input cannot
+ * be keyed (a terminal or another device, a pipe, a socket) or read, with
+ * errno set.
+ **/
+int memo_key_file(memo_key * key, int fd)
+{
+	struct stat st, null;
+	uint64_t item[3];
+
+	if (fstat(fd, &st) == -1) return -1;
+	if (S_ISCHR(st.st_mode))
+	{
+		if (stat("/dev/null", &null) == -1 || !S_ISCHR(null.st_mode) || st.st_rdev != null.st_rdev)
+		{
+			errno = EINVAL; /* What a terminal or a device gives may change */
+			return -1;
+		}
+		item[0] = 1;
+		item[1] = st.st_rdev;
+		item[2] = 0;
+		memo_key_add(key, item, sizeof(item));
+		return 1;
+	}
+	if (!S_ISREG(st.st_mode))
+	{
+		errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+		return -1;
+	}
+	item[0] = (uint64_t) st.st_size;
+	item[2] = (uint64_t) lseek(fd, 0, SEEK_CUR); /* Where the command starts reading */
+	if (content_hash(fd, &st, &item[1]) == -1) return -1;
+	memo_key_add(key, item, sizeof(item));
+	return 0;
+}
+
+/**
+ * Returns the cache directory, or NULL if there is none: $JCSHELL_MEMO
+ * (empty turns the cache off), or $XDG_CACHE_HOME/jcshell/memo, or
+ * ~/.cache/jcshell/memo.
+ **/
+static const char * memo_dir(void)
+{
+	const char * dir = getenv("JCSHELL_MEMO"), * base;
+	int n;
+
+	if (dir) n = *dir ? snprintf(cache_dir, sizeof(cache_dir), "%s", dir) : -1;
+	else if ((base = getenv("XDG_CACHE_HOME")) && *base) n = snprintf(cache_dir, sizeof(cache_dir), "%s/jcshell/memo", base);
+	else if ((base = getenv("HOME"))) n = snprintf(cache_dir, sizeof(cache_dir), "%s/.cache/jcshell/memo", base);
+	else n = -1;
+	return n < 0 || n >= (int) sizeof(cache_dir) - 64 ? NULL : cache_dir;
+}
+
+/**
+ * Creates the cache directory and its parents if they do not exist
+ **/
+static void make_memo_dir(const char * dir)
+{
+	char path[PATH_MAX], * slash;
+
+	snprintf(path, sizeof(path), "%s/", dir);
+	for (slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/'))
+	{
+		*slash = '\0';
+		mkdir(path, 0700);
+		*slash = '/';
+	}
+}
+
+static void entry_name(const char * dir, const memo_key * key, char * name, size_t size)
+{
+	snprintf(name, size, "%s/%016llx%016llx" MEMO_SUFFIX, dir,
+		(unsigned long long) key->h[0], (unsigned long long) key->h[1]);
+}
+
+/**
+ * Copies length bytes of fd from offset off to fd_out, with sendfile when
+ * fd_out takes it. Returns 0, or -1 if fd_out failed.
+ **/
+static int copy_output(int fd, off_t off, uint64_t length, int fd_out)
+{
+	char buff[8192];
+	ssize_t n;
+
+	while (length > 0)
+	{
+		n = sendfile(fd_out, fd, &off, length > (1u << 30) ? (1u << 30) : (size_t) length);
+		if (n == -1 && errno == EINTR) continue;
+		if (n == -1 && (errno == EINVAL || errno == ENOSYS)) break; /* fd_out is not a sendfile target */
+		if (n <= 0) return -1;
+		length -= (uint64_t) n;
+	}
+	while (length > 0)
+	{
+		n = pread(fd, buff, length > sizeof(buff) ? sizeof(buff) : (size_t) length, off);
+		if (n <= 0) return -1;
+		if (write(fd_out, buff, (size_t) n) != n) return -1;
+		off += n;
+		length -= (uint64_t) n;
+	}
+	return 0;
+}
+
+/**
+ * Replays the entry of key, if there is a valid one: its output is written
+ * to fd_out and its exit status left in status. An entry older than the
+ * maximum age is removed instead. Using an entry updates its mtime, which
+ * eviction takes as its last use.
+ * Returns 1 on a hit, 0 on a miss.
+ **/
+int memo_replay(const memo_key * key, int fd_out, int * status)
+{
+	const char * dir = memo_dir();
+	char name[PATH_MAX];
+	entry_header header;
+	struct stat st;
+	int fd, valid;
+
+	if (!dir)
+	{
+		stats.misses++;
+		return 0;
+	}
+	entry_name(dir, key, name, sizeof(name));
+	fd = open(name, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		stats.misses++;
+		return 0;
+	}
+	valid = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+		!memcmp(header.magic, MEMO_MAGIC, 8) && (uint64_t) st.st_size == sizeof(header) + header.length;
+	if (!valid || header.created < (int64_t) time(NULL) - stats.max_age)
+	{
+		close(fd);
+		unlink(name);
+		stats.misses++;
+		return 0;
+	}
+
+	copy_output(fd, sizeof(header), header.length, fd_out);
+	futimens(fd, NULL);
+	close(fd);
+	*status = header.status;
+	stats.hits++;
+	stats.replayed += header.length;
+	stats.saved_ns += header.run_ns;
+	return 1;
+}
+
+/**
+ * Returns the files of the cache directory in files (to be freed), with
+ * their total size in total. Returns how many there are, or -1.
+ **/
+static long scan_cache(const char * dir, cache_file ** files, long long * total)
+{
+	DIR * d = opendir(dir);
+	struct dirent * e;
+	struct stat st;
+	long num = 0, max = 0;
+
+	*files = NULL;
+	*total = 0;
+	if (!d) return -1;
+	while ((e = readdir(d)))
+	{
+		if (e->d_name[0] == '.' || strlen(e->d_name) >= sizeof((*files)->name)) continue;
+		if (fstatat(dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1 || !S_ISREG(st.st_mode)) continue;
+		if (num == max)
+		{
+			long size = max ? max * 2 : 64;
+			cache_file * aux = (cache_file *) realloc(*files, size * sizeof(cache_file));
+			if (!aux) break;
+			*files = aux;
+			max = size;
+		}
+		strcpy((*files)[num].name, e->d_name);
+		(*files)[num].used = st.st_mtime;
+		(*files)[num].size = (long long) st.st_blocks * 512;
+		*total += (*files)[num].size;
+		num++;
+	}
+	closedir(d);
+	return num;
+}
+
+static int compare_used(const void * a, const void * b)
+{
+	time_t x = ((const cache_file *) a)->used, y = ((const cache_file *) b)->used;
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * Removes the files not used for the maximum age (left over temporary
+ * files included), then the least recently used ones while the cache is
+ * larger than its maximum size.
+ **/
+static void evict(const char * dir)
+{
+	cache_file * files;
+	long long total;
+	long num = scan_cache(dir, &files, &total), i;
+	time_t oldest = time(NULL) - stats.max_age;
+	int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (num > 0 && dir_fd != -1)
+	{
+		qsort(files, (size_t) num, sizeof(cache_file), compare_used);
+		for (i = 0; i < num && (files[i].used < oldest || total > stats.max_size); i++)
+		{
+			if (unlinkat(dir_fd, files[i].name, 0) == 0) stats.evicted++;
+			total -= files[i].size;
+		}
+	}
+	if (dir_fd != -1) close(dir_fd);
+	free(files);
+}
+
+/**
+ * Starts recording the output of a command that missed the cache. With
+ * piped, the command's stdout is the write end of a pipe
+ * (memo_record_fd()) that the shell drains to fd_out and to the entry;
+ * otherwise the command (a builtin) writes straight to the entry and
+ * memo_record_done() shows it. fd_out is duplicated, the caller keeps its own.
+ * Returns the recording, or NULL if the entry cannot be created (then the
+ * command runs without it).
+ **/
+memo_recording * memo_record(const memo_key * key, int fd_out, int piped)
+{
+	const char * dir = memo_dir();
+	memo_recording * rec;
+	int fds[2];
+
+	if (!dir) return NULL;
+	rec = (memo_recording *) calloc(1, sizeof(memo_recording));
+	if (!rec) return NULL;
+	rec->key = *key;
+	rec->fd = rec->write_fd = -1;
+	rec->status = -1;
+	rec->start_ns = monotonic_ns();
+
+	entry_name(dir, key, rec->tmp, sizeof(rec->tmp));
+	strcat(rec->tmp, ".XXXXXX");
+	make_memo_dir(dir);
+	rec->tmp_fd = mkostemp(rec->tmp, O_CLOEXEC);
+	rec->fd_out = fcntl(fd_out, F_DUPFD_CLOEXEC, 10);
+	if (rec->tmp_fd == -1 || rec->fd_out == -1 || lseek(rec->tmp_fd, sizeof(entry_header), SEEK_SET) == -1 ||
+		(piped && pipe2(fds, O_CLOEXEC) == -1))
+	{
+		if (rec->tmp_fd != -1)
+		{
+			close(rec->tmp_fd);
+			unlink(rec->tmp);
+		}
+		if (rec->fd_out != -1) close(rec->fd_out);
+		free(rec);
+		return NULL;
+	}
+	if (piped)
+	{
+		fcntl(fds[0], F_SETFL, O_NONBLOCK); /* Not on the command's end: its writes must block */
+		rec->fd = fds[0];
+		rec->write_fd = fds[1];
+	}
+	return rec;
+}
+
+/**
+ * Returns the descriptor the command's stdout must be
+ **/
+int memo_record_fd(const memo_recording * rec)
+{
+	return rec->write_fd != -1 ? rec->write_fd : rec->tmp_fd;
+}
+
+/**
+ * Stores the entry once the command has exited with a status to keep and
+ * its output is complete, and frees the recording.
+ **/
+static void finish_recording(memo_recording * rec)
+{
+	memo_recording ** link;
+	entry_header header;
+	char name[PATH_MAX];
+
+	for (link = &recordings; *link; link = &(*link)->next)
+	{
+		if (*link == rec)
+		{
+			*link = rec->next;
+			break;
+		}
+	}
+	if (rec->tmp_fd != -1)
+	{
+		const char * dir = memo_dir();
+		int stored;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MEMO_MAGIC, 8);
+		header.status = rec->status;
+		header.created = (int64_t) time(NULL);
+		header.run_ns = monotonic_ns() - rec->start_ns;
+		header.length = rec->length;
+		strcpy(name, rec->tmp);
+		name[strlen(name) - 7] = '\0'; /* Without ".XXXXXX" */
+		stored = rec->status != -1 && pwrite(rec->tmp_fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+			rename(rec->tmp, name) == 0;
+		close(rec->tmp_fd);
+		if (!stored) unlink(rec->tmp);
+		else
+		{
+			stats.stored++;
+			if (dir) evict(dir);
+		}
+	}
+	if (rec->fd != -1)
+	{
+		event_loop_remove(rec->fd);
+		close(rec->fd);
+	}
+	close(rec->fd_out);
+	free(rec);
+}
+
+/**
+ * Writes output of the command to fd_out and to the entry. An entry that
+ * would take more than an eighth of the cache is not stored.
+ **/
+static void record_output(memo_recording * rec, const char * data, size_t n)
+{
+	size_t done = 0;
+	ssize_t w;
+
+	while (done < n && ((w = write(rec->fd_out, data + done, n - done)) > 0 || (w == -1 && errno == EINTR)))
+	{
+		if (w > 0) done += (size_t) w;
+	}
+	if (rec->tmp_fd == -1) return;
+	rec->length += n;
+	if (rec->length > (uint64_t) stats.max_size / 8 || write(rec->tmp_fd, data, n) != (ssize_t) n)
+	{
+		close(rec->tmp_fd);
+		unlink(rec->tmp);
+		rec->tmp_fd = -1;
+	}
+}
+
+/**
+ * Reads the pipe of a recording until it is empty. Returns 1 at end of
+ * file, when the pipe has been closed, or 0.
+ **/
+static int drain_recording(memo_recording * rec)
+{
+	char buff[8192];
+	ssize_t n;
+
+	while ((n = read(rec->fd, buff, sizeof(buff))) > 0) record_output(rec, buff, (size_t) n);
+	if (n == -1 && (errno == EAGAIN || errno == EINTR)) return 0;
+
+	event_loop_remove(rec->fd);
+	close(rec->fd);
+	rec->fd = -1;
+	return 1;
+}
+
+/**
+ * Event handler for the read end of a recording. At end of file the entry
+ * is stored if the command has already exited.
+ **/
+static void record_event(int fd, unsigned int events, void * data)
+{
+	memo_recording * rec = (memo_recording *) data;
+	if (drain_recording(rec) && rec->finished) finish_recording(rec);
+}
+
+/**
+ * Called once the command has been launched in process group pgid, or
+ * could not be (pgid <= 0, the recording is discarded). The shell's copy
+ * of the write end is closed, so end of file arrives when the command's are.
+ **/
+void memo_record_started(memo_recording * rec, pid_t pgid)
+{
+	if (!rec) return;
+	close(rec->write_fd);
+	rec->write_fd = -1;
+	rec->pgid = pgid;
+	rec->next = recordings;
+	recordings = rec;
+	if (pgid <= 0 || event_loop_add(rec->fd, record_event, rec) == -1)
+	{
+		rec->status = -1;
+		finish_recording(rec);
+	}
+}
+
+/**
+ * Ends the recording of a builtin that exited with exit_status: shows
+ * what it wrote and stores the entry.
+ **/
+void memo_record_done(memo_recording * rec, int exit_status)
+{
+	if (!rec) return;
+	if (rec->tmp_fd != -1)
+	{
+		off_t end = lseek(rec->tmp_fd, 0, SEEK_CUR);
+		rec->length = end > (off_t) sizeof(entry_header) ? (uint64_t) (end - sizeof(entry_header)) : 0;
+		copy_output(rec->tmp_fd, sizeof(entry_header), rec->length, rec->fd_out);
+	}
+	rec->status = exit_status;
+	finish_recording(rec);
+}
+
+/**
+ * Called when process group pgid has exited with wait status status. The
+ * entry of its recording keeps the exit code; one killed by a signal is
+ * not stored. Output still in the pipe is read for a short while, so a
+ * foreground command's output is complete before the next prompt; what
+ * arrives later (from processes it left behind) is recorded by the event loop.
+ **/
+void memo_job_finished(pid_t pgid, int status)
+{
+	memo_recording * rec;
+	long long deadline = monotonic_ns() + DRAIN_MS * 1000000LL;
+	struct pollfd p;
+
+	for (rec = recordings; rec && rec->pgid != pgid; rec = rec->next);
+	if (!rec || rec->finished) return;
+	rec->finished = 1;
+	rec->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+	p.fd = rec->fd;
+	p.events = POLLIN;
+	while (rec->fd != -1)
+	{
+		long long left = deadline - monotonic_ns();
+		if (left <= 0 || poll(&p, 1, (int) (left / 1000000) + 1) == 0) return;
+		drain_recording(rec);
+	}
+	finish_recording(rec);
+}
+
+/**
+ * Counts a command run without the cache, its input could not be keyed
+ **/
+void memo_uncached(void)
+{
+	stats.uncached++;
+}
+
+const memo_stats * memo_statistics(void)
+{
+	return &stats;
+}
+
+/**
+ * Sets the maximum size and age and applies them to the cache
+ **/
+void memo_limits(long long max_size, long max_age)
+{
+	const char * dir = memo_dir();
+	stats.max_size = max_size;
+	stats.max_age = max_age;
+	if (dir) evict(dir);
+}
+
+/**
+ * Leaves the cache directory in dir, with its number of entries and the
+ * bytes they take. Returns 0, or -1 if there is no cache directory.
+ **/
+int memo_usage(const char ** dir, long * entries, long long * bytes)
+{
+	cache_file * files;
+	long num, i;
+	size_t len = strlen(MEMO_SUFFIX);
+
+	*dir = memo_dir();
+	*entries = 0;
+	*bytes = 0;
+	if (!*dir) return -1;
+	num = scan_cache(*dir, &files, bytes);
+	for (i = 0; i < num; i++)
+	{
+		size_t n = strlen(files[i].name);
+		if (n > len && !strcmp(files[i].name + n - len, MEMO_SUFFIX)) (*entries)++;
+	}
+	free(files);
+	return 0;
+}
+
+/**
+ * Removes every entry. Returns how many, or -1 if there is no cache directory.
+ **/
+int memo_clear(void)
+{
+	const char * dir = memo_dir();
+	cache_file * files;
+	long long total;
+	long num, i;
+	int removed = 0, dir_fd;
+
+	if (!dir) return -1;
+	num = scan_cache(dir, &files, &total);
+	dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	for (i = 0; i < num && dir_fd != -1; i++)
+	{
+		if (unlinkat(dir_fd, files[i].name, 0) == 0) removed++;
+	}
+	if (dir_fd != -1) close(dir_fd);
+	free(files);
+	return removed;
+}
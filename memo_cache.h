@@ -0,0 +1,75 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the memo_cache module
+ *
+ * Results of deterministic commands, for the memo builtin. A command is
+ * identified by a key: its arguments, the working directory, the program
+ * run, some environment variables and the size and contents of its input
+ * files (the regular file on its stdin and any declared dependency). The
+ * first run records its stdout and exit status in a cache directory; a
+ * later run with the same key replays them without starting anything.
+ *
+ * The output of an external command is recorded through a pipe drained by
+ * the event loop, so it is shown while the command runs and a stopped or
+ * background command keeps being recorded; the entry is stored when the
+ * pipe is closed and the command has exited. Entries live in $JCSHELL_MEMO,
+ * or $XDG_CACHE_HOME/jcshell/memo, or ~/.cache/jcshell/memo, and are
+ * evicted when they have not been used for the maximum age or, least
+ * recently used first, when the cache grows past its maximum size.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _MEMO_CACHE_H
+#define _MEMO_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MEMO_DEFAULT_SIZE (64LL << 20)      /* Bytes of the cache directory */
+#define MEMO_DEFAULT_AGE (7 * 24 * 3600)    /* Seconds an entry lives */
+
+/* Identity of a command run: two 64 bit lanes over everything it depends on */
+typedef struct memo_key_
+{
+	uint64_t h[2];
+} memo_key;
+
+/* A command whose output is being recorded */
+typedef struct memo_recording_ memo_recording;
+
+/* Counters since the shell started, and the limits */
+typedef struct memo_stats_
+{
+	unsigned long hits, misses;
+	unsigned long uncached;          /* Commands whose input could not be keyed */
+	unsigned long stored, evicted;
+	unsigned long long replayed;     /* Bytes of output replayed */
+	long long saved_ns;              /* Run time of the commands replayed */
+	long long max_size;
+	long max_age;
+} memo_stats;
+
+/**
+ * Public Functions
+ **/
+void memo_key_init(memo_key * key);
+void memo_key_add(memo_key * key, const void * data, size_t n);
+void memo_key_string(memo_key * key, const char * s);
+int memo_key_file(memo_key * key, int fd);
+int memo_replay(const memo_key * key, int fd_out, int * status);
+memo_recording * memo_record(const memo_key * key, int fd_out, int piped);
+int memo_record_fd(const memo_recording * rec);
+void memo_record_started(memo_recording * rec, pid_t pgid);
+void memo_record_done(memo_recording * rec, int exit_status);
+void memo_job_finished(pid_t pgid, int status);
+void memo_uncached(void);
+const memo_stats * memo_statistics(void);
+void memo_limits(long long max_size, long max_age);
+int memo_usage(const char ** dir, long * entries, long long * bytes);
+int memo_clear(void);
+
+#endif
@@ -0,0 +1,284 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * path_cache module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "path_cache.h"
+
+#define PATH_CACHE_BUCKETS 256      /* Power of two */
+#define PATH_CHECK_INTERVAL_NS 1000000000LL /* Directories are checked at most once per second */
+
+/* A PATH directory and its modification time when the cache was filled */
+typedef struct path_dir_
+{
+	char * dir;
+	struct timespec mtime;
+	int exists;
+} path_dir;
+
+static path_entry * buckets[PATH_CACHE_BUCKETS];
+static int num_entries = 0;
+
+static char * path_copy = NULL;     /* PATH the cache was built for */
+static path_dir * dirs = NULL;
+static int num_dirs = 0;
+static long long last_check = 0;
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static unsigned int name_bucket(const char * name)
+{
+	unsigned int h = 2166136261u; /* FNV-1a */
+	while (*name) h = (h ^ (unsigned char) *name++) * 16777619u;
+	return h & (PATH_CACHE_BUCKETS - 1);
+}
+
+/**
+ * Removes every cached command, keeping the PATH snapshot
+ **/
+static void flush_entries(void)
+{
+	int i;
+	for (i = 0; i < PATH_CACHE_BUCKETS; i++)
+	{
+		while (buckets[i])
+		{
+			path_entry * next = buckets[i]->next;
+			free(buckets[i]->path); /* Also holds the name */
+			free(buckets[i]);
+			buckets[i] = next;
+		}
+	}
+	num_entries = 0;
+}
+
+/**
+ * Splits PATH into directories and records their modification times.
+ * Empty components mean the current directory, as for execvp().
+ **/
+static void snapshot_path(const char * path)
+{
+	const char * p;
+	int i;
+
+	for (i = 0; i < num_dirs; i++) free(dirs[i].dir);
+	free(dirs);
+	free(path_copy);
+	dirs = NULL;
+	num_dirs = 0;
+	path_copy = strdup(path);
+	if (!path_copy) return;
+
+	for (p = path, i = 1; *p; p++) if (*p == ':') i++;
+	dirs = (path_dir *) calloc(i, sizeof(path_dir));
+	if (!dirs) return;
+
+	p = path;
+	while (1)
+	{
+		const char * end = strchrnul(p, ':');
+		struct stat st;
+		dirs[num_dirs].dir = end == p ? strdup(".") : strndup(p, end - p);
+		if (dirs[num_dirs].dir && stat(dirs[num_dirs].dir, &st) == 0)
+		{
+			dirs[num_dirs].exists = 1;
+			dirs[num_dirs].mtime = st.st_mtim;
+		}
+		num_dirs++;
+		if (!*end) break;
+		p = end + 1;
+	}
+	last_check = now_ns();
+}
+
+/**
+ * Flushes the cache if PATH has changed or one of its directories has been
+ * modified. Directories are stat()ed at most once per PATH_CHECK_INTERVAL_NS.
+ **/
+static void validate_cache(const char * path)
+{
+	long long now;
+	int i;
+
+	if (!path_copy || strcmp(path, path_copy) != 0)
+	{
+		flush_entries();
+		snapshot_path(path);
+		return;
+	}
+	now = now_ns();
+	if (now - last_check < PATH_CHECK_INTERVAL_NS) return;
+	last_check = now;
+	for (i = 0; i < num_dirs; i++)
+	{
+		struct stat st;
+		int exists = dirs[i].dir && stat(dirs[i].dir, &st) == 0;
+		if (exists != dirs[i].exists || (exists &&
+			(st.st_mtim.tv_sec != dirs[i].mtime.tv_sec || st.st_mtim.tv_nsec != dirs[i].mtime.tv_nsec)))
+		{
+			flush_entries();
+			snapshot_path(path);
+			return;
+		}
+	}
+}
+
+/**
+ * Searches PATH like execvp(): the first regular executable file wins.
+ * Programs found through a relative directory are not cached, as they
+ * depend on the working directory.
+ **/
+static path_entry * search_path(const char * name)
+{
+	size_t name_len = strlen(name);
+	int i;
+
+	for (i = 0; i < num_dirs; i++)
+	{
+		struct stat st;
+		size_t dir_len;
+		char * candidate;
+
+		if (!dirs[i].exists) continue;
+		dir_len = strlen(dirs[i].dir);
+		candidate = (char *) malloc(dir_len + name_len + 2);
+		if (!candidate) return NULL;
+		memcpy(candidate, dirs[i].dir, dir_len);
+		candidate[dir_len] = '/';
+		memcpy(candidate + dir_len + 1, name, name_len + 1);
+
+		if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0)
+		{
+			path_entry * entry;
+			if (dirs[i].dir[0] != '/' || !(entry = (path_entry *) malloc(sizeof(path_entry))))
+			{
+				free(candidate);
+				return NULL;
+			}
+			entry->name = candidate + dir_len + 1; /* Shares the allocation of the path */
+			entry->path = candidate;
+			entry->hits = 0;
+			return entry;
+		}
+		free(candidate);
+	}
+	return NULL;
+}
+
+static path_entry * find_entry(const char * name)
+{
+	path_entry * entry = buckets[name_bucket(name)];
+	while (entry && strcmp(entry->name, name) != 0) entry = entry->next;
+	return entry;
+}
+
+/**
+ * Returns the cached entry for name, searching PATH on a miss.
+ * Returns NULL if name has a slash, PATH is not set or the program is not
+ * found (execvp() then reports the error as usual).
+ **/
+static path_entry * resolve(const char * name)
+{
+	const char * path = getenv("PATH");
+	path_entry * entry;
+	unsigned int b;
+
+	if (!path || !*name || strchr(name, '/')) return NULL;
+	validate_cache(path);
+
+	entry = find_entry(name);
+	if (entry) return entry;
+
+	entry = search_path(name);
+	if (!entry) return NULL;
+	b = name_bucket(name);
+	entry->next = buckets[b];
+	buckets[b] = entry;
+	num_entries++;
+	return entry;
+}
+
+/**
+ * Returns the absolute path of the program run for command name, counting
+ * a hit, or NULL if it has to be left to execvp().
+ **/
+const char * lookup_command(const char * name)
+{
+	path_entry * entry = resolve(name);
+	if (!entry) return NULL;
+	entry->hits++;
+	return entry->path;
+}
+
+/**
+ * Adds name to the cache without launching it (hash name).
+ * Returns its path or NULL if it is not found in PATH.
+ **/
+const char * hash_command(const char * name)
+{
+	path_entry * entry = resolve(name);
+	return entry ? entry->path : NULL;
+}
+
+/**
+ * Removes name from the cache (e.g. its cached path could not be executed)
+ **/
+void forget_command(const char * name)
+{
+	path_entry ** link = &buckets[name_bucket(name)];
+	while (*link && strcmp((*link)->name, name) != 0) link = &(*link)->next;
+	if (*link)
+	{
+		path_entry * entry = *link;
+		*link = entry->next;
+		free(entry->path); /* Also holds the name */
+		free(entry);
+		num_entries--;
+	}
+}
+
+/**
+ * Empties the cache (hash -r)
+ **/
+void clear_path_cache(void)
+{
+	flush_entries();
+}
+
+/**
+ * Lists the cached commands with their hits and paths, like the hash builtin
+ * of other shells.
+ **/
+void print_path_cache(void)
+{
+	int i;
+	if (num_entries == 0)
+	{
+		printf("hash: hash table empty\n");
+		return;
+	}
+	printf("hits\tcommand\n");
+	for (i = 0; i < PATH_CACHE_BUCKETS; i++)
+	{
+		path_entry * entry;
+		for (entry = buckets[i]; entry; entry = entry->next)
+			printf("%4lu\t%s\n", entry->hits, entry->path);
+	}
+}
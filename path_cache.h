@@ -0,0 +1,37 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the path_cache module
+ *
+ * Remembers where each command was found in PATH, so the shell searches
+ * PATH once per command name and children exec an absolute path instead
+ * of trying every directory. The cache is flushed when PATH changes or when
+ * one of its directories is modified (a program added, removed or renamed).
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _PATH_CACHE_H
+#define _PATH_CACHE_H
+
+/* A cached command, as listed by the hash builtin */
+typedef struct path_entry_
+{
+	char * name;                /* Command name */
+	char * path;                /* Absolute path of the program */
+	unsigned long hits;         /* Launches resolved from the cache */
+	struct path_entry_ * next;  /* Next entry in the same bucket */
+} path_entry;
+
+/**
+ * Public Functions
+ **/
+const char * lookup_command(const char * name);
+const char * hash_command(const char * name);
+void forget_command(const char * name);
+void clear_path_cache(void);
+void print_path_cache(void);
+
+#endif
@@ -0,0 +1,611 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * script_cache module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "script_cache.h"
+
+#define CACHE_MAGIC "JCSBC01"     /* With its '\0', the 8 bytes of magic */
+#define CACHE_BYTE_ORDER 0x01020304u
+#define NO_STRING 0xffffffffu     /* End of a stage, or a redirection without file */
+#define RECORD_WORDS 4            /* flags, builtin, num_args, num_redirections */
+#define REDIRECTION_WORDS 5       /* fd, flags, source, stage, file */
+#define FLAG_BACKGROUND 1
+#define FLAG_ERROR 2              /* The only argument is the syntax error */
+
+/* Start of a cache file. Records and strings follow it */
+typedef struct cache_header_
+{
+	char magic[8];
+	uint32_t byte_order;      /* CACHE_BYTE_ORDER as the shell that wrote it saw it */
+	uint32_t builtins;        /* Hash of the builtin names, in id order */
+	uint64_t script_size;
+	int64_t script_mtime_ns;
+	uint64_t script_hash;
+	uint64_t num_commands;
+	uint64_t records;         /* Offset of the first record */
+	uint64_t num_words;       /* 32 bit words of all the records */
+	uint64_t strings;         /* Offset of the string table */
+	uint64_t strings_size;
+	uint64_t body_hash;       /* Of the records and strings, so a damaged file is not run */
+	uint32_t path;            /* Script path in the string table */
+	uint32_t reserved;
+} cache_header;
+
+/* Cache file being built: records and a string table without repeated strings */
+typedef struct image_
+{
+	uint32_t * words;
+	size_t num_words, max_words;
+	char * strings;
+	size_t strings_size, max_strings;
+	uint32_t * table;         /* String offsets by hash, NO_STRING for free buckets */
+	size_t table_size, num_strings;
+	uint64_t num_commands;
+	int failed;               /* Out of memory or too large */
+} image;
+
+struct compiled_script_
+{
+	char * base;              /* The cache file mapped (copy on write), or the image just compiled */
+	size_t size;
+	int mapped;
+	const uint32_t * next;    /* Next record */
+	const uint32_t * end;
+	char * strings;
+	unsigned int generation;  /* builtin_generation() when the ids were checked */
+};
+
+/**
+ * 64 bit hash of n bytes, a word at a time
+ **/
+static uint64_t hash_bytes(const unsigned char * p, size_t n)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+
+	for (; n >= 8; p += 8, n -= 8)
+	{
+		uint64_t w;
+		memcpy(&w, p, 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+	while (n--) h = (h ^ *p++) * 0x100000001b3ull;
+	return h ^ (h >> 29);
+}
+
+static uint64_t hash_file(int fd, size_t size)
+{
+	void * map;
+	uint64_t h;
+
+	if (size == 0) return hash_bytes(NULL, 0);
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) return 0;
+	madvise(map, size, MADV_SEQUENTIAL);
+	h = hash_bytes((const unsigned char *) map, size);
+	munmap(map, size);
+	return h;
+}
+
+static uint32_t builtins_hash;
+
+static void add_builtin_name(const char * name)
+{
+	builtins_hash = (builtins_hash ^ (uint32_t) hash_bytes((const unsigned char *) name, strlen(name))) * 16777619u;
+}
+
+/**
+ * Hash of the enabled builtins in registration (id) order: the ids in a
+ * cache file are valid while the shell registers the same builtins.
+ **/
+static uint32_t builtins_signature(void)
+{
+	builtins_hash = 2166136261u;
+	for_each_builtin(add_builtin_name);
+	return builtins_hash;
+}
+
+/**
+ * Writes the cache file name of the script with real path real into name.
+ * Returns 0 on success or -1 if the cache is turned off.
+ **/
+static int cache_file_name(const char * real, char * name, size_t size)
+{
+	const char * dir = getenv("JCSHELL_CACHE"), * base;
+	unsigned long long key = hash_bytes((const unsigned char *) real, strlen(real));
+	int n;
+
+	if (dir) n = *dir ? snprintf(name, size, "%s/%016llx.jcc", dir, key) : -1;
+	else if ((base = getenv("XDG_CACHE_HOME")) && *base) n = snprintf(name, size, "%s/jcshell/%016llx.jcc", base, key);
+	else if ((base = getenv("HOME"))) n = snprintf(name, size, "%s/.cache/jcshell/%016llx.jcc", base, key);
+	else n = -1;
+	return n < 0 || n >= (int) size ? -1 : 0;
+}
+
+/**
+ * Creates the directories of file name that do not exist
+ **/
+static void make_directories(char * name)
+{
+	char * slash;
+	for (slash = strchr(name + 1, '/'); slash; slash = strchr(slash + 1, '/'))
+	{
+		*slash = '\0';
+		mkdir(name, 0700);
+		*slash = '/';
+	}
+}
+
+static void add_word(image * img, uint32_t word)
+{
+	if (img->num_words == img->max_words)
+	{
+		size_t size = img->max_words ? img->max_words * 2 : 4096;
+		uint32_t * aux = (uint32_t *) realloc(img->words, size * sizeof(uint32_t));
+		if (!aux)
+		{
+			img->failed = 1;
+			return;
+		}
+		img->words = aux;
+		img->max_words = size;
+	}
+	img->words[img->num_words++] = word;
+}
+
+static int grow_table(image * img)
+{
+	size_t size = img->table_size ? img->table_size * 2 : 1024, i;
+	uint32_t * table = (uint32_t *) malloc(size * sizeof(uint32_t));
+
+	if (!table) return -1;
+	memset(table, 0xff, size * sizeof(uint32_t));
+	for (i = 0; i < img->table_size; i++)
+	{
+		uint32_t offset = img->table[i];
+		const char * s = img->strings + offset;
+		size_t b;
+		if (offset == NO_STRING) continue;
+		b = hash_bytes((const unsigned char *) s, strlen(s)) & (size - 1);
+		while (table[b] != NO_STRING) b = (b + 1) & (size - 1);
+		table[b] = offset;
+	}
+	free(img->table);
+	img->table = table;
+	img->table_size = size;
+	return 0;
+}
+
+/**
+ * Returns the offset of s in the string table, adding it the first time
+ **/
+static uint32_t add_string(image * img, const char * s)
+{
+	size_t len = strlen(s), b;
+
+	if (img->failed) return 0;
+	if (img->num_strings * 2 >= img->table_size && grow_table(img) == -1)
+	{
+		img->failed = 1;
+		return 0;
+	}
+	b = hash_bytes((const unsigned char *) s, len) & (img->table_size - 1);
+	for (; img->table[b] != NO_STRING; b = (b + 1) & (img->table_size - 1))
+	{
+		if (!strcmp(img->strings + img->table[b], s)) return img->table[b];
+	}
+
+	if (img->strings_size + len + 1 >= NO_STRING)
+	{
+		img->failed = 1;
+		return 0;
+	}
+	if (img->strings_size + len + 1 > img->max_strings)
+	{
+		size_t size = img->max_strings ? img->max_strings * 2 : 16384;
+		char * aux;
+		while (size < img->strings_size + len + 1) size *= 2;
+		aux = (char *) realloc(img->strings, size);
+		if (!aux)
+		{
+			img->failed = 1;
+			return 0;
+		}
+		img->strings = aux;
+		img->max_strings = size;
+	}
+	memcpy(img->strings + img->strings_size, s, len + 1);
+	img->table[b] = (uint32_t) img->strings_size;
+	img->num_strings++;
+	img->strings_size += len + 1;
+	return img->table[b];
+}
+
+/**
+ * Adds the record of a line the parser rejected
+ **/
+static void add_error(image * img, const char * message)
+{
+	add_word(img, FLAG_ERROR);
+	add_word(img, (uint32_t) -1);
+	add_word(img, 1);
+	add_word(img, 0);
+	add_word(img, add_string(img, message));
+	img->num_commands++;
+}
+
+/**
+ * Adds the record of a parsed line: args holds num_args arguments with a
+ * NULL at the end of each stage but the last one.
+ **/
+static void add_command(image * img, char ** args, int num_args, const redirection * redirections,
+	int num_redirections, int background, int builtin)
+{
+	int i;
+
+	add_word(img, background ? FLAG_BACKGROUND : 0);
+	add_word(img, (uint32_t) builtin);
+	add_word(img, (uint32_t) num_args);
+	add_word(img, (uint32_t) num_redirections);
+	for (i = 0; i < num_args; i++) add_word(img, args[i] ? add_string(img, args[i]) : NO_STRING);
+	for (i = 0; i < num_redirections; i++)
+	{
+		const redirection * r = &redirections[i];
+		add_word(img, (uint32_t) r->fd);
+		add_word(img, (uint32_t) r->flags);
+		add_word(img, (uint32_t) r->source);
+		add_word(img, (uint32_t) r->stage);
+		add_word(img, r->file ? add_string(img, r->file) : NO_STRING);
+	}
+	img->num_commands++;
+}
+
+/**
+ * Parses every line of the script read from fd (from its start) as the
+ * shell's main loop does, into img.
+ * Returns 0 on success or -1.
+ **/
+static int compile_lines(int fd, image * img)
+{
+	command_reader reader;
+	arena line_arena = ARENA_INITIALIZER;
+	char ** args;
+	int background;
+
+	if (lseek(fd, 0, SEEK_SET) == -1) return -1;
+	init_command_reader(&reader, fd);
+	while (!img->failed && (args = get_command(&reader, &background)) != NULL)
+	{
+		redirection * redirections;
+		char *** stages;
+		int num_redirections, num_args, num_stages, builtin = -1;
+
+		if (reader.num_args == 0) continue;
+		arena_reset(&line_arena);
+		redirections = arena_new(&line_arena, redirection, reader.num_args + 1);
+		stages = arena_new(&line_arena, char **, reader.num_args + 1);
+		if (!redirections || !stages)
+		{
+			img->failed = 1;
+			break;
+		}
+		num_redirections = parse_redirections(args, redirections, reader.num_args + 1);
+		if (num_redirections < 0)
+		{
+			add_error(img, parse_error());
+			continue;
+		}
+		for (num_args = 0; args[num_args]; num_args++);
+		num_stages = parse_pipeline(args, stages, reader.num_args + 1);
+		if (num_stages < 0) add_error(img, parse_error());
+		if (num_stages <= 0) continue;
+
+		/* Builtin of a single command, also after the time prefix */
+		if (num_stages == 1)
+		{
+			const char * name = strcmp(args[0], "time") ? args[0] : args[1];
+			builtin = name ? builtin_id(name) : -1;
+		}
+		add_command(img, args, num_args, redirections, num_redirections, background, builtin);
+	}
+	arena_release(&line_arena);
+	free(reader.buffer);
+	free(reader.args);
+	return img->failed ? -1 : 0;
+}
+
+/**
+ * Checks that every record of a mapped cache file stays inside it, so a
+ * damaged file is compiled again instead of being run.
+ * Returns 0 if they are valid or -1.
+ **/
+static int check_records(const cache_header * h, const uint32_t * w)
+{
+	uint64_t count = 0, i = 0;
+
+	while (i < h->num_words)
+	{
+		uint64_t num_args, size, k;
+		if (h->num_words - i < RECORD_WORDS) return -1;
+		num_args = w[i + 2];
+		size = RECORD_WORDS + num_args + (uint64_t) w[i + 3] * REDIRECTION_WORDS;
+		if (num_args == 0 || h->num_words - i < size) return -1;
+		if ((w[i] & FLAG_ERROR) && (num_args != 1 || w[i + 3] != 0)) return -1;
+		for (k = 0; k < num_args; k++)
+		{
+			uint32_t s = w[i + RECORD_WORDS + k];
+			/* Stages are never empty */
+			if (s == NO_STRING ? k == 0 || k + 1 == num_args || w[i + RECORD_WORDS + k - 1] == NO_STRING
+					: s >= h->strings_size)
+				return -1;
+		}
+		for (k = RECORD_WORDS + num_args + REDIRECTION_WORDS - 1; k < size; k += REDIRECTION_WORDS)
+		{
+			if (w[i + k] != NO_STRING && w[i + k] >= h->strings_size) return -1;
+		}
+		i += size;
+		count++;
+	}
+	return count == h->num_commands ? 0 : -1;
+}
+
+/**
+ * Maps the cache file name if it holds the compiled form of the script
+ * (real path real, open in fd with status st).
+ * Returns the script or NULL if it has to be compiled.
+ **/
+static compiled_script * map_cache(const char * name, const char * real, int fd, const struct stat * st)
+{
+	int cache_fd = open(name, O_RDONLY | O_CLOEXEC);
+	int64_t mtime = (int64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+	compiled_script * script;
+	struct stat cache_st;
+	cache_header * h;
+	char * base;
+
+	if (cache_fd == -1) return NULL;
+	if (fstat(cache_fd, &cache_st) == -1 || cache_st.st_size < (off_t) sizeof(cache_header))
+	{
+		close(cache_fd);
+		return NULL;
+	}
+	base = (char *) mmap(NULL, cache_st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, cache_fd, 0);
+	if (base == MAP_FAILED)
+	{
+		close(cache_fd);
+		return NULL;
+	}
+	h = (cache_header *) base;
+	if (memcmp(h->magic, CACHE_MAGIC, 8) || h->byte_order != CACHE_BYTE_ORDER
+		|| h->builtins != builtins_signature() || h->script_size != (uint64_t) st->st_size
+		|| h->records != sizeof(cache_header) || h->num_words > ((uint64_t) cache_st.st_size - h->records) / 4
+		|| h->strings != h->records + h->num_words * 4 || h->strings_size == 0
+		|| h->strings_size != (uint64_t) cache_st.st_size - h->strings || base[cache_st.st_size - 1] != '\0'
+		|| h->path >= h->strings_size || strcmp(base + h->strings + h->path, real)
+		|| hash_bytes((const unsigned char *) base + h->records, cache_st.st_size - h->records) != h->body_hash
+		|| check_records(h, (const uint32_t *) (base + h->records)) == -1)
+	{
+		munmap(base, cache_st.st_size);
+		close(cache_fd);
+		return NULL;
+	}
+
+	/*
+	 * The same mtime is trusted unless the cache file was written in the same
+	 * clock tick as the script, when the script may have changed after it was
+	 * read. Otherwise the contents decide, and a script rewritten with the same
+	 * contents keeps its cache with the new mtime.
+	 */
+	if (h->script_mtime_ns != mtime || !(st->st_mtim.tv_sec < cache_st.st_mtim.tv_sec
+			|| (st->st_mtim.tv_sec == cache_st.st_mtim.tv_sec && st->st_mtim.tv_nsec < cache_st.st_mtim.tv_nsec)))
+	{
+		int update_fd;
+		if (hash_file(fd, st->st_size) != h->script_hash)
+		{
+			munmap(base, cache_st.st_size);
+			close(cache_fd);
+			return NULL;
+		}
+		update_fd = open(name, O_WRONLY | O_CLOEXEC);
+		if (update_fd != -1)
+		{
+			pwrite(update_fd, &mtime, sizeof(mtime), offsetof(cache_header, script_mtime_ns));
+			close(update_fd);
+		}
+	}
+	close(cache_fd);
+
+	script = (compiled_script *) malloc(sizeof(compiled_script));
+	if (!script)
+	{
+		munmap(base, cache_st.st_size);
+		return NULL;
+	}
+	script->base = base;
+	script->size = cache_st.st_size;
+	script->mapped = 1;
+	return script;
+}
+
+/**
+ * Compiles the script (real path real, open in fd with status st) and
+ * writes its cache file name, if it can.
+ * Returns the script or NULL.
+ **/
+static compiled_script * compile_script(const char * name, const char * real, int fd, const struct stat * st)
+{
+	image img;
+	cache_header h;
+	compiled_script * script;
+	char * base, * tmp;
+	size_t size;
+
+	memset(&img, 0, sizeof(img));
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CACHE_MAGIC, 8);
+	h.byte_order = CACHE_BYTE_ORDER;
+	h.builtins = builtins_signature();
+	h.script_size = st->st_size;
+	h.script_mtime_ns = (int64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+	h.script_hash = hash_file(fd, st->st_size);
+	h.path = add_string(&img, real);
+
+	if (compile_lines(fd, &img) == -1)
+	{
+		free(img.words);
+		free(img.strings);
+		free(img.table);
+		return NULL;
+	}
+	h.num_commands = img.num_commands;
+	h.records = sizeof(cache_header);
+	h.num_words = img.num_words;
+	h.strings = h.records + img.num_words * 4;
+	h.strings_size = img.strings_size;
+
+	/* One block, as the file is mapped */
+	size = h.strings + h.strings_size;
+	base = (char *) malloc(size);
+	if (base)
+	{
+		if (img.num_words) memcpy(base + h.records, img.words, img.num_words * 4);
+		memcpy(base + h.strings, img.strings, img.strings_size);
+		h.body_hash = hash_bytes((const unsigned char *) base + h.records, size - h.records);
+		memcpy(base, &h, sizeof(h));
+	}
+	free(img.words);
+	free(img.strings);
+	free(img.table);
+	script = base ? (compiled_script *) malloc(sizeof(compiled_script)) : NULL;
+	if (!script)
+	{
+		free(base);
+		return NULL;
+	}
+	script->base = base;
+	script->size = size;
+	script->mapped = 0;
+
+	/* Written to a temporary file and renamed, so other shells never map half of it */
+	tmp = (char *) malloc(strlen(name) + 8);
+	if (tmp)
+	{
+		int tmp_fd;
+		sprintf(tmp, "%s.XXXXXX", name);
+		make_directories(tmp);
+		tmp_fd = mkostemp(tmp, O_CLOEXEC);
+		if (tmp_fd != -1)
+		{
+			size_t done = 0;
+			ssize_t n = 0;
+			while (done < size && (n = write(tmp_fd, base + done, size - done)) > 0) done += n;
+			if (close(tmp_fd) == -1 || done < size || rename(tmp, name) == -1) unlink(tmp);
+		}
+		free(tmp);
+	}
+	return script;
+}
+
+/**
+ * Returns the compiled form of the script at path, already open in fd:
+ * its cache file if it is up to date, or the result of compiling it now
+ * (which is also stored for later runs). Call it after the builtins have
+ * been registered.
+ * Returns NULL if the script is not a regular file, the cache is turned off
+ * or compiling fails; fd is then at the start of the script, to be read
+ * line by line.
+ **/
+compiled_script * open_compiled_script(const char * path, int fd)
+{
+	char real[PATH_MAX], name[PATH_MAX + 64];
+	compiled_script * script;
+	struct stat st;
+
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) return NULL;
+	if (!realpath(path, real) || cache_file_name(real, name, sizeof(name)) == -1) return NULL;
+
+	script = map_cache(name, real, fd, &st);
+	if (!script) script = compile_script(name, real, fd, &st);
+	if (!script)
+	{
+		lseek(fd, 0, SEEK_SET);
+		return NULL;
+	}
+	script->next = (const uint32_t *) (script->base + ((cache_header *) script->base)->records);
+	script->end = script->next + ((cache_header *) script->base)->num_words;
+	script->strings = script->base + ((cache_header *) script->base)->strings;
+	script->generation = builtin_generation();
+	return script;
+}
+
+/**
+ * Fills command with the next command of the script, its arrays allocated
+ * in a (released with the rest of the command).
+ * Returns 1, or 0 at the end of the script or if there is no memory.
+ **/
+int next_compiled_command(compiled_script * script, compiled_command * command, arena * a)
+{
+	const uint32_t * w = script->next;
+	int i, stage = 0;
+
+	if (w == script->end) return 0;
+	command->background = w[0] & FLAG_BACKGROUND;
+	command->builtin = (int) w[1];
+	command->num_redirections = (int) w[3];
+	command->num_stages = 1;
+	for (i = 0; i < (int) w[2]; i++) command->num_stages += w[RECORD_WORDS + i] == NO_STRING;
+
+	command->args = arena_new(a, char *, w[2] + 1);
+	command->stages = arena_new(a, char **, command->num_stages);
+	command->redirections = arena_new(a, redirection, command->num_redirections + 1);
+	if (!command->args || !command->stages || !command->redirections) return 0;
+	script->next = w + RECORD_WORDS + w[2] + w[3] * REDIRECTION_WORDS;
+
+	command->error = (w[0] & FLAG_ERROR) ? script->strings + w[RECORD_WORDS] : NULL;
+	command->stages[0] = command->args;
+	for (i = 0; i < (int) w[2]; i++)
+	{
+		uint32_t s = w[RECORD_WORDS + i];
+		command->args[i] = s == NO_STRING ? NULL : script->strings + s;
+		if (s == NO_STRING) command->stages[++stage] = command->args + i + 1;
+	}
+	command->args[w[2]] = NULL;
+
+	w += RECORD_WORDS + w[2];
+	for (i = 0; i < command->num_redirections; i++, w += REDIRECTION_WORDS)
+	{
+		redirection * r = &command->redirections[i];
+		r->fd = (int) w[0];
+		r->flags = (int) w[1];
+		r->source = (int) w[2];
+		r->stage = (int) w[3];
+		r->file = w[4] == NO_STRING ? NULL : script->strings + w[4];
+	}
+	return 1;
+}
+
+/**
+ * Returns the builtin a compiled command calls (name is its command name),
+ * or NULL if it runs an external program. The id resolved when the script
+ * was compiled is used while no builtin has been loaded, enabled or
+ * disabled since; after that the name is looked up again.
+ **/
+const builtin_definition * compiled_builtin(compiled_script * script, const compiled_command * command,
+	const char * name)
+{
+	if (builtin_generation() != script->generation) return find_builtin(name);
+	return command->builtin >= 0 ? builtin_by_id(command->builtin) : NULL;
+}
@@ -0,0 +1,56 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the script_cache module
+ *
+ * Compiled scripts: the first run of a script tokenizes every line once,
+ * with the same get_command(), parse_redirections() and parse_pipeline()
+ * the shell uses, and stores the result in a cache file: the arguments of
+ * each stage, the redirections, the background flag and the id of the
+ * builtin it calls, with every string kept once in a string table. Later
+ * runs map the cache file and hand out the commands ready to run, so a
+ * large script starts at the speed its cache is read.
+ *
+ * A cache file is named after the script's path and keeps its size, mtime
+ * and a hash of its contents. A script with another size is compiled
+ * again; one that was rewritten with the same contents (a new mtime) is
+ * hashed and keeps its cache. Cache files live in $JCSHELL_CACHE, or
+ * $XDG_CACHE_HOME/jcshell, or ~/.cache/jcshell; an empty $JCSHELL_CACHE
+ * turns the cache off.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _SCRIPT_CACHE_H
+#define _SCRIPT_CACHE_H
+
+#include "job_control.h"
+#include "arena.h"
+#include "builtin_registry.h"
+
+/* A command of a compiled script, as the parser leaves it for a line */
+typedef struct compiled_command_
+{
+	char ** args;              /* Arguments of every stage, each stage ends with NULL */
+	char *** stages;           /* First argument of each stage */
+	int num_stages;
+	redirection * redirections;
+	int num_redirections;
+	int background;            /* 1 if the line ended with '&' */
+	int builtin;               /* Builtin id of the command when it was compiled, -1 if none */
+	const char * error;        /* Syntax error of the line, reported instead of running it */
+} compiled_command;
+
+typedef struct compiled_script_ compiled_script;
+
+/**
+ * Public Functions
+ **/
+compiled_script * open_compiled_script(const char * path, int fd);
+int next_compiled_command(compiled_script * script, compiled_command * command, arena * a);
+const builtin_definition * compiled_builtin(compiled_script * script, const compiled_command * command,
+	const char * name);
+
+#endif
@@ -1,652 +1,2137 @@
-/* FELIPE OEHLER GUZMÁN */
-
-/**
- * Linux Job Control Shell Project
- *
- * Operating Systems
- * Grados Ing. Informatica & Software
- * Dept. de Arquitectura de Computadores - UMA
- *
- * Some code adapted from "OS Concepts Essentials", Silberschatz et al.
- *
- * To compile and run the program:
- *   $ gcc shell.c job_control.c -o shell
- *   $ ./shell
- *	(then type ^D to exit program)
- **/
-
-#include "job_control.h"   /* Remember to compile with module job_control.c */
-
-#define MAX_LINE 256 /* 256 chars per line, per command, should be enough */
-
-job * my_job_list; /* List of jobs in the background or suspended */
-
-/**
- * Signal handler for SIGCHLD (child process state changes)
- * This function is called when a child process changes state (stopped, continued, or terminated).
- * It iterates through the job list, checks for state changes, and updates or removes jobs accordingly.
- **/
-void sigchld_handler(int num_sig) {
-	int status, info;
-	pid_t pid_wait;
-	enum status status_res;
-	job_iterator iter = get_iterator(my_job_list); /* Get iterator to go through job list */
-
-	while(has_next(iter)) {   
-		job *the_job = next(iter); /* Get next job in the list */
-
-		pid_wait = waitpid(the_job->pgid, &status, WUNTRACED | WCONTINUED | WNOHANG);
-
-		if (pid_wait == the_job->pgid) { /* If the job's state has changed */
-			status_res = analyze_status(status, &info); /* Analyze the status of the job */
-			printf("Background pid: %d, command: %s, %s, info: %d\n", the_job->pgid, the_job->command, status_strings[status_res], info);
-			
-			/* Update job state based on its status */
-			if(status_res == SUSPENDED) { 			/* The background job was suspended */
-				the_job->state = STOPPED; 
-
-			} else if (status_res == CONTINUED) { 	/* The background job was continued */
-				the_job->state = BACKGROUND; 
-
-			} else {								/* Job was finished or signaled */
-				delete_job(my_job_list, the_job); 
-			}
-
-		} else if (pid_wait == -1) {
-			perror("Wait error from sigchld_handler");
-		}
-	} 
-}
-
-/**
- * Signal handler for SIGHUP (hangup signal)
- * This function is called when the shell receives a SIGHUP signal.
- * It appends a message to the file "hup.txt" indicating that SIGHUP was received.
- **/
-void sighup_handler(int num_sig) {
-	FILE *fp;
-	fp = fopen("hup.txt", "a"); /* Open file in append mode */
-	if (fp) {
-		fprintf(fp, "SIGHUP received.\n"); /* Write to the file */
-		fclose(fp);
-	}
-}
-
-/**
- * Parses the command arguments for output append redirection (>>).
- * - Searches for the ">>" token in the args array.
- * - If found, sets *file_out to the filename following ">>".
- * - Removes ">>" and the filename from the args array so execvp won't see them.
- * - If syntax is incorrect (no filename after ">>"), prints an error and clears the command.
- */
-void parse_append_redirection(char **args, char **file_out) {
-    *file_out = NULL;
-    char **args_start = args;
-    while (*args) {
-        int is_out = !strcmp(*args, ">>");
-        if (is_out) {
-            args++;
-            if (*args){
-                if (is_out) *file_out = *args;
-                char **aux = args + 1;
-                while (*aux) {
-                   *(aux-2) = *aux;
-                   aux++;
-                }
-                *(aux-2) = NULL;
-                args--;
-            } else {
-                /* Syntax error */
-                fprintf(stderr, "syntax error in redirection\n");
-                args_start[0] = NULL; // Do nothing
-            }
-        } else {
-            args++;
-        }
-    }
-}
- 
-/**
- * MAIN
- **/
-int main(void)
- {
-	char inputBuffer[MAX_LINE]; /* Buffer to hold the command entered */
-	int background;             /* Equals 1 if a command is followed by '&' */
-	char *args[MAX_LINE/2];     /* Command line (of 256) has max of 128 arguments */
-
-	/* Probably useful variables: */
-	int pid_fork, pid_wait; 	/* PIDs for created and waited processes */
-	int status;             	/* Status returned by wait */
-	enum status status_res; 	/* Status processed by analyze_status() */
-	int info;					/* Info processed by analyze_status() */
-	int newfd_in, oldfd_in;		/* File descriptors used in input redirection */
-	int newfd_out, oldfd_out;	/* File descriptors used in output redirection */
-	int newfd_out_append, oldfd_out_append; /* File descriptors used in output append redirection */
- 
-	/* Initialize signal handling and job list */
-	ignore_terminal_signals();
-	my_job_list = new_list("Job List");	/* List of jobs in the background or suspended */
-	signal(SIGCHLD, sigchld_handler);
-	signal(SIGHUP, sighup_handler);
-
-	while (1)   /* Program terminates normally inside get_command() after ^D is typed*/
-	{   		
-		printf("COMMAND->");
-		fflush(stdout);
-		get_command(inputBuffer, MAX_LINE, args, &background);  /* Get next command */
-		
-		/* Handle input and output redirection */
-		char *file_in, *file_out, *file_out_append;
-		parse_redirections(args, &file_in, &file_out);
-		parse_append_redirection(args, &file_out_append);
-		 
-		if(args[0]==NULL) continue;   /* Do nothing if empty command */
-
-		/* 
-         * Built-in command: exit
-         * Terminates the shell process.
-         * Prints a goodbye message and exits with success status.
-         */
-		if(!strcmp(args[0], "exit")) {
-			printf("Bye\n");
-			exit(EXIT_SUCCESS);
-
-		/* 
-         * Built-in command: cd
-         * Changes the current working directory of the shell.
-         * If no argument is given, changes to the user's HOME directory.
-         * On error, prints an error message.
-         */
-		} else if(!strcmp(args[0], "cd")) {	
-			char* path = (args[1] == NULL) ? getenv("HOME") : args[1];
-			int cd_status = chdir(path);
-			if(cd_status == -1) {
-				perror("cd error");
-			} else {
-				printf("Current working directory changed to %s\n", path);
-			}
-
-		/* 
-         * Built-in command: jobs
-         * Lists all jobs that are currently in the background or stopped.
-         * If there are no jobs, prints a message indicating so.
-         */
-		} else if (!strcmp(args[0], "jobs")) {
-			if(empty_list(my_job_list)) {
-				printf("There are no jobs in background or stopped\n");
-			} else {
-				print_job_list(my_job_list); /* Print list of background jobs */
-			}
-
-		/* 
-         * Built-in command: fg
-         * Brings a background or stopped job to the foreground.
-         * If a job position is given as an argument, uses that; otherwise, defaults to position 1.
-         * - Finds the job in the job list.
-         * - If found, resumes it if stopped, sets terminal control, and waits for it to finish or stop.
-         * - Removes the job from the job list and updates its state.
-         * - Handles signals and terminal control properly.
-         */
-		} else if (!strcmp(args[0], "fg")) {
-			int pos = (args[1] == NULL) ? 1 : atoi(args[1]);
-			block_SIGCHLD();
-			job* fg_job = get_item_bypos(my_job_list, pos);
-
-			if(fg_job == NULL) { /* No jobs found */
-				printf("There is no job in position %d\n", pos);
-				unblock_SIGCHLD();
-
-			} else {
-				int fg_job_pgid = fg_job->pgid;
-				char fg_job_command[MAX_LINE];
-				strcpy(fg_job_command, fg_job->command);
-
-				if(fg_job->state == STOPPED) {
-					printf("Resuming job in foreground: [%d] %s\n", pos, fg_job_command);
-				} else {
-					printf("Bringing job to foreground: [%d] %s\n", pos, fg_job_command);
-				}
-
-				set_terminal(fg_job_pgid); /* Set terminal to job's process group */
-				fg_job->state = FOREGROUND; /* Change state to foreground */
-
-				int fg_status = killpg(fg_job_pgid, SIGCONT); /* Continue the job */
-				if(fg_status == -1) {
-					perror("fg error");
-					unblock_SIGCHLD();
-					set_terminal(getpid());
-				}
-				delete_job(my_job_list, fg_job); /* Remove job from job list */
-
-				unblock_SIGCHLD();
-
-				pid_wait = waitpid(fg_job_pgid, &status, WUNTRACED); /* Wait for the job */
-				set_terminal(getpid());	 /* Set terminal back to shell */
-				block_SIGCHLD();
-				if (pid_wait == -1) {
-					perror("waitpid error");
-					unblock_SIGCHLD();
-
-				} else {
-					if (WIFSTOPPED(status)) {
-						add_job(my_job_list, new_job(fg_job_pgid, fg_job_command, STOPPED));
-						printf("Process stopped by signal: %d\n", WSTOPSIG(status));
-					} else if (WIFCONTINUED(status)) {
-						printf("Process continued\n");
-					} else {
-						if (WIFEXITED(status)) {
-							printf("Process completed with exit code: %d\n", WEXITSTATUS(status));
-						} else if (WIFSIGNALED(status)) {
-							printf("Process terminated by signal: %d\n", WTERMSIG(status));
-						}
-					}
-
-					status_res = analyze_status(status, &info);
-					printf("Foreground pid: %d, command: %s, %s, info: %d\n", fg_job_pgid, fg_job_command, status_strings[status_res], info);
-					unblock_SIGCHLD();
-				}
-			}
-		
-		/* 
-         * Built-in command: bg
-         * Continues a stopped job in the background.
-         * If a job position is given as an argument, uses that; otherwise, defaults to position 1.
-         * - Finds the job in the job list.
-         * - If found, sets its state to BACKGROUND and sends SIGCONT to its process group.
-         * - Handles errors if the job does not exist or cannot be continued.
-         */
-		} else if(!strcmp(args[0], "bg")) {	
-			block_SIGCHLD();
-			int pos = (args[1] == NULL) ? 1 : atoi(args[1]);
-			job* bg_job = get_item_bypos(my_job_list, pos);
-
-			if(bg_job == NULL) { /* No jobs found */
-				printf("There is no job in position %d\n", pos);
-
-			} else {
-				bg_job->state = BACKGROUND;
-				int bg_status = killpg(bg_job->pgid, SIGCONT); /* Continue the background job */
-				if(bg_status == -1) {
-					perror("bg error");
-				}
-			}
-			unblock_SIGCHLD();
-
-		/* 
-         * Built-in command: currjob
-         * Prints information about the current (first) job in the job list.
-         * If there are no jobs, prints a message indicating so.
-         */
-		} else if(!strcmp(args[0], "currjob")) {
-			block_SIGCHLD();
-			job* current_job = get_item_bypos(my_job_list, 1);
-
-			if (current_job == NULL) { /* No jobs found */
-				printf("No current job\n");
-
-			} else {
-				printf("Current job: PID=%d command=%s\n", current_job->pgid, current_job->command);
-			}
-			unblock_SIGCHLD();
-
-		/* 
-         * Built-in command: deljob
-         * Deletes the current (first) job from the job list if it is running in background.
-         * - If there are no jobs, prints a message indicating so.
-         * - If the current job is stopped (suspended), does not allow deletion and prints a warning.
-         * - If the current job is running in background, deletes it from the job list and prints a confirmation.
-         */
-		} else if(!strcmp(args[0], "deljob")) {
-			block_SIGCHLD();
-			job* current_job = get_item_bypos(my_job_list, 1);
-
-			if (current_job == NULL) { /* No jobs found */
-				printf("No current job\n");
-
-			} else if (current_job->state == STOPPED) { /* The process is suspended */
-				printf("Cannot delete suspended background jobs\n");
-
-			} else if (current_job->state == BACKGROUND) { /* The process is running in background */
-				printf("Deleting current job from jobs list: PID=%d command=%s\n", current_job->pgid, current_job->command);
-				delete_job(my_job_list, current_job);
-			}
-			unblock_SIGCHLD();
-		
-		/* 
-         * Built-in command: zjobs
-         * Lists all zombie child processes whose parent is the shell.
-         * - Iterates through /proc to find processes in zombie state (state 'Z').
-         * - Prints the PID of each zombie child process whose parent PID matches the shell's PID.
-         */
-		} else if(!strcmp(args[0], "zjobs")) {
-			DIR *d;
-			struct dirent *dir;
-			char buff[2048];
-			d = opendir("/proc"); /* Open the /proc directory to iterate over all processes */
-			if (d) {
-				while ((dir = readdir(d)) != NULL) {
-					/* Build the path to the stat file of each process */
-					sprintf(buff, "/proc/%s/stat", dir->d_name);
-					FILE *fd = fopen(buff, "r");
-					if (fd) {
-						long pid;	/* PID */
-						long ppid;	/* Parent PID */
-						char state;	/* State: State: R (runnable), S (sleeping), T (stopped), Z (zombie) */
-					
-						/* Read the PID, command name, state and parent PID from /proc/<pid>/stat */
-						fscanf(fd, "%ld %s %c %ld", &pid, buff, &state, &ppid);
-						fclose(fd);
-
-						/* Check if the process is in zombie state and its parent is the shell */
-						if ((ppid == getpid()) && (state == 'Z')) { 
-							printf("%ld\n", pid);
-						}
-					}
-				} 
-				closedir(d); /* Close the /proc directory */
-			} else {
-				perror("Failed to open the /proc directory");
-			}
-
-		/* 
-         * Built-in command: bgteam
-         * Launches N background jobs running the specified command.
-         * Usage: bgteam <N> <command> [args...]
-         * - N: Number of background jobs to launch (must be > 0).
-         * - command: The command to execute in each background job.
-         * For each job:
-         *   - Forks a new child process.
-         *   - In the parent (shell), sets up the job in the background job list.
-         *   - In the child, executes the specified command with its arguments.
-         * If arguments are missing or N is not positive, prints an error message.
-         */
-		} else if(!strcmp(args[0], "bgteam")) {
-			if (args[1] == NULL || args[2] == NULL) {
-				/* Not enough arguments provided */
-				printf("The bgteam command requires two arguments");
-			
-			} else if (atoi(args[1]) > 0) {
-				int n = atoi(args[1]); /* Number of jobs to launch */
-
-				int i = 0;
-				while(i < n) { 
-					pid_fork = fork(); /* Fork a new process */
-
-					if (pid_fork > 0) { /* We are in the shell */
-						new_process_group(pid_fork);
-						printf("Background job running... pid: %d, command %s\n", pid_fork, args[2]);
-						block_SIGCHLD();
-						add_job(my_job_list, new_job(pid_fork, args[2], BACKGROUND));
-						unblock_SIGCHLD();
-
-					} else if (pid_fork == 0) { /* We are in the child */
-						restore_terminal_signals();
-						int j = 1;
-						char* new_args[MAX_LINE/2]; /* New arguments for execvp (skip "bgteam" and N) */
-						while (args[j] != NULL) {
-							j++;
-							new_args[j - 2] = args[j];
-						}
-
-						execvp(new_args[0], new_args); /* Execute the command */
-						printf("Error, command not found: %s\n", new_args[0]);
-						exit(EXIT_FAILURE);
-
-					} else { /* There was an error */
-						perror("Fork error");
-					}
-					++i;
-				}
-			}
-
-		/* 
-         * Built-in command: fico
-         * Runs the filecount.sh script, optionally with a prefix argument.
-         * - If run in the foreground, waits for the script to finish or stop, and prints its status.
-         * - If run in the background (with &), adds the job to the background job list.
-         * - Handles job control, terminal signals, and job list updates.
-         * Usage: fico [prefix]
-         *   - If [prefix] is given, passes it to filecount.sh to count files starting with that prefix.
-         *   - If no prefix is given, counts all files in the current directory.
-         */
-		} else if(!strcmp(args[0], "fico")) {
-			pid_fork = fork();
-
-			if (pid_fork > 0) { /* We are in the shell */
-				new_process_group(pid_fork);
-
-				if (!background) { /* The command was launched in the foreground */
-					set_terminal(pid_fork);
-					pid_wait = waitpid(pid_fork, &status, WUNTRACED);
-					set_terminal(getpid());
-					if (pid_wait == pid_fork) {
-						status_res = analyze_status(status, &info);
-						printf("Foreground pid: %d, command: fico, %s, info: %d\n", pid_fork, status_strings[status_res], info);
-
-						if (WIFSTOPPED(status)) { /* The command was stopped */
-							printf("Stopped pid: %d, command:fico, %s, info: %d\n", pid_fork, status_strings[status_res], info);
-							block_SIGCHLD();
-							add_job(my_job_list, new_job(pid_wait, "fico", STOPPED));
-							unblock_SIGCHLD();
-						}
-					} else if (pid_wait == -1) {
-						perror("Wait error");
-					}
-				
-				} else { /* The command was launched in the background */
-					printf("Background job running... pid: %d, command fico\n", pid_fork);
-					block_SIGCHLD();
-					add_job(my_job_list, new_job(pid_fork, "fico", BACKGROUND));
-					unblock_SIGCHLD();				}
-				
-			} else if (pid_fork == 0) { /* We are in the child */
-				if (!background) set_terminal(getpid());
-				restore_terminal_signals();
-
-				char *args_fico[] = {"./filecount.sh", args[1], NULL};
-				execvp(args_fico[0], args_fico); /* Execute the filecount.sh file */
-				exit(EXIT_FAILURE);
-			
-			} else {
-				perror("Fork error");
-			}
-		
-		/*
-         * Built-in command: mask
-         * Allows running a command with certain signals blocked (masked).
-         * Usage: mask <signal1> <signal2> ... -c <command> [args...]
-         * - The user specifies one or more signal numbers to block, followed by "-c" and the command to run.
-         * - The specified signals are blocked in the child process before executing the command.
-         * - If run in the foreground, waits for the command to finish or stop, and prints its status.
-         * - If run in the background (with &), adds the job to the background job list.
-         * - Handles syntax errors, job control, and terminal signals.
-         */
-		} else if(!strcmp(args[0], "mask")) {	
-			int signals[100];		/* Array to store signal numbers to block */
-			int num_signals = 0;	/* Size of the array */
-			int syntax_error = 0;	/* Flag for syntax error */
-			
-			/* Parse signal numbers until "-c" is found */
-			int i = 1;
-			while (args[i] != NULL && strcmp(args[i], "-c")) {
-				signals[i - 1] = atoi(args[i]);
-				if (signals[i - 1] <= 0) { /* Signal numbers must be positive */
-					printf("mask: error de sintaxis\n");
-					syntax_error = 1;
-				}
-				++i;
-				num_signals++;
-			}
-
-			/* Check for syntax errors: missing "-c" or command after "-c" */
-			if ((args [i] == NULL || args[i + 1] == NULL) && syntax_error == 0) {
-				printf("mask: error de sintaxis\n");
-				syntax_error = 1;
-
-			} else if (syntax_error == 0) {
-				++i; /* Move past "-c "*/
-				int j = 0;
-				char* new_args[MAX_LINE/2]; /* Arguments for the command to execute */
-
-				/* Copy command and its arguments after "-c" */
-				while (args[i] != NULL) {
-					new_args[j] = args[i];
-					++i;
-					++j;
-				}
-				new_args[j] = NULL;
-
-				pid_fork = fork(); /* Create child process */
-
-				if(pid_fork > 0) { /* We are in the shell */
-					new_process_group(pid_fork);
-
-					if(!background) { /* The command was launched in the foreground */
-						set_terminal(pid_fork);
-						pid_wait = waitpid(pid_fork, &status, WUNTRACED);
-						set_terminal(getpid());
-						if (pid_wait == pid_fork) {
-							status_res = analyze_status(status, &info);
-							printf("Foreground pid: %d, command: %s, %s, info: %d\n", pid_fork, new_args[0], status_strings[status_res], info);
-							
-							if (WIFSTOPPED(status)) { /* The command was stopped*/
-								printf("Stopped pid: %d, command: %s, %s, info: %d\n", pid_fork, new_args[0], status_strings[status_res], info);
-								add_job(my_job_list, new_job(pid_wait, new_args[0], STOPPED));
-							}
-						
-						} else if (pid_wait == -1) {
-							perror("Wait error");
-						}
-
-					} else { /* The job was launched in the background */
-						printf("Background job running... pid: %d, command %s\n", pid_fork, new_args[0]);
-						block_SIGCHLD();
-						add_job(my_job_list, new_job(pid_fork, new_args[0], BACKGROUND));
-						unblock_SIGCHLD();
-					}
-
-				} else if (pid_fork == 0) { /* We are in the child */
-					/* Block each specified signal in the children process */
-					int k = 0;
-					while (k < num_signals) {
-						block_signal(signals[k], 1);
-						k++;
-					}
-
-					if(!background) set_terminal(getpid()); /* Foreground process */
-					restore_terminal_signals();
-					execvp(new_args[0], new_args); /* Execute the command */
-					printf("Error, command not found: %s\n", new_args[0]);
-					exit(EXIT_FAILURE);
-
-				} else { /* There was an error */
-					perror("Fork error");
-				}
-			}
-
-		} else {
-
-			/** The steps are:
-			*	 (1) Fork a child process using fork()
-			*	 (2) The child process will invoke execvp()
-			* 	 (3) If background == 0, the parent will wait, otherwise continue
-			*	 (4) Shell shows a status message for processed command
-			* 	 (5) Loop returns to get_commnad() function
-			**/
-	
-			pid_fork = fork(); /* Create child process */
-
-			if(pid_fork > 0) { /* We are in the shell */
-				new_process_group(pid_fork);
-
-				if(!background) { /* The command was launched in the foreground */
-					set_terminal(pid_fork);
-					pid_wait = waitpid(pid_fork, &status, WUNTRACED);
-					set_terminal(getpid());
-					if (pid_wait == pid_fork) {
-						status_res = analyze_status(status, &info);
-						printf("Foreground pid: %d, command: %s, %s, info: %d\n", pid_fork, args[0], status_strings[status_res], info);
-						
-						if (WIFSTOPPED(status)) { /* The command was stopped*/
-							printf("Stopped pid: %d, command: %s, %s, info: %d\n", pid_fork, args[0], status_strings[status_res], info);
-							add_job(my_job_list, new_job(pid_wait, args[0], STOPPED));
-						}
-					
-					} else if (pid_wait == -1) {
-						perror("Wait error");
-					}
-
-				} else { /* The job was launched in the background */
-					printf("Background job running... pid: %d, command %s\n", pid_fork, args[0]);
-					block_SIGCHLD();
-					add_job(my_job_list, new_job(pid_fork, args[0], BACKGROUND));
-					unblock_SIGCHLD();
-				}
-	
-			} else if (pid_fork == 0) { /* We are in the child */
-				if(!background) set_terminal(getpid()); /* Foreground process */
-				restore_terminal_signals();
-
-				if(file_in != NULL || file_out != NULL || file_out_append != NULL) { /* Redirection */
-
-					if(file_in != NULL) { /* Input redirection */
-						newfd_in = open(file_in, O_RDONLY);
-						oldfd_in = fileno(stdin);
-						if(newfd_in == -1) {
-							perror("Error when opening input file");
-							continue;
-						}
-
-						if(dup2(newfd_in, oldfd_in) == -1) {
-							perror("Error redirectioning input");
-							close(newfd_in);
-							continue;
-						}
-					}
-
-					if(file_out != NULL) { /* Output redirection */
-						newfd_out = fileno(stdout);
-						oldfd_out = open(file_out, O_RDWR | O_CREAT | O_TRUNC, 0666);
-						if(newfd_out == -1) {
-							perror("Error when opening output file");
-							continue;
-						}
-
-						if(dup2(oldfd_out, newfd_out) == -1) {
-							perror("Error redirecioning output");
-							close(oldfd_out);
-							continue;
-						}
-					}
-
-					if(file_out_append != NULL) { /* Output append redirection */
-						newfd_out_append = fileno(stdout);
-						oldfd_out_append = open(file_out_append, O_RDWR | O_CREAT | O_APPEND, 0666);
-						if(newfd_out_append == -1) {
-							perror("Error when opening output file");
-							continue;
-						}
-
-						if(dup2(oldfd_out_append, newfd_out_append) == -1) {
-							perror("Error redirecioning output");
-							close(oldfd_out_append);
-							continue;
-						}
-					}
-
-					if(file_in != NULL)  close(newfd_in);
-					if(file_out != NULL) close(oldfd_out);
-					if(file_out_append != NULL) close(oldfd_out_append);
-				}
-
-				execvp(args[0], args); /* Execute the command */
-				printf("Error, command not found: %s\n", args[0]);
-				exit(EXIT_FAILURE);
-
-			} else { /* There was an error */
-				perror("Fork error");
-			}
-		}
-	} /* End while */
+/* FELIPE OEHLER GUZMÁN */
+
+/**
+ * Linux Job Control Shell Project
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ *
+ * Some code adapted from "OS Concepts Essentials", Silberschatz et al.
+ *
+ * To compile and run the program:
+ *   $ gcc shell.c job_control.c spawn_engine.c event_loop.c child_inventory.c arena.c path_cache.c trace.c file_count.c builtin_registry.c utility_builtins.c cpu_affinity.c job_output.c history.c completion.c line_editor.c script_cache.c memo_cache.c -o shell -pthread -ldl
+ *   $ ./shell
+ *	(then type ^D to exit program)
+ *
+ * Non-interactive use (no prompt and no terminal handover):
+ *   $ ./shell script.sh
+ *   $ ./shell -c 'command'          (several commands separated by newlines)
+ *   $ generate_commands | ./shell
+ **/
+
+#define _GNU_SOURCE
+#include "job_control.h"   /* Remember to compile with module job_control.c */
+#include "spawn_engine.h"  /* External command launcher (fork, vfork or posix_spawn) */
+#include "event_loop.h"    /* epoll core: stdin, signalfd and job pidfds */
+#include "child_inventory.h" /* Children of the shell and their state */
+#include "arena.h"         /* Per-command memory, released at the next prompt */
+#include "path_cache.h"    /* Programs already found in PATH */
+#include "trace.h"         /* Job lifecycle event ring */
+#include "file_count.h"    /* Native file counter of fico */
+#include "builtin_registry.h" /* Builtins by name, also loaded from shared objects */
+#include "utility_builtins.h" /* echo, printf, test, true, false, pwd and kill */
+#include "cpu_affinity.h"  /* CPU lists, core/node topology and re-pinning */
+#include "job_output.h"    /* Captured output of background jobs */
+#include "history.h"       /* Persistent, shared and indexed command history */
+#include "line_editor.h"   /* Raw mode line editing, history keys and completion */
+#include "completion.h"    /* Command trie and cached directory listings */
+#include "script_cache.h"  /* Scripts parsed once, run from their cache file */
+#include "memo_cache.h"    /* Replayed output of memo commands */
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <time.h>
+
+job_list * my_job_list; /* List of jobs in the background or suspended */
+int input_ready;           /* Set by the event loop when a command line can be read */
+int line_editing;          /* 1 when lines are typed in the line editor */
+int stdin_watched;         /* 1 if the event loop watches the standard input */
+sigset_t event_signals;    /* Signals read through the signalfd */
+int signal_fd;             /* signalfd of event_signals */
+int interrupted;           /* Set when ^C is typed during the sleep or wait builtins */
+struct winsize window_size; /* Terminal size, refreshed on SIGWINCH */
+int interactive;           /* 0 when running a script, -c or piped commands */
+int last_exit_status;      /* Exit status of the last foreground job, returned at the end of a script */
+int timed_builtin;         /* 1 while a builtin run by time has not launched a job */
+const redirection *job_redirections; /* Of a builtin run with &, applied in the job it starts */
+int num_job_redirections;
+int stdin_redirected;      /* 1 while a builtin runs with its stdin redirected */
+arena command_arena = ARENA_INITIALIZER; /* Everything parsed for the current command */
+
+/* A bgteam: N instances of a command, at most limit of them running at once */
+typedef struct team_ {
+	char **argv;          /* Copy of the command, "{}" arguments point to index_arg */
+	char index_arg[16];   /* Index of the instance being launched */
+	int total;            /* Instances to run */
+	int launched;         /* Instances started (or given up) */
+	int running;          /* Instances still alive */
+	int succeeded, failed;
+	int limit;            /* Maximum running at once */
+	int quiet;            /* 1 = only the summary is printed (throttled teams) */
+	cpu_set_t *slots;     /* --spread: CPUs of each core or node, NULL = not pinned */
+	int num_slots;
+	long long start_ns;
+} team;
+
+int active_teams = 0;      /* Teams with instances running or waiting to start */
+size_t capture_size = 0;   /* joblog on: bytes kept of each background job's output, 0 = off */
+
+/* A job followed by the wait builtin */
+typedef struct waited_job_ {
+	pid_t pgid;
+	int status;           /* Wait status once it has finished, -1 while it runs */
+} waited_job;
+
+waited_job *waited_jobs = NULL; /* Jobs of the wait in progress, NULL if none */
+int num_waited = 0, waited_left = 0;
+int first_waited_status;   /* Status of the first of them to finish */
+int first_finished_status = -1; /* Status of the first background job finished since it was reset */
+
+void team_member_done(team *the_team, int status);
+void input_event(int fd, unsigned int events, void *data);
+
+/**
+ * Hands the terminal to a process group (the shell's own to take it back). There is no
+ * terminal handover in non-interactive mode.
+ **/
+void give_terminal(pid_t pgid) {
+	if (!interactive) return;
+	set_terminal(pgid);
+	trace(TRACE_TCSETPGRP, getpid(), pgid, 0);
+}
+
+/**
+ * Prints a status change of a job: "<kind> pid: ..., command: ..., <status>, info: ...".
+ * Once every process of the job has finished, the CPU time and peak memory they used are
+ * added, and a job launched by the time builtin also prints its full report.
+ **/
+void report_job(const char *kind, job *the_job, int status) {
+	int info;
+	enum status status_res = analyze_status(status, &info);
+	printf("%s pid: %d, command: %s, %s, info: %d", kind, the_job->pgid, the_job->command, status_strings[status_res], info);
+	if (the_job->nprocs == 0) {
+		printf(", user: %.3f s, sys: %.3f s, max rss: %ld KB", the_job->usage.utime_us / 1e6,
+			the_job->usage.stime_us / 1e6, the_job->usage.maxrss_kb);
+	}
+	printf("\n");
+}
+
+/**
+ * Prints the report of the time builtin: wall time and the resources used.
+ **/
+void print_time(long long real_ns, const job_usage *u) {
+	printf("real\t%.3f s\n", real_ns / 1e9);
+	printf("user\t%.3f s\n", u->utime_us / 1e6);
+	printf("sys\t%.3f s\n", u->stime_us / 1e6);
+	printf("max rss\t%ld KB\n", u->maxrss_kb);
+	printf("faults\t%ld minor, %ld major\n", u->minflt, u->majflt);
+	printf("context switches\t%ld voluntary, %ld involuntary\n", u->nvcsw, u->nivcsw);
+}
+
+/**
+ * Time report of a finished job: from its launch to the end of its last process, with the
+ * resources used by all of its processes.
+ **/
+void print_job_time(job *the_job) {
+	print_time(the_job->end_ns - the_job->start_ns, &the_job->usage);
+}
+
+/**
+ * Time report of a builtin: the resources used by the shell itself since before.
+ **/
+void print_shell_time(long long start_ns, const struct rusage *before) {
+	struct rusage now;
+	job_usage u;
+	getrusage(RUSAGE_SELF, &now);
+	u.utime_us = (now.ru_utime.tv_sec - before->ru_utime.tv_sec) * 1000000LL + now.ru_utime.tv_usec - before->ru_utime.tv_usec;
+	u.stime_us = (now.ru_stime.tv_sec - before->ru_stime.tv_sec) * 1000000LL + now.ru_stime.tv_usec - before->ru_stime.tv_usec;
+	u.maxrss_kb = now.ru_maxrss;
+	u.minflt = now.ru_minflt - before->ru_minflt;
+	u.majflt = now.ru_majflt - before->ru_majflt;
+	u.nvcsw = now.ru_nvcsw - before->ru_nvcsw;
+	u.nivcsw = now.ru_nivcsw - before->ru_nivcsw;
+	print_time(monotonic_ns() - start_ns, &u);
+}
+
+/**
+ * Records the end of a background job for the wait and memo builtins.
+ **/
+void job_finished(pid_t pgid, int status) {
+	int i;
+	memo_job_finished(pgid, status);
+	if (first_finished_status == -1) first_finished_status = status;
+	for (i = 0; i < num_waited; i++) {
+		if (waited_jobs[i].pgid == pgid && waited_jobs[i].status == -1) {
+			waited_jobs[i].status = status;
+			if (waited_left-- == num_waited) first_waited_status = status;
+		}
+	}
+}
+
+/**
+ * Exit status of a command ($? in other shells) from its wait status: the exit code, or
+ * 128 + the signal that killed it.
+ **/
+int exit_code(int status) {
+	if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+	return WEXITSTATUS(status);
+}
+
+/**
+ * Applies the queued child state changes to their jobs.
+ * - Background and stopped jobs report their changes here, from the main loop.
+ * - A pipeline is a single unit: it is reported as stopped when its first process stops, as
+ *   continued when all of them are running again, and removed only when all of its stages
+ *   have finished, with the status of the last stage.
+ * - Changes of a foreground job are left for wait_job().
+ **/
+void update_jobs(void) {
+	int status;
+	pid_t pid;
+	job_usage usage;
+
+	reap_children(); /* Children left behind when the queue was full */
+	while (pop_child_event(&pid, &status, &usage)) {
+		job *the_job = apply_child_event(pid, status, &usage);
+		if (the_job == NULL || the_job->state == FOREGROUND) continue;
+
+		if (WIFSTOPPED(status) || WIFCONTINUED(status)) { /* If the job's state has changed */
+			if (WIFSTOPPED(status) && the_job->nstopped > 1) continue;  /* Already reported */
+			if (WIFCONTINUED(status) && the_job->nstopped > 0) continue; /* Still partly stopped */
+			report_job("Background", the_job, status);
+
+			/* Update job state based on its status */
+			if(WIFSTOPPED(status)) { 			/* The background job was suspended */
+				the_job->state = STOPPED; 
+			} else { 								/* The background job was continued */
+				the_job->state = BACKGROUND; 
+			}
+
+		} else if (the_job->nprocs == 0) {		/* Every stage finished or was signaled */
+			team *the_team = the_job->team;
+			int last_status = the_job->last_status;
+			if (the_team == NULL || !the_team->quiet) report_job("Background", the_job, last_status);
+			if (the_job->timed) print_job_time(the_job);
+			job_finished(the_job->pgid, last_status);
+			delete_job(my_job_list, the_job);
+			if (the_team != NULL) team_member_done(the_team, last_status); /* May launch the next one */
+		}
+	}
+}
+
+/**
+ * Waits for a job running in the foreground until all of its processes finish or one of
+ * them is stopped, running the event loop meanwhile (so background jobs keep being updated).
+ * The standard input leaves the event loop meanwhile: lines typed ahead are for later, and
+ * epoll would report them on every wait.
+ * *status receives the stop status, or the status of the last stage if the job finished.
+ */
+void wait_job(job *fg_job, int *status) {
+	if (stdin_watched) event_loop_remove(STDIN_FILENO);
+	while (1) {
+		update_jobs();
+		if (fg_job->nprocs == 0) {
+			*status = fg_job->last_status;
+			break;
+		}
+		if (fg_job->nstopped > 0) {
+			*status = fg_job->stop_status;
+			break;
+		}
+		event_loop_wait(-1); /* Sleep until a signal or pidfd event */
+	}
+	if (stdin_watched) event_loop_add(STDIN_FILENO, input_event, NULL);
+}
+
+/**
+ * SIGHUP (hangup signal) event.
+ * Appends a message to the file "hup.txt" indicating that SIGHUP was received.
+ **/
+void sighup_received(void) {
+	FILE *fp;
+	fp = fopen("hup.txt", "a"); /* Open file in append mode */
+	if (fp) {
+		fprintf(fp, "SIGHUP received.\n"); /* Write to the file */
+		fclose(fp);
+	}
+}
+
+/**
+ * Event handler for the signalfd (SIGCHLD, SIGHUP and SIGWINCH, plus SIGINT during sleep and wait).
+ * The signals are blocked for the whole life of the shell and read here as data, so they are
+ * handled synchronously from the event loop, never interrupting the shell.
+ * - SIGCHLD: collects the children that changed state and applies them to their jobs.
+ * - SIGHUP: records the hangup in hup.txt.
+ * - SIGWINCH: refreshes the terminal size.
+ * - SIGINT: ends the sleep and wait builtins.
+ **/
+void signal_event(int fd, unsigned int events, void *data) {
+	struct signalfd_siginfo info;
+	int child_changed = 0;
+
+	while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+		if (info.ssi_signo == SIGCHLD) {
+			child_changed = 1;
+			/* When the shell woke up for the change (the pidfd may have reaped it already in the same
+			   batch); several changes may be merged in one signal */
+			int event = TRACE_EXIT, status = 0;
+			if (info.ssi_code == CLD_EXITED) status = W_EXITCODE(info.ssi_status, 0);
+			else if (info.ssi_code == CLD_KILLED || info.ssi_code == CLD_DUMPED) status = info.ssi_status;
+			else if (info.ssi_code == CLD_STOPPED) event = TRACE_STOP, status = W_STOPCODE(info.ssi_status);
+			else if (info.ssi_code == CLD_CONTINUED) event = TRACE_CONTINUE, status = 0xffff;
+			trace_record_at(event_loop_wakeup_ns(), event, info.ssi_pid, process_pgid(info.ssi_pid), status);
+		} else if (info.ssi_signo == SIGHUP) {
+			sighup_received();
+		} else if (info.ssi_signo == SIGINT) {
+			interrupted = 1;
+		} else if (info.ssi_signo == SIGWINCH) {
+			ioctl(STDIN_FILENO, TIOCGWINSZ, &window_size);
+		}
+	}
+	if (child_changed) { /* Several SIGCHLD are merged, update_jobs() reaps them all */
+		int redraw = editor_hide(); /* Reports go above the line being typed */
+		update_jobs();
+		if (redraw) editor_show();
+	}
+}
+
+/**
+ * Event handler for the pidfd of a job leader: readable once the process exits.
+ * It is a per-job wake-up that does not depend on SIGCHLD being delivered. The pidfd stays
+ * readable while the rest of a pipeline runs, so it leaves the event loop after firing once.
+ **/
+void pidfd_event(int fd, unsigned int events, void *data) {
+	int redraw = editor_hide();
+	event_loop_remove(fd);
+	update_jobs();
+	if (redraw) editor_show();
+}
+
+/**
+ * Event handler for the standard input: a command line can be read without blocking.
+ * With the line editor, the line is complete only when the editor says so.
+ **/
+void input_event(int fd, unsigned int events, void *data) {
+	if (!line_editing || editor_input()) input_ready = 1;
+}
+
+/**
+ * Runs the event loop until the user has typed a command line (or closed the input).
+ * A standard input that epoll cannot watch (a regular file) is always ready.
+ **/
+void wait_input(void) {
+	if (!stdin_watched) return;
+	input_ready = 0;
+	while (!input_ready) event_loop_wait(-1);
+}
+
+/**
+ * Watches the job leader's pidfd, so the event loop wakes up when the job finishes.
+ * The pidfd belongs to the job and is closed with it.
+ **/
+void watch_job(job *the_job) {
+	the_job->pidfd = open_pidfd(the_job->pgid);
+	if (the_job->pidfd != -1) event_loop_add(the_job->pidfd, pidfd_event, NULL);
+}
+
+/**
+ * Prepares the launch of a command.
+ * In interactive mode every job gets its own process group and foreground jobs get the terminal.
+ * In non-interactive mode there is no terminal handover: foreground jobs stay in the shell's
+ * process group (so ^C from the terminal reaches them) and only background jobs get their own.
+ */
+void init_request(spawn_request *req, char **argv, int background) {
+	init_spawn_request(req, argv, background);
+	if (!interactive) {
+		req->foreground = 0;
+		if (!background) req->pgid = getpgrp();
+	}
+}
+
+/**
+ * Output capture of background jobs (joblog on): creates the log of a job about to be launched,
+ * whose write_fd the caller places on the job's stdout and stderr. Returns NULL when capture is
+ * off or the pipe could not be created (the job then writes to the terminal).
+ */
+job_output * capture_output(void) {
+	if (capture_size == 0) return NULL;
+	job_output *out = open_job_output(capture_size);
+	if (out == NULL) perror("joblog: output capture");
+	return out;
+}
+
+/**
+ * Kills and reaps a process just launched whose job could not be created: the shell could
+ * neither wait for it nor reach it with fg, bg or jobs. Takes the terminal back if it had it.
+ */
+void drop_launched(pid_t pid, const char *command, int background) {
+	fprintf(stderr, "Job error: out of memory, pid %d (%s) is killed\n", pid, command);
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	if (!background) give_terminal(getpid());
+}
+
+/**
+ * Creates the job of a command launched by a builtin (mask, pin, memo, a forked builtin).
+ * Under time, the first such job is the one measured: it is reported with its own usage.
+ * Returns NULL, with the command killed, if there is no memory for the job.
+ */
+job * launched_job(pid_t pgid, const char *command, int background) {
+	job *the_job = new_job(pgid, command, background ? BACKGROUND : FOREGROUND);
+	if (the_job == NULL) drop_launched(pgid, command, background);
+	else the_job->timed = timed_builtin;
+	timed_builtin = 0;
+	return the_job;
+}
+
+/**
+ * Adds a job to the job list, reporting it when the list cannot grow: the job keeps running
+ * but fg, bg and jobs cannot reach it.
+ */
+void list_job(job *the_job) {
+	if (!add_job(my_job_list, the_job))
+		fprintf(stderr, "Job list error: out of memory, pid %d (%s) is not listed\n", the_job->pgid, the_job->command);
+}
+
+/**
+ * Starts instances of a team until limit of them are running or all have been started.
+ * Every instance gets its index (1..N) in the BGTEAM_INDEX environment variable (the shell's
+ * own value, if the user set one, is restored afterwards) and in place of the "{}" arguments. Spread teams pin instance i to slot i % num_slots.
+ * A launch failure would repeat for the rest, so they are counted as failed without trying,
+ * and the jobs already started are reported; they keep running until the summary.
+ */
+void team_launch(team *the_team) {
+	spawn_request req;
+	pid_t pid;
+	char *user_index = getenv("BGTEAM_INDEX"); /* The user's own value, put back afterwards */
+
+	if (user_index != NULL) user_index = strdup(user_index);
+	init_request(&req, the_team->argv, 1);
+	while (the_team->running < the_team->limit && the_team->launched < the_team->total) {
+		snprintf(the_team->index_arg, sizeof(the_team->index_arg), "%d", the_team->launched + 1);
+		if (the_team->slots != NULL) req.cpus = &the_team->slots[the_team->launched % the_team->num_slots];
+		job_output *out = capture_output();
+		req.fd_out = req.fd_err = (out != NULL) ? out->write_fd : -1;
+		setenv("BGTEAM_INDEX", the_team->index_arg, 1);
+		pid = spawn_command(&req);
+		if (out != NULL) start_job_output(out, pid, the_team->argv[0]);
+		the_team->launched++;
+
+		job *member = (pid > 0) ? new_job(pid, the_team->argv[0], BACKGROUND) : NULL;
+		if (pid > 0 && member == NULL) drop_launched(pid, the_team->argv[0], 1);
+		if (member != NULL) { /* We are in the shell */
+			member->team = the_team;
+			if (req.cpus != NULL) format_cpu_list(req.cpus, member->cpus, sizeof(member->cpus));
+			watch_job(member);
+			list_job(member);
+			the_team->running++;
+			if (!the_team->quiet) printf("Background job running... pid: %d, command %s\n", pid, member->command);
+		} else { /* Launch failed, the rest would fail the same way */
+			printf("bgteam %s: launch %d failed, %d of %d jobs started (%d running), the rest are not launched\n",
+				the_team->argv[0], the_team->launched, the_team->launched - 1, the_team->total, the_team->running);
+			the_team->failed += the_team->total - the_team->launched + 1;
+			the_team->launched = the_team->total;
+		}
+	}
+	if (user_index != NULL) setenv("BGTEAM_INDEX", user_index, 1);
+	else unsetenv("BGTEAM_INDEX");
+	free(user_index);
+	team_member_done(the_team, -1); /* Nothing running: the team may already be over */
+}
+
+/**
+ * Accounts for a finished instance of a team (status -1: none finished) and keeps the team
+ * going. When every instance is done, prints the summary and releases the team.
+ */
+void team_member_done(team *the_team, int status) {
+	if (status != -1) {
+		the_team->running--;
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) the_team->succeeded++;
+		else the_team->failed++;
+		if (the_team->launched < the_team->total) {
+			team_launch(the_team); /* A slot is free for the next instance */
+			return;
+		}
+	}
+	if (the_team->running > 0 || the_team->launched < the_team->total) return;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	printf("bgteam %s: %d jobs, %d succeeded, %d failed, wall time %.3f s\n",
+		the_team->argv[0], the_team->total, the_team->succeeded, the_team->failed,
+		((long long) now.tv_sec * 1000000000LL + now.tv_nsec - the_team->start_ns) / 1e9);
+	free(the_team->argv);
+	free(the_team->slots);
+	free(the_team);
+	active_teams--;
+}
+
+/**
+ * Creates a team running argv total times with at most limit instances at once.
+ * The command is copied, as args only last until the next command is read.
+ */
+team * new_team(char **argv, int total, int limit, int quiet) {
+	int argc = 0, i;
+	size_t size = 0;
+	while (argv[argc] != NULL) size += strlen(argv[argc++]) + 1;
+
+	team *the_team = (team *) calloc(1, sizeof(team));
+	char **copy = (char **) malloc((argc + 1) * sizeof(char *) + size);
+	if (the_team == NULL || copy == NULL) {
+		perror("bgteam error");
+		free(the_team);
+		free(copy);
+		return NULL;
+	}
+	char *strings = (char *) (copy + argc + 1);
+	for (i = 0; i < argc; i++) {
+		copy[i] = strcmp(argv[i], "{}") ? strcpy(strings, argv[i]) : the_team->index_arg;
+		strings += strlen(argv[i]) + 1;
+	}
+	copy[argc] = NULL;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	the_team->argv = copy;
+	the_team->total = total;
+	the_team->limit = limit;
+	the_team->quiet = quiet;
+	the_team->start_ns = (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+	active_teams++;
+	return the_team;
+}
+
+/**
+ * Native file counter of the fico builtin (see file_count.c).
+ * Returns the exit status: 0 if some file was found, 1 otherwise or on errors.
+ */
+int fico(char **args) {
+	char *prefix = NULL;
+	int recursive = 0, threads = 0, i;
+
+	for (i = 1; args[i] != NULL; i++) {
+		if (!strcmp(args[i], "-r")) {
+			recursive = 1;
+		} else if (!strcmp(args[i], "-j") && args[i + 1] != NULL && atoi(args[i + 1]) > 0) {
+			threads = atoi(args[++i]);
+		} else if (prefix == NULL) {
+			prefix = args[i];
+		} else {
+			printf("fico requires one or zero arguments\n");
+			return 1;
+		}
+	}
+
+	long filecount = count_files(".", prefix, recursive, threads);
+	if (filecount < 0) {
+		perror("fico error");
+		return 1;
+	}
+	printf("Number of files found: %ld\n", filecount);
+	return filecount > 0 ? 0 : 1;
+}
+
+/**
+ * Launches the stages of a pipeline (a single command is a one stage pipeline).
+ * - Every stage is a child of the shell, connected to the next one through a pipe.
+ * - All of them join the process group of the first stage.
+ * - Every stage gets the redirections written in it (the list is ordered by stage), applied
+ *   after its pipe ends.
+ * - If a stage cannot be started, the ones before it are killed.
+ * Returns the job describing the pipeline, or NULL if it could not be started.
+ */
+job * launch_pipeline(char **stages[], int num_stages, int background,
+		const redirection *redirections, int num_redirections) {
+	spawn_request req;
+	pid_t *pids = arena_new(&command_arena, pid_t, num_stages);
+	int fds[2], prev_read = -1;
+	int launched = 0;
+	pid_t pid, pgid = 0, last_pid = 0;
+	long long start_ns = monotonic_ns();
+	size_t command_len = 0;
+	char *command, *end;
+	job_output *out;
+
+	/* Job label: the program of every stage, "cmd1 | cmd2 | ..." */
+	int i = 0;
+	for (i = 0; i < num_stages; i++) command_len += strlen(stages[i][0]) + 3;
+	command = arena_new(&command_arena, char, command_len + 1);
+	if (pids == NULL || command == NULL) {
+		perror("Pipeline error");
+		return NULL;
+	}
+	*command = '\0';
+	end = command;
+	out = background ? capture_output() : NULL; /* Only once nothing can fail before start_job_output() */
+
+	i = 0;
+	while (i < num_stages) {
+		init_request(&req, stages[i], background);
+		if (pgid != 0 && req.pgid == 0) req.pgid = pgid; /* Join the group of the first stage */
+		req.fd_in = prev_read;
+		req.redirections = redirections;
+		while (req.num_redirections < num_redirections && redirections[req.num_redirections].stage == i)
+			req.num_redirections++;
+		redirections += req.num_redirections;
+		num_redirections -= req.num_redirections;
+		if (i < num_stages - 1) {
+			if (pipe2(fds, O_CLOEXEC) == -1) {
+				perror("Pipe error");
+				break;
+			}
+			req.fd_out = fds[1];
+		} else if (out != NULL) {
+			req.fd_out = out->write_fd;
+		}
+		if (out != NULL) req.fd_err = out->write_fd;
+
+		pid = spawn_command(&req);
+
+		/* The shell keeps only the read end for the next stage */
+		if (prev_read != -1) close(prev_read);
+		prev_read = -1;
+		if (i < num_stages - 1) {
+			close(fds[1]);
+			prev_read = fds[0];
+		}
+		if (pid <= 0) break;
+
+		if (pgid == 0) pgid = pid;
+		last_pid = pid;
+		pids[launched++] = pid;
+		end = stpcpy(end, i > 0 ? " | " : "");
+		end = stpcpy(end, stages[i][0]);
+		++i;
+	}
+	if (prev_read != -1) close(prev_read);
+	job *new = NULL;
+	if (i == num_stages && launched > 0) {
+		new = new_job(pgid, command, background ? BACKGROUND : FOREGROUND);
+		if (new == NULL) fprintf(stderr, "Job error: out of memory, pid %d (%s) is killed\n", pgid, command);
+	}
+	if (new == NULL && launched > 0) {
+		/* Half a pipeline, or one without a job, is not run: its stages are killed and reaped */
+		for (i = 0; i < launched; i++) kill(pids[i], SIGKILL);
+		for (i = 0; i < launched; i++) waitpid(pids[i], NULL, 0);
+		if (!background) give_terminal(getpid());
+		launched = 0;
+	}
+	if (out != NULL) start_job_output(out, launched > 0 ? pgid : -1, command);
+
+	if (new != NULL) {
+		new->nprocs = launched;
+		new->last_pid = last_pid;
+		new->start_ns = start_ns; /* Include the launch of every stage */
+		for (i = 1; i < launched; i++) track_process(new, pids[i]);
+	}
+	return new;
+}
+
+/**
+ * Waits for a job launched in the foreground until it finishes or is stopped.
+ * - Gives the terminal back to the shell and prints the job status.
+ * - A stopped job is added to the job list, a finished one is released (and stored by memo
+ *   if it was recording it).
+ * Returns the wait status.
+ */
+int wait_foreground(job *fg_job) {
+	int status;
+	wait_job(fg_job, &status);
+	give_terminal(getpid());
+
+	if (!WIFSTOPPED(status)) last_exit_status = exit_code(status);
+	if (interactive) report_job("Foreground", fg_job, status);
+
+	if (WIFSTOPPED(status)) { /* The command was stopped */
+		report_job("Stopped", fg_job, status);
+		fg_job->state = STOPPED;
+		list_job(fg_job);
+	} else {
+		if (fg_job->timed) print_job_time(fg_job);
+		memo_job_finished(fg_job->pgid, status);
+		free_job(fg_job);
+	}
+	return status;
+}
+
+/**
+ * Finishes the launch of a job: waits for it if it runs in the foreground,
+ * otherwise adds it to the job list.
+ */
+void place_job(job *the_job, int background) {
+	watch_job(the_job);
+	if (!background) {
+		wait_foreground(the_job);
+	} else {
+		printf("Background job running... pid: %d, command %s\n", the_job->pgid, the_job->command);
+		list_job(the_job);
+	}
+}
+ 
+/**
+ * Runs a builtin launched with & as a background job: forks a child in its own process group
+ * with default signals (and its output captured after joblog on), and adds it to the job list.
+ * Returns 0 in the child, which runs the builtin and exits, and the pid in the shell (-1 on error).
+ */
+pid_t fork_builtin_job(const char *name) {
+	sigset_t none;
+	job_output *out = capture_output();
+	fflush(stdout); /* Not to be printed again by the child */
+	pid_t pid = fork();
+	if (pid == 0) {
+		int failed;
+		if (out != NULL) {
+			dup2(out->write_fd, STDOUT_FILENO);
+			dup2(out->write_fd, STDERR_FILENO);
+			close(out->write_fd);
+			close(out->fd);
+		}
+		if (apply_redirections(job_redirections, num_job_redirections, &failed) == -1) {
+			perror(job_redirections[failed].file ? job_redirections[failed].file : "Redirection error");
+			_exit(EXIT_FAILURE);
+		}
+		setpgid(0, 0);
+		restore_terminal_signals();
+		sigemptyset(&none);
+		sigprocmask(SIG_SETMASK, &none, NULL);
+	} else if (pid > 0) {
+		setpgid(pid, pid); /* Set from both sides, whoever runs first */
+		job *the_job = launched_job(pid, name, 1);
+		if (the_job != NULL) place_job(the_job, 1);
+		else pid = -1;
+	} else {
+		perror("Fork error");
+	}
+	if (pid != 0 && out != NULL) start_job_output(out, pid, name);
+	return pid;
+}
+
+/*
+ * Built-in command: exit
+ * Terminates the shell process.
+ * Prints a goodbye message and exits with success status (a script exits silently with
+ * the status of its last foreground command).
+ */
+int builtin_exit(int argc, char **args, builtin_context *ctx) {
+	if (!interactive) exit(last_exit_status);
+	printf("Bye\n");
+	exit(EXIT_SUCCESS);
+	return 0;
+}
+
+/*
+ * Built-in command: cd
+ * Changes the current working directory of the shell.
+ * If no argument is given, changes to the user's HOME directory.
+ * On error, prints an error message.
+ */
+int builtin_cd(int argc, char **args, builtin_context *ctx) {
+	char* path = (args[1] == NULL) ? getenv("HOME") : args[1];
+	int cd_status = chdir(path);
+	if(cd_status == -1) {
+		perror("cd error");
+		return 1;
+	}
+	printf("Current working directory changed to %s\n", path);
+	return 0;
+}
+
+/*
+ * Built-in command: jobs
+ * Lists all jobs that are currently in the background or stopped.
+ * Usage: jobs [-l]
+ * - With -l, also prints the time elapsed since each job started and its live processes.
+ * If there are no jobs, prints a message indicating so.
+ */
+int builtin_jobs(int argc, char **args, builtin_context *ctx) {
+	if(empty_list(my_job_list)) {
+		printf("There are no jobs in background or stopped\n");
+	} else if (args[1] != NULL && !strcmp(args[1], "-l")) {
+		print_job_list_long(my_job_list);
+	} else {
+		print_job_list(my_job_list); /* Print list of background jobs */
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: fg
+ * Brings a background or stopped job to the foreground.
+ * If a job position is given as an argument (n or %n), uses that; otherwise, defaults to position 1.
+ * - Finds the job in the job list.
+ * - If found, resumes it if stopped, sets terminal control, and waits for it to finish or stop.
+ * - Removes the job from the job list and updates its state.
+ * - Handles signals and terminal control properly.
+ */
+int builtin_fg(int argc, char **args, builtin_context *ctx) {
+	int status;
+	int pos = (args[1] == NULL) ? 1 : atoi(args[1] + (args[1][0] == '%'));
+	job* fg_job = get_item_bypos(my_job_list, pos);
+
+	if(fg_job == NULL) { /* No jobs found */
+		printf("There is no job in position %d\n", pos);
+		return 1;
+
+	} else {
+		int fg_job_pgid = fg_job->pgid;
+		char *fg_job_command = fg_job->command;
+
+		if(fg_job->state == STOPPED) {
+			printf("Resuming job in foreground: [%d] %s\n", pos, fg_job_command);
+		} else {
+			printf("Bringing job to foreground: [%d] %s\n", pos, fg_job_command);
+		}
+
+		give_terminal(fg_job_pgid); /* Set terminal to job's process group */
+		int fg_status = killpg(fg_job_pgid, SIGCONT); /* Continue the job */
+		if(fg_status == -1) { /* It stays in the list as it was */
+			perror("fg error");
+			give_terminal(getpid());
+			return 1;
+		}
+		fg_job->state = FOREGROUND; /* Change state to foreground */
+		fg_job->nstopped = 0; /* SIGCONT resumed all of its processes */
+		remove_job(my_job_list, fg_job); /* Take job out of the job list while it runs */
+
+		wait_job(fg_job, &status); /* Wait for every process of the job */
+		give_terminal(getpid());	 /* Set terminal back to shell */
+		if (WIFSTOPPED(status)) {
+			fg_job->state = STOPPED;
+			list_job(fg_job);
+			printf("Process stopped by signal: %d\n", WSTOPSIG(status));
+		} else if (WIFCONTINUED(status)) {
+			printf("Process continued\n");
+		} else {
+			if (WIFEXITED(status)) {
+				printf("Process completed with exit code: %d\n", WEXITSTATUS(status));
+			} else if (WIFSIGNALED(status)) {
+				printf("Process terminated by signal: %d\n", WTERMSIG(status));
+			}
+		}
+
+		report_job("Foreground", fg_job, status);
+		if (!WIFSTOPPED(status)) {
+			team *fg_team = fg_job->team;
+			if (fg_job->timed) print_job_time(fg_job);
+			memo_job_finished(fg_job_pgid, status); /* A memo job stopped with ^Z */
+			free_job(fg_job);
+			if (fg_team != NULL) team_member_done(fg_team, status);
+		}
+		if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+		return WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+	}
+}
+
+/*
+ * Built-in command: bg
+ * Continues a stopped job in the background.
+ * If a job position is given as an argument (n or %n), uses that; otherwise, defaults to position 1.
+ * - Finds the job in the job list.
+ * - If found, sets its state to BACKGROUND and sends SIGCONT to its process group.
+ * - Handles errors if the job does not exist or cannot be continued.
+ */
+int builtin_bg(int argc, char **args, builtin_context *ctx) {
+	int pos = (args[1] == NULL) ? 1 : atoi(args[1] + (args[1][0] == '%'));
+	job* bg_job = get_item_bypos(my_job_list, pos);
+
+	if(bg_job == NULL) { /* No jobs found */
+		printf("There is no job in position %d\n", pos);
+		return 1;
+
+	} else {
+		bg_job->state = BACKGROUND;
+		int bg_status = killpg(bg_job->pgid, SIGCONT); /* Continue the background job */
+		if(bg_status == -1) {
+			perror("bg error");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: currjob
+ * Prints information about the current (first) job in the job list.
+ * If there are no jobs, prints a message indicating so.
+ */
+int builtin_currjob(int argc, char **args, builtin_context *ctx) {
+	job* current_job = get_item_bypos(my_job_list, 1);
+
+	if (current_job == NULL) { /* No jobs found */
+		printf("No current job\n");
+		return 1;
+
+	} else {
+		printf("Current job: PID=%d command=%s\n", current_job->pgid, current_job->command);
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: deljob
+ * Deletes the current (first) job from the job list if it is running in background.
+ * - If there are no jobs, prints a message indicating so.
+ * - If the current job is stopped (suspended), does not allow deletion and prints a warning.
+ * - If the current job is running in background, deletes it from the job list and prints a confirmation.
+ */
+int builtin_deljob(int argc, char **args, builtin_context *ctx) {
+	job* current_job = get_item_bypos(my_job_list, 1);
+
+	if (current_job == NULL) { /* No jobs found */
+		printf("No current job\n");
+		return 1;
+
+	} else if (current_job->state == STOPPED) { /* The process is suspended */
+		printf("Cannot delete suspended background jobs\n");
+		return 1;
+
+	} else if (current_job->state == BACKGROUND) { /* The process is running in background */
+		printf("Deleting current job from jobs list: PID=%d command=%s\n", current_job->pgid, current_job->command);
+		team *current_team = current_job->team;
+		delete_job(my_job_list, current_job);
+		if (current_team != NULL) team_member_done(current_team, W_EXITCODE(EXIT_FAILURE, 0)); /* No longer followed */
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: zjobs
+ * Lists the child processes of the shell from the child inventory, which reads only the
+ * shell's own children (/proc/self/task/<tid>/children), not every process of the system.
+ * Usage: zjobs [-a]
+ * - Without options, prints the PID of each zombie child process.
+ * - With -a, prints every child (running, sleeping, stopped or zombie) with its state.
+ */
+int builtin_zjobs(int argc, char **args, builtin_context *ctx) {
+	int all = (args[1] != NULL && !strcmp(args[1], "-a"));
+	int count, i;
+	child_info *children = get_children(&count);
+
+	for (i = 0; i < count; i++) {
+		if (all) {
+			printf("%d %c %-10s %s\n", children[i].pid, children[i].state,
+				child_state_name(children[i].state), children[i].comm);
+		} else if (children[i].state == 'Z') {
+			printf("%d\n", children[i].pid);
+		}
+	}
+	free(children);
+	return 0;
+}
+
+/*
+ * Built-in command: bgteam
+ * Launches N background jobs running the specified command.
+ * Usage: bgteam [-j J] [--spread[=core|node]] <N> <command> [args...]
+ * - N: Number of background jobs to launch (must be > 0).
+ * - command: The command to execute in each background job.
+ * - -j J: Keep at most J of them running; the next one starts each time one finishes.
+ *   Throttled teams print only a summary instead of one line per job.
+ * - --spread: Pins each job to its own physical core (or NUMA node with =node), taking
+ *   them round-robin from the sysfs topology; jobs shows the CPUs of each one.
+ * Every job gets its index (1..N) in $BGTEAM_INDEX and in place of "{}" arguments.
+ * When all of them have finished, prints how many succeeded and failed and the wall time.
+ * If arguments are missing or N is not positive, prints an error message.
+ */
+int builtin_bgteam(int argc, char **args, builtin_context *ctx) {
+	int first = 1, limit = 0, spread = -1;
+	while (args[first] != NULL && args[first][0] == '-') {
+		if (!strcmp(args[first], "-j")) {
+			limit = (args[first + 1] == NULL) ? 0 : atoi(args[first + 1]);
+			if (limit <= 0) {
+				printf("bgteam: -j requires a positive number of jobs\n");
+				return 1;
+			}
+			first += 2;
+		} else if (!strcmp(args[first], "--spread") || !strcmp(args[first], "--spread=core")) {
+			spread = SPREAD_CORE;
+			first++;
+		} else if (!strcmp(args[first], "--spread=node")) {
+			spread = SPREAD_NODE;
+			first++;
+		} else {
+			printf("bgteam: unknown option %s\n", args[first]);
+			return 1;
+		}
+	}
+	if (args[first] == NULL || args[first + 1] == NULL) {
+		/* Not enough arguments provided */
+		printf("The bgteam command requires two arguments\n");
+
+	} else if (atoi(args[first]) > 0) {
+		int n = atoi(args[first]); /* Number of jobs to launch */
+		cpu_set_t *slots = NULL;
+		int num_slots = 0;
+		if (spread != -1 && (num_slots = cpu_slots(spread, &slots)) == -1) {
+			perror("bgteam: CPU topology");
+			return 1;
+		}
+		team *new = new_team(&args[first + 1], n, limit ? limit : n, limit > 0);
+		if (new == NULL) {
+			free(slots);
+			return 1;
+		}
+		new->slots = slots;
+		new->num_slots = num_slots;
+		team_launch(new);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Built-in command: fico
+ * Counts the regular files of the current directory, optionally only those whose name
+ * starts with a prefix, and prints "Number of files found: N".
+ * Usage: fico [-r] [-j threads] [prefix]
+ * - -r also counts the files of every subdirectory, walking the tree with a thread pool
+ *   (-j sets its size, one thread per CPU by default).
+ * - The exit status is 0 if some file was found and 1 otherwise (or on errors).
+ * - Runs inside the shell; with & it runs in a forked child, as a background job.
+ */
+int builtin_fico(int argc, char **args, builtin_context *ctx) {
+	if (!ctx->background) return fico(args);
+	pid_t pid = fork_builtin_job("fico");
+	if (pid == 0) exit(fico(args)); /* Background job running the count */
+	return pid > 0 ? 0 : 1;
+}
+
+/**
+ * Makes ^C end a builtin that waits in the event loop (sleep, wait): SIGINT is ignored by the
+ * shell, so in interactive mode it is caught in the signalfd until end_interruptible(). The
+ * standard input leaves the event loop meanwhile, as typed-ahead lines would wake it up.
+ */
+void begin_interruptible(void) {
+	if (interactive) {
+		sigset_t with_sigint = event_signals;
+		sigaddset(&with_sigint, SIGINT);
+		sigprocmask(SIG_BLOCK, &with_sigint, NULL);
+		signal(SIGINT, SIG_DFL);
+		signalfd(signal_fd, &with_sigint, 0);
+	}
+	if (stdin_watched) event_loop_remove(STDIN_FILENO);
+	interrupted = 0;
+}
+
+void end_interruptible(void) {
+	if (stdin_watched) event_loop_add(STDIN_FILENO, input_event, NULL);
+	if (interactive) {
+		sigset_t sigint;
+		sigemptyset(&sigint);
+		sigaddset(&sigint, SIGINT);
+		signalfd(signal_fd, &event_signals, 0);
+		signal(SIGINT, SIG_IGN); /* Also discards a pending one */
+		sigprocmask(SIG_UNBLOCK, &sigint, NULL);
+	}
+}
+
+/**
+ * Timeout of event_loop_wait() for left nanoseconds, rounded up and capped to fit in an int.
+ */
+int wait_timeout_ms(long long left) {
+	return left > 1000000000000LL ? 1000000 : (int) ((left + 999999) / 1000000);
+}
+
+/**
+ * Returns 1 if any job of the list is running in the background.
+ */
+int background_jobs(void) {
+	job *the_job;
+	for (the_job = my_job_list->first; the_job != NULL; the_job = the_job->next) {
+		if (the_job->state == BACKGROUND) return 1;
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: sleep
+ * Waits for the sum of the given times.
+ * Usage: sleep <time>[s|m|h|d] ... (fractions allowed, seconds by default)
+ * - Waits in the event loop, so background jobs keep being reported meanwhile.
+ * - In interactive mode ^C ends it (exit status 130): SIGINT is read from the signalfd while
+ *   it waits, with the standard input out of the event loop.
+ * - With & it runs in a forked child, as a background job.
+ */
+int builtin_sleep(int argc, char **args, builtin_context *ctx) {
+	long long total_ns = 0, deadline;
+	int i;
+
+	if (argc < 2) {
+		printf("Usage: sleep <time>[s|m|h|d] ...\n");
+		return 1;
+	}
+	for (i = 1; i < argc; i++) {
+		char *end;
+		double value = strtod(args[i], &end);
+		double unit = 1;
+		if (*end == 'm') unit = 60;
+		else if (*end == 'h') unit = 3600;
+		else if (*end == 'd') unit = 86400;
+		if (end == args[i] || value < 0 || (*end && (strchr("smhd", *end) == NULL || end[1]))) {
+			printf("sleep: invalid time interval '%s'\n", args[i]);
+			return 1;
+		}
+		total_ns += (long long) (value * unit * 1e9);
+	}
+
+	if (ctx->background) {
+		pid_t pid = fork_builtin_job("sleep");
+		if (pid == 0) {
+			struct timespec ts = { total_ns / 1000000000LL, total_ns % 1000000000LL };
+			nanosleep(&ts, NULL);
+			exit(EXIT_SUCCESS);
+		}
+		return pid > 0 ? 0 : 1;
+	}
+
+	begin_interruptible();
+	deadline = monotonic_ns() + total_ns;
+	while (!interrupted) {
+		long long left = deadline - monotonic_ns();
+		if (left <= 0) break;
+		event_loop_wait(wait_timeout_ms(left));
+	}
+	end_interruptible();
+
+	if (interrupted) {
+		printf("\n");
+		return 128 + SIGINT;
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: wait
+ * Waits for background jobs without taking the terminal, joining many of them at once.
+ * Usage: wait [-n] [-t seconds] [%n | pid ...]
+ * - Without jobs, waits until no job runs in the background and every bgteam has finished.
+ * - -n: Returns as soon as the first of them finishes, with its exit status (127 at once if
+ *   nothing runs in the background).
+ * - -t seconds: Gives up after the timeout (fractions allowed), with exit status 124.
+ * Otherwise returns the exit status of the last job listed (0 without jobs, 127 if it does not
+ * exist). The jobs are followed through their pidfds in the event loop, so any number of them
+ * is waited in a single epoll_wait() and finished jobs keep being reported meanwhile.
+ * In interactive mode ^C ends it (exit status 130), as in sleep.
+ */
+int builtin_wait(int argc, char **args, builtin_context *ctx) {
+	int any = 0, result = 0, i = 1, n = 0, listed = 0;
+	long long deadline = -1;
+
+	for (; args[i] != NULL && args[i][0] == '-'; i++) {
+		if (!strcmp(args[i], "-n")) {
+			any = 1;
+		} else if (!strcmp(args[i], "-t") && args[i + 1] != NULL) {
+			char *end;
+			double seconds = strtod(args[++i], &end);
+			if (end == args[i] || *end || seconds < 0) {
+				printf("wait: invalid timeout '%s'\n", args[i]);
+				return 1;
+			}
+			deadline = monotonic_ns() + (long long) (seconds * 1e9);
+		} else {
+			printf("Usage: wait [-n] [-t seconds] [%%n | pid ...]\n");
+			return 1;
+		}
+	}
+	if (ctx->background) {
+		printf("wait: cannot run in the background\n");
+		return 1;
+	}
+
+	waited_job *targets = arena_new(&command_arena, waited_job, argc - i + 1);
+	for (; args[i] != NULL; i++) {
+		job *the_job = (args[i][0] == '%') ? get_item_bypos(my_job_list, atoi(args[i] + 1))
+			: get_item_bypid(my_job_list, atoi(args[i]));
+		listed++;
+		if (the_job == NULL) {
+			printf("wait: no such job: %s\n", args[i]);
+			result = 127;
+			continue;
+		}
+		targets[n].pgid = the_job->pgid;
+		targets[n].status = -1;
+		n++;
+		result = -1; /* Status of the last job listed */
+	}
+	if (listed > 0 && n == 0) return result; /* Nothing to wait for */
+
+	waited_jobs = targets;
+	first_finished_status = -1;
+	num_waited = waited_left = n;
+	begin_interruptible();
+	while (!interrupted) {
+		update_jobs();
+		if (n > 0 && (any ? waited_left < n : waited_left == 0)) break;
+		if (n == 0 && any && first_finished_status != -1) break;
+		if (n == 0 && any && active_teams == 0 && !background_jobs()) break; /* Nothing left to finish */
+		if (n == 0 && !any && active_teams == 0 && !background_jobs()) break;
+		long long left = (deadline < 0) ? -1 : deadline - monotonic_ns();
+		if (deadline >= 0 && left <= 0) break;
+		event_loop_wait(deadline < 0 ? -1 : wait_timeout_ms(left));
+	}
+	end_interruptible();
+	waited_jobs = NULL;
+	num_waited = 0;
+
+	if (interrupted) {
+		printf("\n");
+		return 128 + SIGINT;
+	}
+	if (n > 0 && (any ? waited_left == n : waited_left > 0)) return 124; /* Timed out */
+	if (n == 0 && any) {
+		if (first_finished_status != -1) return exit_code(first_finished_status);
+		return (active_teams == 0 && !background_jobs()) ? 127 : 124;
+	}
+	if (n == 0) return (active_teams == 0 && !background_jobs()) ? 0 : 124;
+	if (any) return exit_code(first_waited_status);
+	return result == -1 ? exit_code(targets[n - 1].status) : result;
+}
+
+/*
+ * Built-in command: joblog
+ * Captured output of background jobs.
+ * Usage: joblog on [KB] | joblog off | joblog | joblog [-f] <%n | pid>
+ * - on: From now on every background job (commands, pipelines, bgteam members and builtins
+ *   with &) writes its stdout and stderr to its own pipe instead of the terminal. The shell
+ *   drains the pipes from the event loop and keeps the last KB kilobytes of each job (16 by
+ *   default), also after the job ends, for the last 128 finished jobs.
+ * - off: New background jobs write to the terminal again.
+ * - Without arguments, lists the logs: pid, bytes written, state and command.
+ * - %n | pid: Prints the output kept of job n of the list or of the job with that pid, which
+ *   may have finished already. Bytes older than the last KB are gone.
+ * - -f: Then follows the output as it arrives, until the job closes it or ^C.
+ */
+int builtin_joblog(int argc, char **args, builtin_context *ctx) {
+	job_output *out;
+	unsigned long long pos = 0;
+	int follow = 0, i = 1;
+
+	if (args[1] == NULL) {
+		printf("Output capture: %s\n", capture_size ? "on" : "off");
+		for (out = job_outputs(); out != NULL; out = out->next) {
+			printf("pid: %d, bytes: %llu, state: %s, command: %s\n", out->pgid, out->written,
+				out->fd != -1 ? "open" : "closed", out->command);
+		}
+		return 0;
+	}
+	if (!strcmp(args[1], "on")) {
+		long kb = (args[2] == NULL) ? JOB_OUTPUT_DEFAULT_SIZE / 1024 : atol(args[2]);
+		if (kb <= 0) {
+			printf("joblog: invalid size: %s\n", args[2]);
+			return 1;
+		}
+		capture_size = (size_t) kb * 1024;
+		return 0;
+	}
+	if (!strcmp(args[1], "off")) {
+		capture_size = 0;
+		return 0;
+	}
+	if (!strcmp(args[1], "-f")) {
+		follow = 1;
+		i = 2;
+	}
+	if (args[i] == NULL) {
+		printf("Usage: joblog on [KB] | joblog off | joblog | joblog [-f] <%%n | pid>\n");
+		return 1;
+	}
+	if (args[i][0] == '%') {
+		job *the_job = get_item_bypos(my_job_list, atoi(args[i] + 1));
+		out = (the_job != NULL) ? find_job_output(the_job->pgid) : NULL;
+	} else {
+		out = find_job_output(atoi(args[i]));
+	}
+	if (out == NULL) {
+		printf("joblog: no output captured for %s\n", args[i]);
+		return 1;
+	}
+
+	fflush(stdout);
+	if (copy_job_output(out, &pos, ctx->fd_out) == -1) return 1;
+	if (!follow || out->fd == -1) return 0;
+
+	begin_interruptible();
+	while (!interrupted && out->fd != -1) {
+		event_loop_wait(-1); /* The log is drained by its own handler */
+		if (copy_job_output(out, &pos, ctx->fd_out) == -1) break;
+	}
+	end_interruptible();
+	if (interrupted) {
+		printf("\n");
+		return 128 + SIGINT;
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: mask
+ * Allows running a command with certain signals blocked (masked).
+ * Usage: mask <signal1> <signal2> ... -c <command> [args...]
+ * - The user specifies one or more signal numbers to block, followed by "-c" and the command to run.
+ * - The specified signals are blocked in the child process before executing the command.
+ * - If run in the foreground, waits for the command to finish or stop, and prints its status.
+ * - If run in the background (with &), adds the job to the background job list.
+ * - Handles syntax errors, job control, and terminal signals.
+ */
+int builtin_mask(int argc, char **args, builtin_context *ctx) {
+	spawn_request req;		/* Description of the command to launch */
+	pid_t pid_fork;			/* PID of the created process */
+	sigset_t child_mask;	/* Signals to block in the child */
+	int syntax_error = 0;	/* Flag for syntax error */
+
+	/* Parse signal numbers until "-c" is found */
+	sigemptyset(&child_mask);
+	int i = 1;
+	while (args[i] != NULL && strcmp(args[i], "-c")) {
+		int signal = atoi(args[i]);
+		if (signal <= 0) { /* Signal numbers must be positive */
+			printf("mask: error de sintaxis\n");
+			syntax_error = 1;
+		} else {
+			sigaddset(&child_mask, signal);
+		}
+		++i;
+	}
+
+	/* Check for syntax errors: missing "-c" or command after "-c" */
+	if ((args [i] == NULL || args[i + 1] == NULL) && syntax_error == 0) {
+		printf("mask: error de sintaxis\n");
+		syntax_error = 1;
+
+	} else if (syntax_error == 0) {
+		char **new_args = &args[i + 1]; /* Command and its arguments after "-c" */
+
+		init_request(&req, new_args, ctx->background);
+		req.mask = &child_mask;
+		req.redirections = job_redirections; /* With &, after the capture */
+		req.num_redirections = num_job_redirections;
+		job_output *out = ctx->background ? capture_output() : NULL;
+		if (out != NULL) req.fd_out = req.fd_err = out->write_fd;
+		pid_fork = spawn_command(&req); /* Create child process */
+		if (out != NULL) start_job_output(out, pid_fork, new_args[0]);
+
+		job *the_job = (pid_fork > 0) ? launched_job(pid_fork, new_args[0], ctx->background) : NULL;
+		if(the_job != NULL) { /* We are in the shell */
+			place_job(the_job, ctx->background);
+			return ctx->background ? 0 : last_exit_status; /* Set by wait_foreground() */
+		}
+	}
+	return 1;
+}
+
+/*
+ * Built-in command: pin
+ * Runs a command on a set of CPUs, or moves a running job to one.
+ * Usage: pin <cpus> <command> [args...] | pin -p <cpus> <%n | pgid> | pin
+ * - cpus: CPU list as taskset takes it, e.g. 0-3,8. Only CPUs the shell may use count.
+ * - pin -p: Re-pins every thread of every process in the job's process group, the ones
+ *   its processes started included.
+ * - Without arguments, prints the CPUs of the shell and how many cores and nodes they span.
+ * jobs shows the CPUs of each pinned job.
+ */
+int builtin_pin(int argc, char **args, builtin_context *ctx) {
+	cpu_set_t cpus;
+	char label[JOB_CPUS_LEN];
+
+	if (args[1] == NULL) {
+		cpu_set_t *slots;
+		char list[256];
+		int cores, nodes;
+		if (sched_getaffinity(0, sizeof(cpus), &cpus) == -1) {
+			perror("pin");
+			return 1;
+		}
+		format_cpu_list(&cpus, list, sizeof(list));
+		cores = cpu_slots(SPREAD_CORE, &slots);
+		if (cores != -1) free(slots);
+		nodes = cpu_slots(SPREAD_NODE, &slots);
+		if (nodes != -1) free(slots);
+		printf("cpus: %s (%d cpus, %d cores, %d nodes)\n", list, CPU_COUNT(&cpus), cores, nodes);
+		return 0;
+	}
+
+	int repin = !strcmp(args[1], "-p");
+	char *list = args[repin ? 2 : 1];
+	if (list == NULL || args[repin ? 3 : 2] == NULL) {
+		printf("Usage: pin <cpus> <command> [args...] | pin -p <cpus> <%%n | pgid>\n");
+		return 1;
+	}
+	if (parse_cpu_list(list, &cpus) == -1) {
+		printf("pin: invalid CPU list: %s\n", list);
+		return 1;
+	}
+	format_cpu_list(&cpus, label, sizeof(label));
+
+	if (repin) {
+		char *target = args[3];
+		job *the_job = (target[0] == '%') ? get_item_bypos(my_job_list, atoi(target + 1))
+			: get_item_bypid(my_job_list, atoi(target));
+		pid_t pgid = (the_job != NULL) ? the_job->pgid : atoi(target);
+		int moved;
+		if (pgid <= 0) {
+			printf("pin: no such job: %s\n", target);
+			return 1;
+		}
+		moved = pin_process_group(pgid, &cpus);
+		if (moved <= 0) {
+			if (moved == -1) perror("pin");
+			else printf("pin: no processes in group %d\n", pgid);
+			return 1;
+		}
+		if (the_job != NULL) strcpy(the_job->cpus, label);
+		printf("pin: %d threads of group %d moved to cpus %s\n", moved, pgid, label);
+		return 0;
+	}
+
+	spawn_request req;
+	pid_t pid;
+	init_request(&req, &args[2], ctx->background);
+	req.cpus = &cpus;
+	req.redirections = job_redirections; /* With &, after the capture */
+	req.num_redirections = num_job_redirections;
+	job_output *out = ctx->background ? capture_output() : NULL;
+	if (out != NULL) req.fd_out = req.fd_err = out->write_fd;
+	pid = spawn_command(&req);
+	if (out != NULL) start_job_output(out, pid, args[2]);
+	job *the_job = (pid > 0) ? launched_job(pid, args[2], ctx->background) : NULL;
+	if (the_job != NULL) {
+		strcpy(the_job->cpus, label);
+		place_job(the_job, ctx->background);
+		return ctx->background ? 0 : last_exit_status; /* Set by wait_foreground() */
+	}
+	return 1;
+}
+
+/*
+ * Built-in command: spawnmode
+ * Shows or selects the backend used to launch external commands.
+ * Usage: spawnmode [fork|vfork|posix_spawn|zygote] | spawnmode -r
+ * - Without arguments, prints the current backend and the launch statistics of every
+ *   backend used (number of launches, average/min/max latency and launches per second),
+ *   so the backends can be compared on the same commands.
+ * - With a backend, switches to it. zygote starts the helper process that forks for the
+ *   shell; it is stopped when another backend is selected.
+ * - -r resets the statistics.
+ */
+int builtin_spawnmode(int argc, char **args, builtin_context *ctx) {
+	enum spawn_backend backend;
+	int b;
+	if (args[1] == NULL) {
+		printf("Spawn backend: %s\n", spawn_backend_name(get_spawn_backend()));
+		for (b = 0; b < SPAWN_BACKENDS; b++) {
+			const spawn_stats *st = get_spawn_stats((enum spawn_backend) b);
+			if (st->launches == 0 && st->failures == 0 && b != get_spawn_backend()) continue;
+			printf("%-12s launches: %lu, failures: %lu", spawn_backend_name((enum spawn_backend) b),
+				st->launches, st->failures);
+			if (st->launches > 0) {
+				double avg_us = st->total_ns / 1000.0 / st->launches;
+				printf(", latency avg: %.1f us, min: %.1f us, max: %.1f us, launches/s: %.0f",
+					avg_us, st->min_ns / 1000.0, st->max_ns / 1000.0, 1e6 / avg_us);
+			}
+			printf("\n");
+		}
+	} else if (!strcmp(args[1], "-r")) {
+		reset_spawn_stats();
+	} else if (parse_spawn_backend(args[1], &backend)) {
+		if (set_spawn_backend(backend) == -1) {
+			perror("spawnmode: zygote");
+			return 1;
+		}
+		printf("Spawn backend set to %s\n", spawn_backend_name(backend));
+	} else {
+		printf("spawnmode: unknown backend %s (use fork, vfork, posix_spawn or zygote)\n", args[1]);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: trace
+ * Shows the job lifecycle trace: fork, setpgid, tcsetpgrp, exec, stop, continue, exit and
+ * reap events with their time, process and process group.
+ * Usage: trace [N] | trace -c | trace -o <file> | trace -o -
+ * - Without arguments prints every record kept, N prints the last N.
+ * - -c clears the trace.
+ * - -o mirrors the ring to a file mapped in memory, readable by other programs while the
+ *   shell runs; "-o -" goes back to private memory.
+ */
+int builtin_trace(int argc, char **args, builtin_context *ctx) {
+	if (args[1] == NULL) {
+		trace_dump(0);
+	} else if (!strcmp(args[1], "-c")) {
+		trace_clear();
+	} else if (!strcmp(args[1], "-o")) {
+		if (args[2] == NULL) {
+			printf("trace: -o requires a file name or -\n");
+		} else if (trace_mirror(strcmp(args[2], "-") ? args[2] : NULL) == -1) {
+			perror("trace error");
+			return 1;
+		}
+	} else if (atoi(args[1]) > 0) {
+		trace_dump(atoi(args[1]));
+	} else {
+		printf("Usage: trace [N] | trace -c | trace -o <file> | trace -o -\n");
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: memstats
+ * Prints the calls made to the C allocator since the shell started and the size of the
+ * command arena. Running it twice around a batch of commands shows whether the command
+ * loop allocates memory once it has warmed up.
+ */
+int builtin_memstats(int argc, char **args, builtin_context *ctx) {
+	const alloc_stats *st = get_alloc_stats();
+	printf("malloc: %lu, realloc: %lu, free: %lu, command arena: %zu bytes\n",
+		st->mallocs, st->reallocs, st->frees, command_arena.capacity);
+	return 0;
+}
+
+/*
+ * Built-in command: hash
+ * Inspects or updates the cache of programs found in PATH.
+ * Usage: hash [-r] [-d name] [name ...]
+ * - Without arguments, lists the cached programs and how many launches used them.
+ * - -r empties the cache, -d forgets one command.
+ * - Names are searched in PATH and cached without running them.
+ * The cache is also flushed on its own when PATH or one of its directories changes.
+ */
+int builtin_hash(int argc, char **args, builtin_context *ctx) {
+	int i = 1, result = 0;
+	if (args[1] == NULL) print_path_cache();
+	while (args[i] != NULL) {
+		if (!strcmp(args[i], "-r")) {
+			clear_path_cache();
+		} else if (!strcmp(args[i], "-d")) {
+			if (args[++i] == NULL) {
+				printf("hash: -d requires a command name\n");
+				return 1;
+			}
+			forget_command(args[i]);
+		} else if (hash_command(args[i]) == NULL) {
+			printf("hash: %s: not found\n", args[i]);
+			result = 1;
+		}
+		++i;
+	}
+	return result;
+}
+
+/*
+ * Built-in command: history
+ * Shows the persistent history, shared by every shell using the same file ($HISTFILE, by default
+ * ~/.jcshell_history). Interactive shells add each command line they read to it.
+ * Usage: history [N] | history -s <text...>
+ * - Prints the last N entries with their numbers, all of them by default.
+ * - -s: Prints the entries containing the text (the words joined by spaces), oldest first, as
+ *   history | grep would, looking only at the entries of the text's rarest trigram.
+ * The file is mapped and indexed on first use, afterwards only the lines added since are.
+ */
+int builtin_history(int argc, char **args, builtin_context *ctx) {
+	const char *entry;
+	size_t length;
+	long n, first = 1, count;
+
+	if (args[1] != NULL && !strcmp(args[1], "-s")) {
+		long *found = NULL, num_found = 0, size = 0;
+		char *text, *end;
+		size_t text_len = 0;
+		int i;
+		if (args[2] == NULL) {
+			printf("Usage: history [N] | history -s <text...>\n");
+			return 1;
+		}
+		for (i = 2; args[i] != NULL; i++) text_len += strlen(args[i]) + 1;
+		text = arena_new(&command_arena, char, text_len);
+		if (text == NULL) return 1;
+		end = text;
+		for (i = 2; args[i] != NULL; i++) end = stpcpy(stpcpy(end, i > 2 ? " " : ""), args[i]);
+
+		for (n = history_search(text, 0); n > 0; n = history_search(text, n)) {
+			if (num_found == size) {
+				long *aux = (long *) realloc(found, (size ? size * 2 : 64) * sizeof(long));
+				if (aux == NULL) break;
+				found = aux;
+				size = size ? size * 2 : 64;
+			}
+			found[num_found++] = n;
+		}
+		while (num_found-- > 0) {
+			entry = history_entry(found[num_found], &length);
+			printf("%6ld  %.*s\n", found[num_found], (int) length, entry);
+		}
+		free(found);
+		return 0;
+	}
+
+	count = history_count();
+	if (args[1] != NULL) {
+		long last = atol(args[1]);
+		if (last <= 0) {
+			printf("Usage: history [N] | history -s <text...>\n");
+			return 1;
+		}
+		if (last < count) first = count - last + 1;
+	}
+	for (n = first; n <= count; n++) {
+		entry = history_entry(n, &length);
+		printf("%6ld  %.*s\n", n, (int) length, entry);
+	}
+	return 0;
+}
+
+/*
+ * Built-in command: enable
+ * Lists, loads, disables or enables builtins.
+ * Usage: enable [-n | -d] [name ...] | enable -f <library.so> <name> [name ...]
+ * - Without arguments, lists every builtin with its usage (and library, if loaded).
+ * - -f loads each name from the library, which exports a builtin_definition called
+ *   <name>_builtin (see builtin_registry.h). It replaces a builtin with the same name.
+ * - -n disables the names, so they run as external commands; without options they are
+ *   enabled again. -d unloads builtins loaded with -f, and a shell builtin one of them had
+ *   replaced comes back.
+ */
+int builtin_enable(int argc, char **args, builtin_context *ctx) {
+	int i = 1, result = 0;
+	char *library = NULL, option = 0;
+
+	if (args[1] == NULL) {
+		print_builtins();
+		return 0;
+	}
+	if (!strcmp(args[1], "-f")) {
+		library = args[2];
+		i = 3;
+	} else if (!strcmp(args[1], "-n") || !strcmp(args[1], "-d")) {
+		option = args[1][1];
+		i = 2;
+	}
+	if (args[i] == NULL || (i == 3 && library == NULL)) {
+		printf("Usage: enable [-n | -d] [name ...] | enable -f <library.so> <name> [name ...]\n");
+		return 1;
+	}
+	for (; args[i] != NULL; i++) {
+		if (library != NULL) {
+			if (load_builtin(library, args[i]) == -1) result = 1;
+			else add_command_name(args[i]); /* For completion */
+		} else if (option == 'd') {
+			if (remove_builtin(args[i]) == -1) {
+				printf("enable: %s: not loaded from a library\n", args[i]);
+				result = 1;
+			}
+		} else if (enable_builtin(args[i], option != 'n') == -1) {
+			printf("enable: %s: not a builtin\n", args[i]);
+			result = 1;
+		}
+	}
+	return result;
+}
+
+/*
+ * Built-in command: memo
+ * Runs a command once and afterwards replays its output and exit status without launching
+ * anything, while nothing it depends on has changed.
+ * Usage: memo [--dep file]... [--env NAME]... <command> [args...] | memo -s | memo -c |
+ *        memo -l <MB> <hours>
+ * - The key is the command's arguments, the working directory, the program (its path, size and
+ *   mtime), PATH, LANG, LC_ALL and every --env variable, and the size and contents of the
+ *   regular file on its stdin (< file) and of every --dep file. Without < the command reads
+ *   /dev/null, not the terminal. A command reading a pipe, the terminal or a device other
+ *   than /dev/null (given with <) runs without the cache.
+ * - Only stdout and the exit status are kept; a command killed by a signal is not stored.
+ * - Entries live in $JCSHELL_MEMO, or ~/.cache/jcshell/memo, shared by every shell.
+ * - -s: Hits, misses and run time saved since the shell started, and the size of the cache.
+ * - -c: Removes every entry. -l: Sets the maximum size (64 MB) and age (168 hours) and evicts.
+ */
+int builtin_memo(int argc, char **args, builtin_context *ctx) {
+	static const char *key_vars[] = { "PATH", "LANG", "LC_ALL" };
+	char cwd[PATH_MAX];
+	const char *program;
+	const builtin_definition *def;
+	memo_key key;
+	memo_recording *rec = NULL;
+	spawn_request req;
+	struct stat st;
+	int i = 1, status, cached, saved_in = -1, input, null_fd = -1;
+	pid_t pid;
+
+	if (args[1] != NULL && !strcmp(args[1], "-s")) {
+		const memo_stats *ms = memo_statistics();
+		const char *dir;
+		long entries;
+		long long bytes;
+		if (memo_usage(&dir, &entries, &bytes) == -1) printf("Memo cache: off\n");
+		else printf("Memo cache: %s, %ld entries, %lld KB (max %lld MB, %ld h)\n", dir, entries,
+			bytes / 1024, ms->max_size >> 20, ms->max_age / 3600);
+		printf("hits: %lu, misses: %lu, uncached: %lu, stored: %lu, evicted: %lu\n",
+			ms->hits, ms->misses, ms->uncached, ms->stored, ms->evicted);
+		printf("replayed: %llu bytes, run time saved: %.3f s\n", ms->replayed, ms->saved_ns / 1e9);
+		return 0;
+	}
+	if (args[1] != NULL && !strcmp(args[1], "-c")) {
+		int removed = memo_clear();
+		if (removed == -1) printf("memo: the cache is off\n");
+		else printf("memo: %d entries removed\n", removed);
+		return removed == -1;
+	}
+	if (args[1] != NULL && !strcmp(args[1], "-l")) {
+		long long size = args[2] ? atoll(args[2]) : 0;
+		long hours = args[2] && args[3] ? atol(args[3]) : 0;
+		if (size <= 0 || hours <= 0) {
+			printf("Usage: memo -l <MB> <hours>\n");
+			return 1;
+		}
+		memo_limits(size << 20, hours * 3600);
+		return 0;
+	}
+
+	memo_key_init(&key);
+	for (; args[i] != NULL && (!strcmp(args[i], "--dep") || !strcmp(args[i], "--env")); i += 2) {
+		if (args[i + 1] == NULL) break;
+		memo_key_string(&key, args[i + 1]);
+		if (args[i][2] == 'e') {
+			memo_key_string(&key, getenv(args[i + 1]));
+		} else {
+			int fd = open(args[i + 1], O_RDONLY | O_CLOEXEC);
+			if (fd == -1 || memo_key_file(&key, fd) == -1) {
+				perror(args[i + 1]);
+				if (fd != -1) close(fd);
+				return 1;
+			}
+			close(fd);
+		}
+	}
+	if (args[i] == NULL) {
+		printf("Usage: memo [--dep file]... [--env NAME]... <command> [args...] | memo -s | memo -c | memo -l <MB> <hours>\n");
+		return 1;
+	}
+	args += i;
+	argc -= i;
+	if (!strcmp(args[0], "memo")) {
+		printf("memo: memo cannot run itself\n");
+		return 1;
+	}
+
+	/* Its input is the "< file" given, otherwise /dev/null: the terminal cannot be keyed */
+	if (stdin_redirected) {
+		input = ctx->fd_in;
+	} else if ((input = null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC)) == -1) {
+		perror("/dev/null");
+		return 1;
+	}
+
+	/* What the command sees: where it runs, the program and its environment, and its input */
+	def = find_builtin(args[0]);
+	program = def != NULL ? "builtin" : strchr(args[0], '/') ? args[0] : hash_command(args[0]);
+	cached = program != NULL && getcwd(cwd, sizeof(cwd)) != NULL && memo_key_file(&key, input) != -1;
+	if (cached) {
+		memo_key_string(&key, cwd);
+		memo_key_string(&key, program);
+		if (def == NULL) {
+			cached = stat(program, &st) == 0;
+			memo_key_add(&key, &st.st_size, sizeof(st.st_size));
+			memo_key_add(&key, &st.st_mtim, sizeof(st.st_mtim));
+		}
+		for (i = 0; i < 3; i++) memo_key_string(&key, getenv(key_vars[i]));
+		for (i = 0; i < argc; i++) memo_key_string(&key, args[i]);
+	}
+	if (!cached) {
+		memo_uncached();
+	} else if (memo_replay(&key, ctx->fd_out, &status)) {
+		if (null_fd != -1) close(null_fd);
+		return status;
+	} else {
+		rec = memo_record(&key, ctx->fd_out, def == NULL);
+	}
+
+	if (def != NULL) { /* Run here, with stdout on the entry */
+		builtin_context inner = *ctx;
+		int saved = -1;
+		fflush(stdout);
+		if (rec != NULL && (saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10)) == -1) {
+			memo_record_done(rec, -1);
+			rec = NULL;
+		}
+		if (rec != NULL) dup2(memo_record_fd(rec), STDOUT_FILENO);
+		inner.background = 0;
+		inner.fd_in = input;
+		status = def->function(argc, args, &inner);
+		fflush(stdout);
+		if (rec != NULL) {
+			dup2(saved, STDOUT_FILENO);
+			close(saved);
+			memo_record_done(rec, status);
+		}
+		if (null_fd != -1) close(null_fd);
+		return status;
+	}
+
+	init_request(&req, args, ctx->background);
+	if (rec != NULL) req.fd_out = memo_record_fd(rec);
+	if (null_fd != -1) req.fd_in = null_fd;
+	if (interactive && !ctx->background && stdin_redirected) {
+		/* "< file" is on the shell's stdin: it goes to the command, and the terminal back to
+		   stdin while it runs, which is where the job takes it from */
+		int tty = open("/dev/tty", O_RDWR | O_CLOEXEC);
+		if (tty != -1 && (saved_in = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10)) != -1) {
+			dup2(tty, STDIN_FILENO);
+			req.fd_in = saved_in;
+		}
+		if (tty != -1) close(tty);
+	}
+	pid = spawn_command(&req);
+	memo_record_started(rec, pid);
+
+	status = 1;
+	job *the_job = (pid > 0) ? launched_job(pid, args[0], ctx->background) : NULL;
+	if (pid > 0 && the_job == NULL) {
+		memo_job_finished(pid, SIGKILL); /* Killed: nothing is stored */
+	} else if (the_job != NULL) {
+		if (ctx->background) {
+			place_job(the_job, 1); /* Stored by job_finished() */
+			status = 0;
+		} else {
+			watch_job(the_job);
+			wait_foreground(the_job); /* Stored when it finishes, also after a ^Z and fg */
+			status = last_exit_status;
+		}
+	}
+	if (saved_in != -1) {
+		dup2(saved_in, STDIN_FILENO);
+		close(saved_in);
+	}
+	if (null_fd != -1) close(null_fd);
+	return status;
+}
+
+/**
+ * Job table access of builtin_context: the number of jobs and a copy of the job at a position.
+ */
+int shell_job_count(void) {
+	return my_job_list->count;
+}
+
+int shell_get_job(int pos, builtin_job *out) {
+	job *the_job = get_item_bypos(my_job_list, pos);
+	if (the_job == NULL) return 0;
+	out->pgid = the_job->pgid;
+	out->state = the_job->state;
+	out->nprocs = the_job->nprocs;
+	out->command = the_job->command;
+	out->start_ns = the_job->start_ns;
+	return 1;
+}
+
+/**
+ * Registers the shell's own builtins, after the native utilities (utility_builtins.c).
+ */
+void register_shell_builtins(void) {
+	register_utility_builtins();
+	register_builtin("sleep", builtin_sleep, "sleep <time>[s|m|h|d] ...");
+	register_builtin("wait", builtin_wait, "wait [-n] [-t seconds] [%n | pid ...]");
+	register_builtin("joblog", builtin_joblog, "joblog on [KB] | joblog off | joblog | joblog [-f] <%n | pid>");
+	register_builtin("exit", builtin_exit, "exit");
+	register_builtin("cd", builtin_cd, "cd [dir]");
+	register_builtin("jobs", builtin_jobs, "jobs [-l]");
+	register_builtin("fg", builtin_fg, "fg [n | %n]");
+	register_builtin("bg", builtin_bg, "bg [n | %n]");
+	register_builtin("currjob", builtin_currjob, "currjob");
+	register_builtin("deljob", builtin_deljob, "deljob");
+	register_builtin("zjobs", builtin_zjobs, "zjobs [-a]");
+	register_builtin("bgteam", builtin_bgteam, "bgteam [-j J] [--spread[=core|node]] <N> <command> [args...]");
+	register_builtin("fico", builtin_fico, "fico [-r] [-j threads] [prefix]");
+	register_builtin("mask", builtin_mask, "mask <signal1> <signal2> ... -c <command> [args...]");
+	register_builtin("pin", builtin_pin, "pin <cpus> <command> [args...] | pin -p <cpus> <%n | pgid> | pin");
+	register_builtin("spawnmode", builtin_spawnmode, "spawnmode [fork|vfork|posix_spawn|zygote] | spawnmode -r");
+	register_builtin("trace", builtin_trace, "trace [N] | trace -c | trace -o <file> | trace -o -");
+	register_builtin("memstats", builtin_memstats, "memstats");
+	register_builtin("hash", builtin_hash, "hash [-r] [-d name] [name ...]");
+	register_builtin("history", builtin_history, "history [N] | history -s <text...>");
+	register_builtin("enable", builtin_enable, "enable [-n | -d] [name ...] | enable -f <library.so> <name> [name ...]");
+	register_builtin("memo", builtin_memo, "memo [--dep file]... [--env NAME]... <command> [args...] | memo -s | memo -c | memo -l <MB> <hours>");
+}
+
+/**
+ * Returns 1 if the builtin, run with &, starts a job of its own for the command.
+ */
+int starts_job(const builtin_definition *def, char **args) {
+	if (def->function == builtin_pin) return args[1] != NULL && strcmp(args[1], "-p") != 0;
+	return is_utility_builtin(def) || def->function == builtin_fico || def->function == builtin_sleep
+		|| def->function == builtin_mask;
+}
+
+/**
+ * Runs a builtin in the shell and returns its exit status. The native utilities launched with &
+ * run in a background job instead, like any other command.
+ * Its redirections are applied to the shell's own descriptors, which are saved above 10 and
+ * put back afterwards, so every builtin (the shell's own print with printf) honours them.
+ * A builtin that starts a job with & leaves them to the job instead (job_redirections), applied
+ * after its output capture, so neither the shell's messages nor the capture pipe end up in them.
+ */
+int run_builtin(const builtin_definition *def, char **args, int background,
+		const redirection *redirections, int num_redirections) {
+	builtin_context ctx = { BUILTIN_ABI_VERSION, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO,
+		background, shell_job_count, shell_get_job };
+	int *saved = arena_new(&command_arena, int, num_redirections + 1);
+	int argc = 0, result = 1, failed, i, j;
+
+	while (args[argc] != NULL) argc++;
+	if (saved == NULL) {
+		perror("Redirection error");
+		return 1;
+	}
+	for (i = 0; i < num_redirections; i++) {
+		if (redirections[i].fd == STDIN_FILENO) stdin_redirected = 1;
+	}
+	if (background && starts_job(def, args)) {
+		job_redirections = redirections;
+		num_job_redirections = num_redirections;
+		num_redirections = 0;
+	}
+
+	fflush(stdout);
+	for (i = 0; i < num_redirections; i++) {
+		for (j = 0; j < i && redirections[j].fd != redirections[i].fd; j++);
+		/* -2: already saved by an earlier redirection, -1: it was not open */
+		saved[i] = j < i ? -2 : fcntl(redirections[i].fd, F_DUPFD_CLOEXEC, 10);
+	}
+	if (apply_redirections(redirections, num_redirections, &failed) == -1) {
+		perror(redirections[failed].file ? redirections[failed].file : "Redirection error");
+	} else if (background && is_utility_builtin(def)) {
+		pid_t pid = fork_builtin_job(args[0]); /* The utilities do not handle & themselves */
+		if (pid == 0) exit(def->function(argc, args, &ctx));
+		result = pid > 0 ? 0 : 1;
+	} else {
+		result = def->function(argc, args, &ctx);
+	}
+	job_redirections = NULL;
+	num_job_redirections = 0;
+	stdin_redirected = 0;
+
+	fflush(stdout);
+	for (i = num_redirections - 1; i >= 0; i--) {
+		if (saved[i] == -2) continue;
+		if (saved[i] == -1) {
+			close(redirections[i].fd);
+		} else {
+			dup2(saved[i], redirections[i].fd);
+			close(saved[i]);
+		}
+	}
+	return result;
+}
+
+/**
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+ {
+	command_reader reader;      /* Buffered input: terminal, script, pipe or -c text */
+	int background;             /* Equals 1 if a command is followed by '&' */
+	char **args;                /* Arguments of the command line, NULL terminated */
+	char ***stages;             /* Commands of a pipeline, slices of args */
+	int num_stages;             /* Number of commands in the pipeline */
+	redirection *redirections;  /* Redirections of the command line, in order */
+	int num_redirections;
+
+	const builtin_definition *builtin; /* Builtin called by the command, NULL if external */
+	int script_fd = -1;         /* Script given as argument */
+	compiled_script *script = NULL; /* Its compiled form, NULL to parse every line */
+	compiled_command command;   /* Command of the compiled script */
+
+	/* Probably useful variables: */
+	int timed;					/* 1 if the command is run by the time builtin */
+	long long time_start;		/* time builtin: start of a builtin command */
+	struct rusage time_usage;	/* time builtin: usage of the shell before a builtin command */
+ 
+	spawn_zygote_main(argc, argv); /* Only returns if this is the shell, not its zygote */
+
+	/* Select the input: shell [-c command | script] */
+	if (argc > 1 && !strcmp(argv[1], "-c")) {
+		if (argc < 3) {
+			fprintf(stderr, "usage: %s [-c command | script]\n", argv[0]);
+			exit(2);
+		}
+		init_string_reader(&reader, argv[2]);
+	} else if (argc > 1) {
+		script_fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+		if (script_fd == -1) {
+			perror(argv[1]);
+			exit(127);
+		}
+		init_command_reader(&reader, script_fd);
+	} else {
+		init_command_reader(&reader, STDIN_FILENO);
+	}
+	interactive = (argc == 1 && isatty(STDIN_FILENO));
+
+	/* History file: opened and indexed when first used */
+	char history_path[PATH_MAX];
+	const char *histfile = getenv("HISTFILE");
+	if (histfile == NULL && getenv("HOME") != NULL) {
+		snprintf(history_path, sizeof(history_path), "%s/.jcshell_history", getenv("HOME"));
+		histfile = history_path;
+	}
+	if (histfile != NULL) history_file(histfile);
+	if (interactive) reader.record = history_add; /* Every line typed, before it is split */
+
+	/* Initialize signal handling and job list */
+	if (interactive) ignore_terminal_signals(); /* A script is stopped or interrupted as a whole */
+	else setvbuf(stdout, NULL, _IOLBF, 0);      /* Keep reports in order with the output of the children */
+	trace_init(); /* Before the first child, which records into the same ring */
+	my_job_list = new_list("Job List");	/* List of jobs in the background or suspended */
+	register_shell_builtins();
+	if (script_fd != -1) script = open_compiled_script(argv[1], script_fd); /* Builtin ids are resolved */
+
+	/* Initialize the event loop: signals are received through a signalfd */
+	sigemptyset(&event_signals);
+	sigaddset(&event_signals, SIGCHLD);
+	sigaddset(&event_signals, SIGHUP);
+	sigaddset(&event_signals, SIGWINCH);
+	sigprocmask(SIG_BLOCK, &event_signals, NULL); /* Children get their own mask from spawn_command() */
+	signal_fd = signalfd(-1, &event_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (event_loop_init() == -1 || signal_fd == -1 || event_loop_add(signal_fd, signal_event, NULL) == -1) {
+		perror("Event loop error");
+		exit(EXIT_FAILURE);
+	}
+	stdin_watched = (event_loop_add(STDIN_FILENO, input_event, NULL) == 0);
+	ioctl(STDIN_FILENO, TIOCGWINSZ, &window_size);
+
+	/* Line editor on a capable terminal; its command trie is built in the background meanwhile */
+	const char *term = getenv("TERM");
+	line_editing = interactive && stdin_watched && isatty(STDOUT_FILENO) && (term == NULL || strcmp(term, "dumb"));
+	if (line_editing) {
+		start_command_index();
+		for_each_builtin(add_command_name);
+	}
+
+	while (1)   /* Program terminates at the end of the input (^D is typed) */
+	{   		
+		arena_reset(&command_arena); /* Release the previous command in one step */
+		update_jobs(); /* Report background job changes before the prompt */
+		if (script != NULL) {
+			/* Already parsed: no line is read or split */
+			args = next_compiled_command(script, &command, &command_arena) ? command.args : NULL;
+		} else if (line_editing) {
+			/* The editor reads the line from the event loop, then it is read from the reader */
+			if (!editor_start("COMMAND->", my_job_list->count)) wait_input();
+			const char *line = editor_line();
+			if (line != NULL) feed_command_reader(&reader, line);
+			args = (line != NULL) ? get_command(&reader, &background) : NULL;
+		} else {
+			if (interactive) {
+				printf("COMMAND->");
+				fflush(stdout);
+			}
+			/* Event loop: jobs are updated while the user types. Buffered lines are ready now */
+			if (reader.fd == STDIN_FILENO && !command_pending(&reader)) wait_input();
+			args = get_command(&reader, &background);  /* Get next command */
+		}
+		if (args == NULL) { /* End of the input */
+			if (interactive) {
+				printf("\nBye\n");
+				exit(EXIT_SUCCESS);
+			}
+			while (active_teams > 0) { /* A script ends when its throttled teams have run */
+				update_jobs();
+				if (active_teams > 0) event_loop_wait(-1);
+			}
+			exit(last_exit_status);
+		}
+		
+		if (script != NULL) {
+			if (command.error != NULL) { /* Reported when the line is reached, as if it was parsed now */
+				fprintf(stderr, "%s\n", command.error);
+				continue;
+			}
+			background = command.background;
+			redirections = command.redirections;
+			num_redirections = command.num_redirections;
+			stages = command.stages;
+			num_stages = command.num_stages;
+		} else {
+			/* Handle redirections; a pipeline has at most one stage or redirection per argument */
+			redirections = arena_new(&command_arena, redirection, reader.num_args + 1);
+			stages = arena_new(&command_arena, char **, reader.num_args + 1);
+			if (redirections == NULL || stages == NULL) {
+				perror("Pipeline error");
+				continue;
+			}
+			num_redirections = parse_redirections(args, redirections, reader.num_args + 1);
+			if (num_redirections >= 0) num_stages = parse_pipeline(args, stages, reader.num_args + 1);
+			if (num_redirections < 0 || num_stages < 0) fprintf(stderr, "%s\n", parse_error());
+			if (num_redirections < 0) continue;
+		}
+		 
+		if(num_stages <= 0) continue;   /* Do nothing if empty command or syntax error */
+
+		/*
+         * Built-in command: time
+         * Usage: time <command> [args...] (also a pipeline)
+         * Runs the command and, when it finishes, prints its wall time, user and system CPU time,
+         * peak memory, page faults and context switches, added over all of its processes.
+         * External commands are measured with wait4() when they are reaped, so a command
+         * launched with & is reported when it finishes. So is the command a builtin launches
+         * (mask, pin, memo, fico &); any other builtin is measured from the shell's own usage.
+         */
+		timed = 0;
+		if (!strcmp(args[0], "time")) {
+			args++;
+			stages[0]++;
+			if (args[0] == NULL) {
+				printf("Usage: time <command> [args...]\n");
+				continue;
+			}
+			timed = 1;
+			time_start = monotonic_ns();
+			getrusage(RUSAGE_SELF, &time_usage);
+		}
+
+		/*
+         * Pipeline: cmd1 | cmd2 | ... | cmdN
+         * Every command runs in its own child and all of them share one process group,
+         * so the whole pipeline is a single job for fg, bg, jobs and sigchld_handler.
+         * Data flows between the stages through kernel pipes.
+         */
+		if(num_stages > 1) {
+			job* pipe_job = launch_pipeline(stages, num_stages, background, redirections, num_redirections);
+			if (pipe_job != NULL) {
+				pipe_job->timed = timed;
+				place_job(pipe_job, background);
+			}
+			timed = 0; /* Reported by the job */
+
+		/*
+         * Builtin commands: found by name in the builtin registry (register_shell_builtins()
+         * and enable -f), they run inside the shell with their redirections.
+         */
+		} else if ((builtin = script ? compiled_builtin(script, &command, args[0]) : find_builtin(args[0])) != NULL) {
+			timed_builtin = timed;
+			last_exit_status = run_builtin(builtin, args, background, redirections, num_redirections);
+			if (timed && !timed_builtin) timed = 0; /* Reported by the job it launched */
+			timed_builtin = 0;
+
+		} else {
+
+			/** The steps are:
+			*	 (1) Launch a child process with spawn_command() (fork, vfork or posix_spawn),
+			*	     as a pipeline with a single stage
+			*	 (2) The child joins its own process group, applies redirections and executes the command
+			* 	 (3) If background == 0, the parent will wait, otherwise continue
+			*	 (4) Shell shows a status message for processed command
+			* 	 (5) Loop returns to get_commnad() function
+			**/
+	
+			job* new = launch_pipeline(stages, 1, background, redirections, num_redirections);
+			if (new != NULL) {
+				new->timed = timed;
+				place_job(new, background);
+			}
+			timed = 0; /* Reported by the job */
+		}
+		if (timed) print_shell_time(time_start, &time_usage);
+	} /* End while */
  }
\ No newline at end of file
@@ -0,0 +1,906 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * spawn_engine module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "job_control.h"
+#include "spawn_engine.h"
+#include "path_cache.h"
+#include "trace.h"
+
+#define VFORK_STACK_SIZE (256 * 1024) /* Stack borrowed by the vfork child until exec */
+#define ZYGOTE_NAME "jcshell-zygote"   /* argv[0] of the helper process */
+#define ZYGOTE_FIXED_FDS 4             /* Working directory and the shell's stdin, stdout and stderr */
+#define ZYGOTE_MAX_FDS 7               /* Plus the pipe and capture ends */
+
+extern char ** environ;
+
+/* Step of the child setup that failed, used to print the right message */
+enum spawn_stage { STAGE_NONE, STAGE_AFFINITY, STAGE_PIPE, STAGE_INPUT, STAGE_OUTPUT, STAGE_DUP, STAGE_EXEC };
+
+/* State shared between the shell and a vfork child (same address space) */
+typedef struct vfork_args_
+{
+	const spawn_request * req;
+	enum spawn_stage stage;  /* Written by the child before _exit() on failure */
+	int error;               /* errno of the failed step */
+} vfork_args;
+
+/*
+ * Launch request sent to the zygote. The redirections follow it, then the
+ * strings: path (if any), argv, environment and the redirection files.
+ * The descriptors travel as SCM_RIGHTS: the working directory, the shell's
+ * stdin, stdout and stderr, then the ones fd_in, fd_out and fd_err index.
+ */
+typedef struct zygote_request_
+{
+	pid_t pgid;
+	int foreground;
+	int has_path, has_mask, has_cpus;
+	sigset_t mask;
+	cpu_set_t cpus;
+	int fd_in, fd_out, fd_err; /* Index of the descriptor passed, -1 if none */
+	int argc, envc;
+	int num_redirections;
+} zygote_request;
+
+/* Redirection of a request, its file (if any) is the next redirection string */
+typedef struct zygote_redirection_
+{
+	int fd, flags, source, has_file;
+} zygote_redirection;
+
+/* Answer of the zygote: the child, or the step that failed before exec */
+typedef struct zygote_reply_
+{
+	pid_t pid;
+	int stage;               /* enum spawn_stage, STAGE_NONE if it reached exec */
+	int error;
+} zygote_reply;
+
+/* A child of the zygote: its request, the descriptors received and its environment */
+typedef struct zygote_child_args_
+{
+	vfork_args va;
+	const int * fds;
+	char ** envp;
+} zygote_child_args;
+
+/* The only dispositions the shell changes (terminal_signals()); children get them back to default */
+static const int shell_signals[] = { SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU };
+#define NUM_SHELL_SIGNALS (int) (sizeof(shell_signals) / sizeof(shell_signals[0]))
+
+static enum spawn_backend current_backend = SPAWN_FORK;
+static spawn_stats stats[SPAWN_BACKENDS];
+static char * vfork_stack = NULL;
+static int zygote_fd = -1;         /* Shell's end of the socket, -1 while there is no zygote */
+static char * request_buffer = NULL;
+static size_t request_size = 0;
+
+static const char * backend_names[] = { "fork", "vfork", "posix_spawn", "zygote" };
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Prints the message for a failed launch step, from the shell or from a
+ * forked child.
+ **/
+static void report_failure(const spawn_request * req, enum spawn_stage stage, int error)
+{
+	switch (stage)
+	{
+	case STAGE_AFFINITY:
+		fprintf(stderr, "Error setting the CPU affinity: %s\n", strerror(error));
+		break;
+	case STAGE_PIPE:
+		fprintf(stderr, "Error connecting pipe: %s\n", strerror(error));
+		break;
+	case STAGE_INPUT:
+		fprintf(stderr, "Error when opening input file: %s\n", strerror(error));
+		break;
+	case STAGE_OUTPUT:
+		fprintf(stderr, "Error when opening output file: %s\n", strerror(error));
+		break;
+	case STAGE_DUP:
+		fprintf(stderr, "Error duplicating descriptor: %s\n", strerror(error));
+		break;
+	case STAGE_EXEC:
+		if (error == ENOENT) printf("Error, command not found: %s\n", req->argv[0]);
+		else fprintf(stderr, "Error executing %s: %s\n", req->argv[0], strerror(error));
+		fflush(stdout);
+		break;
+	default:
+		fprintf(stderr, "Error launching %s: %s\n", req->argv[0], strerror(error));
+	}
+}
+
+/**
+ * Opens file and places it on descriptor target.
+ * Returns 0 on success or -1 with errno set.
+ **/
+static int redirect_fd(const char * file, int flags, int target)
+{
+	int fd = open(file, flags, 0666);
+	if (fd == -1) return -1;
+	if (fd != target)
+	{
+		if (dup2(fd, target) == -1)
+		{
+			int error = errno;
+			close(fd);
+			errno = error;
+			return -1;
+		}
+		close(fd);
+	}
+	return 0;
+}
+
+/**
+ * Applies count redirections in order to the calling process, with one
+ * open() per file plus a dup2() when it does not land on its descriptor,
+ * and one dup2() per copy. Uses system calls only (see child_exec()).
+ * Returns 0 on success or -1 with errno set and *failed the index of the
+ * redirection that failed.
+ **/
+int apply_redirections(const redirection * list, int count, int * failed)
+{
+	int i;
+	for (i = 0; i < count; i++)
+	{
+		*failed = i;
+		if (list[i].file ? redirect_fd(list[i].file, list[i].flags, list[i].fd) == -1
+			: dup2(list[i].source, list[i].fd) == -1) return -1;
+	}
+	return 0;
+}
+
+/**
+ * Child side of a launch, shared by the fork and vfork backends: joins the
+ * process group, takes the terminal, restores default signal dispositions,
+ * applies redirections and the requested signal mask, then executes the
+ * command. Pipe descriptors are expected to be close-on-exec, dup2() clears
+ * the flag on the copies. Only returns on failure, with *stage set and errno preserved.
+ * Uses system calls only, so it is safe on the borrowed vfork address space.
+ **/
+static void child_exec(const spawn_request * req, enum spawn_stage * stage)
+{
+	struct sigaction sa;
+	sigset_t mask;
+	pid_t pgid = req->pgid ? req->pgid : getpid();
+	int sig, failed, i;
+
+	setpgid(0, pgid);
+	trace(TRACE_SETPGID, getpid(), pgid, 0);
+	if (req->foreground)
+	{
+		set_terminal(pgid); /* SIGTTOU is still ignored or blocked here */
+		trace(TRACE_TCSETPGRP, getpid(), pgid, 0);
+	}
+
+	/* Restore default dispositions for the signals the shell ignores */
+	sa.sa_handler = SIG_DFL;
+	sa.sa_flags = 0;
+	sigemptyset(&sa.sa_mask);
+	for (i = 0; i < NUM_SHELL_SIGNALS; i++) sigaction(shell_signals[i], &sa, NULL);
+
+	*stage = STAGE_AFFINITY;
+	if (req->cpus && sched_setaffinity(0, sizeof(cpu_set_t), req->cpus) == -1) return;
+
+	/* Pipe ends first, so explicit file redirections take precedence */
+	*stage = STAGE_PIPE;
+	if (req->fd_in != -1 && dup2(req->fd_in, STDIN_FILENO) == -1) return;
+	if (req->fd_out != -1 && dup2(req->fd_out, STDOUT_FILENO) == -1) return;
+	if (req->fd_err != -1 && dup2(req->fd_err, STDERR_FILENO) == -1) return;
+
+	if (apply_redirections(req->redirections, req->num_redirections, &failed) == -1)
+	{
+		const redirection * r = &req->redirections[failed];
+		*stage = !r->file ? STAGE_DUP : r->flags == O_RDONLY ? STAGE_INPUT : STAGE_OUTPUT;
+		return;
+	}
+
+	if (req->mask) mask = *req->mask;
+	else sigemptyset(&mask);
+	sigprocmask(SIG_SETMASK, &mask, NULL);
+
+	*stage = STAGE_EXEC;
+	trace(TRACE_EXEC, getpid(), pgid, 0); /* Last chance to record before the new program */
+	if (req->path) execv(req->path, req->argv);
+	execvp(req->argv[0], req->argv); /* Not cached, or the cached program is gone */
+	sig = errno;
+	trace(TRACE_EXEC, getpid(), pgid, sig);
+	errno = sig;
+}
+
+/**
+ * fork() backend: the child is a copy of the shell.
+ **/
+static pid_t spawn_fork(const spawn_request * req)
+{
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		enum spawn_stage stage = STAGE_NONE;
+		child_exec(req, &stage);
+		report_failure(req, stage, errno);
+		_exit(EXIT_FAILURE); /* Without flushing or running anything of the shell */
+	}
+	else if (pid > 0)
+	{
+		/* Set the group from both sides, whoever runs first wins the race */
+		pid_t pgid = req->pgid ? req->pgid : pid;
+		setpgid(pid, pgid);
+		if (req->foreground) set_terminal(pgid);
+	}
+	else
+	{
+		perror("Fork error");
+	}
+	return pid;
+}
+
+/**
+ * Maps the stack of vfork children the first time.
+ * Returns 0 on success or -1.
+ **/
+static int map_vfork_stack(void)
+{
+	if (vfork_stack == NULL)
+	{
+		vfork_stack = mmap(NULL, VFORK_STACK_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+		if (vfork_stack == MAP_FAILED)
+		{
+			vfork_stack = NULL;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int vfork_child(void * arg)
+{
+	vfork_args * va = (vfork_args *) arg;
+	child_exec(va->req, &va->stage);
+	va->error = errno;
+	_exit(127);
+}
+
+/**
+ * clone(CLONE_VM|CLONE_VFORK) backend: the child runs on a private stack
+ * inside the shell's address space and the shell sleeps until it calls exec
+ * or exits. All signals are blocked meanwhile so no shell handler can run on
+ * the child's side.
+ **/
+static pid_t spawn_vfork(const spawn_request * req)
+{
+	vfork_args va = { req, STAGE_NONE, 0 };
+	sigset_t all, old;
+	pid_t pid;
+
+	if (map_vfork_stack() == -1)
+	{
+		perror("vfork stack");
+		return -1;
+	}
+
+	sigfillset(&all);
+	sigprocmask(SIG_SETMASK, &all, &old);
+	pid = clone(vfork_child, vfork_stack + VFORK_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD, &va);
+	sigprocmask(SIG_SETMASK, &old, NULL);
+
+	if (pid == -1)
+	{
+		perror("Clone error");
+		return -1;
+	}
+	if (va.stage != STAGE_NONE && va.error != 0)
+	{
+		/* The child never reached the new program: collect it here */
+		waitpid(pid, NULL, 0);
+		report_failure(req, va.stage, va.error);
+		errno = va.error;
+		return -1;
+	}
+	return pid;
+}
+
+/**
+ * posix_spawnp() backend: process group, default signals, signal mask,
+ * terminal handover and redirections are all expressed as spawn attributes
+ * and file actions.
+ **/
+static pid_t spawn_posix(const spawn_request * req)
+{
+	static posix_spawn_file_actions_t terminal_actions; /* Only the terminal handover */
+	static int terminal_actions_ready = 0;
+	posix_spawnattr_t attr;
+	posix_spawn_file_actions_t actions, *used_actions = &actions;
+	sigset_t defaults, mask;
+	cpu_set_t shell_cpus;
+	pid_t pid = -1;
+	int error;
+	int has_redirection = req->num_redirections > 0;
+	int stale, i;
+
+	posix_spawnattr_init(&attr);
+	posix_spawn_file_actions_init(&actions);
+
+	sigemptyset(&defaults);
+	for (i = 0; i < NUM_SHELL_SIGNALS; i++) sigaddset(&defaults, shell_signals[i]);
+	if (req->mask) mask = *req->mask;
+	else sigemptyset(&mask);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+	posix_spawnattr_setpgroup(&attr, req->pgid);
+	posix_spawnattr_setsigdefault(&attr, &defaults);
+	posix_spawnattr_setsigmask(&attr, &mask);
+
+	if (!has_redirection && req->fd_in == -1 && req->fd_out == -1 && req->fd_err == -1)
+	{
+		/* Plain commands share prebuilt actions: adding actions calls malloc() */
+		used_actions = NULL;
+		if (req->foreground && isatty(STDIN_FILENO))
+		{
+			if (!terminal_actions_ready)
+			{
+				posix_spawn_file_actions_init(&terminal_actions);
+				posix_spawn_file_actions_addtcsetpgrp_np(&terminal_actions, STDIN_FILENO);
+				terminal_actions_ready = 1;
+			}
+			used_actions = &terminal_actions;
+		}
+	}
+	else if (req->foreground && isatty(STDIN_FILENO))
+		posix_spawn_file_actions_addtcsetpgrp_np(&actions, STDIN_FILENO);
+	if (req->fd_in != -1)
+		posix_spawn_file_actions_adddup2(&actions, req->fd_in, STDIN_FILENO);
+	if (req->fd_out != -1)
+		posix_spawn_file_actions_adddup2(&actions, req->fd_out, STDOUT_FILENO);
+	if (req->fd_err != -1)
+		posix_spawn_file_actions_adddup2(&actions, req->fd_err, STDERR_FILENO);
+	for (i = 0; i < req->num_redirections; i++)
+	{
+		const redirection * r = &req->redirections[i];
+		if (r->file) posix_spawn_file_actions_addopen(&actions, r->fd, r->file, r->flags, 0666);
+		else posix_spawn_file_actions_adddup2(&actions, r->source, r->fd);
+	}
+
+	/* posix_spawn() has no affinity attribute: the child inherits the shell's,
+	   set for the duration of the call */
+	if (req->cpus)
+	{
+		if (sched_getaffinity(0, sizeof(shell_cpus), &shell_cpus) == -1
+			|| sched_setaffinity(0, sizeof(cpu_set_t), req->cpus) == -1)
+		{
+			error = errno;
+			posix_spawn_file_actions_destroy(&actions);
+			posix_spawnattr_destroy(&attr);
+			report_failure(req, STAGE_AFFINITY, error);
+			errno = error;
+			return -1;
+		}
+	}
+
+	if (req->path) error = posix_spawn(&pid, req->path, used_actions, &attr, req->argv, environ);
+	stale = req->path && error == ENOENT; /* Removed since it was cached */
+	if (!req->path || stale)
+		error = posix_spawnp(&pid, req->argv[0], used_actions, &attr, req->argv, environ);
+	if (stale) forget_command(req->argv[0]); /* Frees req->path, not used from here on */
+	if (req->cpus) sched_setaffinity(0, sizeof(shell_cpus), &shell_cpus);
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+	/* posix_spawn() returns once the child has called exec: setpgid and tcsetpgrp are not seen */
+	if (!error) trace(TRACE_EXEC, pid, req->pgid ? req->pgid : pid, 0);
+
+	if (error)
+	{
+		/* posix_spawnp() does not tell which step failed */
+		report_failure(req, has_redirection ? STAGE_NONE : STAGE_EXEC, error);
+		errno = error;
+		return -1;
+	}
+	return pid;
+}
+
+/**
+ * Starts the zygote: the shell's own program, executed again with argv[0]
+ * ZYGOTE_NAME (see spawn_zygote_main()), so it holds none of the shell's
+ * memory, descriptors or signal handlers. It stays in the shell's process
+ * group and exits when the socket is closed.
+ * Returns 0 on success or -1 with errno set.
+ **/
+static int start_zygote(void)
+{
+	posix_spawnattr_t attr;
+	posix_spawn_file_actions_t actions;
+	sigset_t empty;
+	char fd_arg[16];
+	char * argv[] = { ZYGOTE_NAME, fd_arg, NULL };
+	pid_t pid;
+	int sv[2], error;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) return -1;
+	snprintf(fd_arg, sizeof(fd_arg), "%d", sv[1]);
+	sigemptyset(&empty);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+	posix_spawnattr_setsigmask(&attr, &empty);
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, sv[1], sv[1]); /* Only clears close-on-exec */
+	error = posix_spawn(&pid, "/proc/self/exe", &actions, &attr, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+	close(sv[1]);
+	if (error)
+	{
+		close(sv[0]);
+		errno = error;
+		return -1;
+	}
+	zygote_fd = sv[0];
+	return 0;
+}
+
+static void stop_zygote(void)
+{
+	if (zygote_fd == -1) return;
+	close(zygote_fd); /* The zygote exits at the end of its input, the shell reaps it */
+	zygote_fd = -1;
+}
+
+/**
+ * Serializes req into request_buffer.
+ * Returns the length of the request, or 0 if there is no memory.
+ **/
+static size_t build_zygote_request(const spawn_request * req, int fd_slots[3])
+{
+	zygote_request h;
+	zygote_redirection * zr;
+	size_t length = sizeof(h) + req->num_redirections * sizeof(zygote_redirection);
+	char * p;
+	int i;
+
+	memset(&h, 0, sizeof(h));
+	h.pgid = req->pgid;
+	h.foreground = req->foreground;
+	h.has_path = req->path != NULL;
+	h.has_mask = req->mask != NULL;
+	if (req->mask) h.mask = *req->mask;
+	h.has_cpus = req->cpus != NULL;
+	if (req->cpus) h.cpus = *req->cpus;
+	h.fd_in = fd_slots[0];
+	h.fd_out = fd_slots[1];
+	h.fd_err = fd_slots[2];
+	h.num_redirections = req->num_redirections;
+
+	if (req->path) length += strlen(req->path) + 1;
+	for (h.argc = 0; req->argv[h.argc]; h.argc++) length += strlen(req->argv[h.argc]) + 1;
+	for (h.envc = 0; environ[h.envc]; h.envc++) length += strlen(environ[h.envc]) + 1;
+	for (i = 0; i < req->num_redirections; i++)
+	{
+		if (req->redirections[i].file) length += strlen(req->redirections[i].file) + 1;
+	}
+
+	if (length > request_size)
+	{
+		char * aux = (char *) realloc(request_buffer, length);
+		if (!aux) return 0;
+		request_buffer = aux;
+		request_size = length;
+	}
+	memcpy(request_buffer, &h, sizeof(h));
+	zr = (zygote_redirection *) (request_buffer + sizeof(h));
+	p = (char *) (zr + req->num_redirections);
+	for (i = 0; i < req->num_redirections; i++)
+	{
+		zr[i].fd = req->redirections[i].fd;
+		zr[i].flags = req->redirections[i].flags;
+		zr[i].source = req->redirections[i].source;
+		zr[i].has_file = req->redirections[i].file != NULL;
+	}
+	if (req->path) p = stpcpy(p, req->path) + 1;
+	for (i = 0; i < h.argc; i++) p = stpcpy(p, req->argv[i]) + 1;
+	for (i = 0; i < h.envc; i++) p = stpcpy(p, environ[i]) + 1;
+	for (i = 0; i < req->num_redirections; i++)
+	{
+		if (req->redirections[i].file) p = stpcpy(p, req->redirections[i].file) + 1;
+	}
+	return length;
+}
+
+/**
+ * Sends a request of length bytes from request_buffer with num_fds
+ * descriptors and reads the reply.
+ * Returns 0 on success or -1 with errno set.
+ **/
+static int zygote_call(size_t length, const int * fds, int num_fds, zygote_reply * reply)
+{
+	char control[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+	struct iovec iov = { request_buffer, length };
+	struct msghdr msg;
+	struct cmsghdr * cmsg;
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = CMSG_SPACE(num_fds * sizeof(int));
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, num_fds * sizeof(int));
+
+	while ((n = sendmsg(zygote_fd, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR);
+	if (n == -1) return -1;
+	while ((n = recv(zygote_fd, reply, sizeof(*reply), 0)) == -1 && errno == EINTR);
+	if (n != sizeof(*reply))
+	{
+		if (n >= 0) errno = EPIPE; /* The zygote died with the request */
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Zygote backend: the helper process forks and executes the command, and
+ * the child is created as a child of the shell (CLONE_PARENT), so job
+ * control, reaping and the terminal stay with the shell. A zygote that has
+ * died is started again; a request larger than the socket takes is
+ * launched with posix_spawn() instead.
+ **/
+static pid_t spawn_zygote(const spawn_request * req)
+{
+	int fds[ZYGOTE_MAX_FDS] = { -1, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	int fd_slots[3] = { req->fd_in, req->fd_out, req->fd_err };
+	int num_fds = ZYGOTE_FIXED_FDS, attempt, i, result = -1;
+	zygote_reply reply;
+	size_t length;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (fd_slots[i] == -1) continue;
+		fds[num_fds] = fd_slots[i];
+		fd_slots[i] = num_fds++;
+	}
+	length = build_zygote_request(req, fd_slots);
+	fds[0] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (length == 0 || fds[0] == -1)
+	{
+		perror("Zygote request");
+		if (fds[0] != -1) close(fds[0]);
+		return -1;
+	}
+
+	for (attempt = 0; attempt < 2 && result == -1; attempt++)
+	{
+		if (zygote_fd == -1 && start_zygote() == -1) break;
+		result = zygote_call(length, fds, num_fds, &reply);
+		if (result == -1 && errno == EMSGSIZE)
+		{
+			close(fds[0]);
+			return spawn_posix(req);
+		}
+		if (result == -1) stop_zygote();
+	}
+	close(fds[0]);
+	if (result == -1)
+	{
+		perror("Zygote error");
+		return -1;
+	}
+
+	if (reply.pid == -1 || reply.stage != STAGE_NONE)
+	{
+		/* A child that never reached the new program is ours to collect */
+		if (reply.pid > 0) waitpid(reply.pid, NULL, 0);
+		report_failure(req, (enum spawn_stage) reply.stage, reply.error);
+		errno = reply.error;
+		return -1;
+	}
+	trace(TRACE_EXEC, reply.pid, req->pgid ? req->pgid : reply.pid, 0);
+	return reply.pid;
+}
+
+static int zygote_child(void * arg)
+{
+	zygote_child_args * zc = (zygote_child_args *) arg;
+	int i;
+
+	fchdir(zc->fds[0]);
+	for (i = 0; i < 3; i++) dup2(zc->fds[i + 1], i);
+	environ = zc->envp; /* Used by exec */
+	child_exec(zc->va.req, &zc->va.stage);
+	zc->va.error = errno;
+	_exit(127);
+}
+
+/**
+ * Zygote side of a request: rebuilds the spawn_request and launches it
+ * with child_exec() in a vfork child of the shell, so the zygote resumes
+ * when the child has called exec or failed and the reply tells which.
+ **/
+static void zygote_launch(char * message, size_t length, const int * fds, zygote_reply * reply)
+{
+	zygote_request * h = (zygote_request *) message;
+	zygote_redirection * zr = (zygote_redirection *) (h + 1);
+	char * p = (char *) (zr + h->num_redirections), * end = message + length;
+	char ** argv = (char **) malloc((h->argc + 1) * sizeof(char *));
+	char ** envp = (char **) malloc((h->envc + 1) * sizeof(char *));
+	redirection * redirections = (redirection *) malloc((h->num_redirections + 1) * sizeof(redirection));
+	char ** shell_environ = environ;
+	spawn_request req;
+	zygote_child_args zc;
+	sigset_t all, old;
+	pid_t pid;
+	int i;
+
+	reply->pid = -1;
+	reply->stage = STAGE_NONE;
+	reply->error = ENOMEM;
+	if (!argv || !envp || !redirections || map_vfork_stack() == -1)
+	{
+		free(argv);
+		free(envp);
+		free(redirections);
+		return;
+	}
+
+	/* Every string ends inside the message: the last byte is a '\0' */
+	init_spawn_request(&req, argv, !h->foreground);
+	if (h->has_path)
+	{
+		req.path = p;
+		p += strlen(p) + 1;
+	}
+	for (i = 0; i < h->argc && p < end; i++, p += strlen(p) + 1) argv[i] = p;
+	argv[i] = NULL;
+	for (i = 0; i < h->envc && p < end; i++, p += strlen(p) + 1) envp[i] = p;
+	envp[i] = NULL;
+	for (i = 0; i < h->num_redirections; i++)
+	{
+		redirections[i].fd = zr[i].fd;
+		redirections[i].flags = zr[i].flags;
+		redirections[i].source = zr[i].source;
+		redirections[i].file = NULL;
+		if (zr[i].has_file && p < end)
+		{
+			redirections[i].file = p;
+			p += strlen(p) + 1;
+		}
+	}
+	req.pgid = h->pgid;
+	req.mask = h->has_mask ? &h->mask : NULL;
+	req.cpus = h->has_cpus ? &h->cpus : NULL;
+	req.fd_in = h->fd_in == -1 ? -1 : fds[h->fd_in];
+	req.fd_out = h->fd_out == -1 ? -1 : fds[h->fd_out];
+	req.fd_err = h->fd_err == -1 ? -1 : fds[h->fd_err];
+	req.redirections = redirections;
+	req.num_redirections = h->num_redirections;
+
+	/* As spawn_vfork(), with the shell as parent: the exit signal is the zygote's, SIGCHLD */
+	zc.va.req = &req;
+	zc.va.stage = STAGE_NONE;
+	zc.va.error = 0;
+	zc.fds = fds;
+	zc.envp = envp;
+	sigfillset(&all);
+	sigprocmask(SIG_SETMASK, &all, &old);
+	pid = clone(zygote_child, vfork_stack + VFORK_STACK_SIZE, CLONE_VM | CLONE_VFORK | CLONE_PARENT, &zc);
+	sigprocmask(SIG_SETMASK, &old, NULL);
+	environ = shell_environ; /* Set by the child on the shared memory */
+	reply->pid = pid;
+	reply->error = pid == -1 ? errno : zc.va.error;
+	if (pid > 0 && zc.va.stage != STAGE_NONE && zc.va.error != 0) reply->stage = zc.va.stage;
+	free(argv);
+	free(envp);
+	free(redirections);
+}
+
+/**
+ * Checks that the counts and descriptor indexes of a request fit in its
+ * length and in the descriptors received.
+ **/
+static int valid_request(const zygote_request * h, size_t length, int num_fds)
+{
+	int slots[3] = { h->fd_in, h->fd_out, h->fd_err }, i;
+	for (i = 0; i < 3; i++)
+	{
+		if (slots[i] != -1 && (slots[i] < ZYGOTE_FIXED_FDS || slots[i] >= num_fds)) return 0;
+	}
+	return h->argc > 0 && h->envc >= 0 && h->num_redirections >= 0
+		&& (size_t) h->num_redirections <= (length - sizeof(*h)) / sizeof(zygote_redirection);
+}
+
+/**
+ * Entry point of the zygote. Call it first thing in main(): when the
+ * program was started as the zygote, it serves launch requests until the
+ * shell closes its end of the socket and then exits; otherwise it returns.
+ **/
+void spawn_zygote_main(int argc, char * argv[])
+{
+	char control[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+	char * message = NULL;
+	size_t size = 0;
+	int fd;
+
+	if (argc != 2 || strcmp(argv[0], ZYGOTE_NAME)) return;
+	fd = atoi(argv[1]);
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) exit(EXIT_FAILURE);
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+	prctl(PR_SET_NAME, ZYGOTE_NAME); /* Not "exe" in ps */
+	signal(SIGTTOU, SIG_IGN); /* Children take the terminal before they restore it */
+	signal(SIGTTIN, SIG_IGN);
+
+	while (1)
+	{
+		struct iovec iov;
+		struct msghdr msg;
+		struct cmsghdr * cmsg;
+		int fds[ZYGOTE_MAX_FDS], num_fds = 0, i;
+		zygote_reply reply;
+		ssize_t n = recv(fd, NULL, 0, MSG_PEEK | MSG_TRUNC); /* Length of the next request */
+
+		if (n == -1 && errno == EINTR) continue;
+		if (n <= 0) exit(EXIT_SUCCESS);
+		if ((size_t) n > size)
+		{
+			char * aux = (char *) realloc(message, n);
+			if (!aux) exit(EXIT_FAILURE);
+			message = aux;
+			size = n;
+		}
+		iov.iov_base = message;
+		iov.iov_len = size;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+		if (n <= 0) exit(EXIT_SUCCESS);
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+			num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			memcpy(fds, CMSG_DATA(cmsg), num_fds * sizeof(int));
+		}
+
+		if ((size_t) n >= sizeof(zygote_request) && message[n - 1] == '\0' && num_fds >= ZYGOTE_FIXED_FDS
+			&& valid_request((zygote_request *) message, n, num_fds))
+			zygote_launch(message, n, fds, &reply);
+		else
+		{
+			reply.pid = -1;
+			reply.stage = STAGE_NONE;
+			reply.error = EINVAL;
+		}
+		for (i = 0; i < num_fds; i++) close(fds[i]);
+		send(fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+	}
+}
+
+/**
+ * Launches the command described by req with the current backend. The
+ * program is resolved through the PATH cache unless req->path is given.
+ * Returns the pid of the child, or -1 if it could not be started (the
+ * reason has already been printed).
+ **/
+pid_t spawn_command(const spawn_request * request)
+{
+	long long start = now_ns(), elapsed;
+	spawn_stats * st;
+	spawn_request resolved = *request;
+	const spawn_request * req = &resolved;
+	pid_t pid;
+
+	if (!resolved.path) resolved.path = lookup_command(resolved.argv[0]);
+
+	switch (current_backend)
+	{
+	case SPAWN_VFORK:
+		pid = spawn_vfork(req);
+		break;
+	case SPAWN_POSIX:
+		pid = spawn_posix(req);
+		break;
+	case SPAWN_ZYGOTE:
+		pid = spawn_zygote(req);
+		break;
+	default:
+		pid = spawn_fork(req);
+	}
+
+	elapsed = now_ns() - start;
+	st = &stats[current_backend];
+	if (pid > 0)
+	{
+		trace_record_at(start, TRACE_FORK, pid, req->pgid ? req->pgid : pid, current_backend);
+		if (st->launches == 0 || elapsed < st->min_ns) st->min_ns = elapsed;
+		if (elapsed > st->max_ns) st->max_ns = elapsed;
+		st->total_ns += elapsed;
+		st->launches++;
+	}
+	else
+	{
+		/* The child may have taken the terminal before failing */
+		if (req->foreground) set_terminal(getpgrp());
+		st->failures++;
+	}
+	return pid;
+}
+
+/**
+ * Selects the backend used by next launches. Each backend keeps its own
+ * statistics, so they can be compared. The zygote is started when it is
+ * selected and stopped when another backend is.
+ * Returns 0 on success or -1 with errno set if the zygote cannot be started.
+ **/
+int set_spawn_backend(enum spawn_backend backend)
+{
+	if (backend != SPAWN_ZYGOTE) stop_zygote();
+	else if (zygote_fd == -1 && start_zygote() == -1) return -1;
+	current_backend = backend;
+	return 0;
+}
+
+enum spawn_backend get_spawn_backend(void)
+{
+	return current_backend;
+}
+
+const char * spawn_backend_name(enum spawn_backend backend)
+{
+	return backend_names[backend];
+}
+
+/**
+ * Translates a backend name into its value.
+ * Returns 0 if the name is unknown.
+ **/
+int parse_spawn_backend(const char * name, enum spawn_backend * backend)
+{
+	int i;
+	for (i = 0; i < (int) (sizeof(backend_names) / sizeof(backend_names[0])); i++)
+	{
+		if (!strcmp(name, backend_names[i]) || (i == SPAWN_POSIX && !strcmp(name, "posix")))
+		{
+			*backend = (enum spawn_backend) i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+const spawn_stats * get_spawn_stats(enum spawn_backend backend)
+{
+	return &stats[backend];
+}
+
+void reset_spawn_stats(void)
+{
+	memset(stats, 0, sizeof(stats));
+}
@@ -0,0 +1,81 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the spawn_engine module
+ *
+ * The spawn module launches external commands. Four backends are available:
+ *   - fork:        classic fork() + execvp(), the child copies the shell (default)
+ *   - vfork:       clone(CLONE_VM|CLONE_VFORK), the child borrows the shell's
+ *                  memory until it calls exec, so no page tables are copied
+ *   - posix_spawn: glibc posix_spawnp() with spawn attributes and file actions
+ *   - zygote:      a small helper process, started once from a fresh copy of
+ *                  the program, receives each request over a Unix socket
+ *                  (argv, environment, descriptors as SCM_RIGHTS, process
+ *                  group and signal mask) and forks it as a child of the shell
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _SPAWN_ENGINE_H
+#define _SPAWN_ENGINE_H
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/types.h>
+
+struct redirection_;               /* redirection of job_control.h */
+
+/**
+ * Enumerations
+ **/
+enum spawn_backend { SPAWN_FORK, SPAWN_VFORK, SPAWN_POSIX, SPAWN_ZYGOTE, SPAWN_BACKENDS };
+
+/* Description of a command to launch */
+typedef struct spawn_request_
+{
+	char ** argv;            /* NULL terminated argument vector, argv[0] is the program */
+	const char * path;       /* Program to execute, NULL = search argv[0] in PATH */
+	pid_t pgid;              /* Process group to join, 0 = new group led by the child */
+	int foreground;          /* 1 if the terminal is handed to the child's group */
+	const sigset_t * mask;   /* Signals blocked in the child, NULL = none */
+	const cpu_set_t * cpus;  /* CPUs the child may run on, NULL = the shell's */
+	int fd_in;               /* Descriptor placed on stdin (pipe read end), -1 if none */
+	int fd_out;              /* Descriptor placed on stdout (pipe write end), -1 if none */
+	int fd_err;              /* Descriptor placed on stderr (captured output), -1 if none */
+	const struct redirection_ * redirections; /* Applied in order after the pipe ends */
+	int num_redirections;
+} spawn_request;
+
+/* Launch statistics of a backend */
+typedef struct spawn_stats_
+{
+	unsigned long launches;  /* Successful launches */
+	unsigned long failures;  /* Launches that did not reach exec */
+	long long total_ns;      /* Accumulated time spent inside spawn_command() */
+	long long min_ns;
+	long long max_ns;
+} spawn_stats;
+
+/**
+ * Public Functions
+ **/
+pid_t spawn_command(const spawn_request * req);
+int apply_redirections(const struct redirection_ * list, int count, int * failed);
+int set_spawn_backend(enum spawn_backend backend);
+enum spawn_backend get_spawn_backend(void);
+const char * spawn_backend_name(enum spawn_backend backend);
+int parse_spawn_backend(const char * name, enum spawn_backend * backend);
+const spawn_stats * get_spawn_stats(enum spawn_backend backend);
+void reset_spawn_stats(void);
+void spawn_zygote_main(int argc, char * argv[]);
+
+/**
+ * Public macros
+ **/
+#define init_spawn_request(req, args, bg)  \
+	(memset((req), 0, sizeof(spawn_request)), (req)->argv = (args), (req)->foreground = !(bg), \
+	 (req)->fd_in = -1, (req)->fd_out = -1, (req)->fd_err = -1)
+
+#endif
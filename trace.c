@@ -0,0 +1,237 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * trace module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "trace.h"
+#include "spawn_engine.h"
+
+static trace_ring * ring = NULL;   /* Shared mapping, anonymous or the mirror file */
+static int mirrored = 0;
+
+static const char * event_names[] = { "fork", "setpgid", "tcsetpgrp", "exec",
+	"stop", "continue", "exit", "reap" };
+
+/**
+ * Maps a ring, shared with forked children. fd = -1 for an anonymous one.
+ * Returns NULL on failure.
+ **/
+static trace_ring * map_ring(int fd)
+{
+	void * addr = mmap(NULL, sizeof(trace_ring), PROT_READ | PROT_WRITE,
+		fd == -1 ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) return NULL;
+	return (trace_ring *) addr;
+}
+
+/**
+ * Creates the ring. Nothing is recorded before, so programs that do not
+ * call it (e.g. the benchmarks) pay only a test per event. Call it before
+ * launching children, so they share the shell's ring.
+ * Returns 0 on success or -1 with errno set.
+ **/
+int trace_init(void)
+{
+	if (!ring)
+	{
+		trace_ring * aux = map_ring(-1);
+		if (!aux) return -1;
+		memcpy(aux->magic, TRACE_MAGIC, sizeof(aux->magic));
+		aux->capacity = TRACE_CAPACITY;
+		aux->record_size = sizeof(trace_record);
+		ring = aux;
+	}
+	return 0;
+}
+
+/**
+ * CLOCK_MONOTONIC time in nanoseconds (vDSO, no system call)
+ **/
+long long trace_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Records an event that happened at time ns. Async-signal-safe: the slot is
+ * claimed with an atomic increment and published by writing seq last.
+ **/
+void trace_record_at(long long ns, enum trace_event event, pid_t pid, pid_t pgid, int arg)
+{
+	trace_ring * r = ring;
+	unsigned long long pos;
+	trace_record * rec;
+
+	if (!r) return;
+	pos = __atomic_fetch_add(&r->head, 1, __ATOMIC_RELAXED);
+	rec = &r->records[pos & (TRACE_CAPACITY - 1)];
+	__atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+	rec->ns = ns;
+	rec->pid = pid;
+	rec->pgid = pgid;
+	rec->event = event;
+	rec->arg = arg;
+	__atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Prints the wait status of a stop, exit or reap event
+ **/
+static void print_status(int status)
+{
+	if (WIFEXITED(status)) printf("exit code %d", WEXITSTATUS(status));
+	else if (WIFSIGNALED(status)) printf("signal %d", WTERMSIG(status));
+	else if (WIFSTOPPED(status)) printf("stopped by %d", WSTOPSIG(status));
+	else if (WIFCONTINUED(status)) printf("continued");
+}
+
+static int compare_records(const void * a, const void * b)
+{
+	const trace_record * x = (const trace_record *) a, * y = (const trace_record *) b;
+	if (x->ns != y->ns) return x->ns < y->ns ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+/**
+ * Prints the last records (all of them if last <= 0) in time order: events
+ * recorded after the fact (e.g. fork, known once it returns) are placed
+ * where they happened. Times are relative to the first record printed,
+ * with the gap from the previous event of the same process, e.g. fork to
+ * exec or exit to reap.
+ **/
+void trace_dump(int last)
+{
+	unsigned long long head, first, i;
+	trace_record * records;
+	int n = 0, k, j;
+
+	if (!ring)
+	{
+		printf("Trace is empty\n");
+		return;
+	}
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	first = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+	if (last > 0 && head - first > (unsigned long long) last) first = head - last;
+
+	records = (trace_record *) malloc((head - first + 1) * sizeof(trace_record));
+	if (!records) return;
+	for (i = first; i < head; i++)
+	{
+		records[n] = ring->records[i & (TRACE_CAPACITY - 1)];
+		if (records[n].seq == i + 1) n++; /* Skip overwritten or half written records */
+	}
+	qsort(records, n, sizeof(trace_record), compare_records);
+	for (k = 0; k < n; k++)
+	{
+		/* Events recorded after the process left the job tables: take the pgid of another one */
+		if (records[k].pgid != 0) continue;
+		for (j = 0; j < n && (records[j].pid != records[k].pid || records[j].pgid == 0); j++);
+		if (j < n) records[k].pgid = records[j].pgid;
+	}
+
+	if (n == 0) printf("Trace is empty\n");
+	else printf("%12s %12s  %-10s %7s %7s  %s\n", "time (us)", "+pid (us)", "event", "pid", "pgid", "info");
+	for (k = 0; k < n; k++)
+	{
+		trace_record * rec = &records[k];
+
+		printf("%12.3f ", (rec->ns - records[0].ns) / 1e3);
+		for (j = k - 1; j >= 0 && records[j].pid != rec->pid; j--);
+		if (j >= 0) printf("%12.3f  ", (rec->ns - records[j].ns) / 1e3);
+		else printf("%12s  ", "-");
+		printf("%-10s %7d %7d  ", trace_event_name(rec->event), rec->pid, rec->pgid);
+		switch (rec->event)
+		{
+		case TRACE_FORK: /* Index of enum spawn_backend */
+			printf("%s", rec->arg >= 0 && rec->arg < SPAWN_BACKENDS ?
+				spawn_backend_name((enum spawn_backend) rec->arg) : "?");
+			break;
+		case TRACE_STOP:
+		case TRACE_CONTINUE:
+		case TRACE_EXIT:
+		case TRACE_REAP:
+			print_status(rec->arg);
+			break;
+		case TRACE_EXEC:
+			if (rec->arg) printf("failed: %s", strerror(rec->arg));
+			break;
+		default:
+			break;
+		}
+		printf("\n");
+	}
+	free(records);
+}
+
+/**
+ * Forgets every record
+ **/
+void trace_clear(void)
+{
+	if (!ring) return;
+	memset(ring->records, 0, sizeof(ring->records));
+	ring->head = 0;
+}
+
+/**
+ * Moves the ring to a shared mapping of file (created or truncated), so the
+ * records can be read from outside the shell, or back to anonymous memory
+ * if file is NULL. The records kept so far are copied.
+ * Returns 0 on success or -1 with errno set.
+ **/
+int trace_mirror(const char * file)
+{
+	trace_ring * current = ring, * aux;
+	int fd = -1;
+
+	if (!current && trace_init() == -1) return -1;
+	current = ring;
+	if (!file && !mirrored) return 0;
+	if (file)
+	{
+		fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd == -1) return -1;
+		if (ftruncate(fd, sizeof(trace_ring)) == -1)
+		{
+			int error = errno;
+			close(fd);
+			errno = error;
+			return -1;
+		}
+	}
+	aux = map_ring(fd);
+	if (fd != -1) close(fd); /* The mapping keeps the file */
+	if (!aux) return -1;
+
+	memcpy(aux, current, sizeof(trace_ring));
+	ring = aux;
+	munmap(current, sizeof(trace_ring));
+	mirrored = (file != NULL);
+	return 0;
+}
+
+/**
+ * Returns the name of an event
+ **/
+const char * trace_event_name(enum trace_event event)
+{
+	return event >= 0 && event <= TRACE_REAP ? event_names[event] : "?";
+}
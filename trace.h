@@ -0,0 +1,67 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes and type declarations for the trace module
+ *
+ * A fixed size ring of job lifecycle events (fork, setpgid, tcsetpgrp,
+ * exec, stop, continue, exit and reap) with CLOCK_MONOTONIC nanosecond
+ * timestamps. Recording is a few stores with no locks and no system calls,
+ * safe from signal handlers and from vfork children. The ring lives in a
+ * shared mapping, so forked children record into the shell's ring too, and
+ * it can be mirrored to a file that other programs can read while the
+ * shell runs.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <sys/types.h>
+
+#define TRACE_CAPACITY 4096 /* Records kept, power of two */
+#define TRACE_MAGIC "JCTRACE1"
+
+enum trace_event { TRACE_FORK, TRACE_SETPGID, TRACE_TCSETPGRP, TRACE_EXEC,
+	TRACE_STOP, TRACE_CONTINUE, TRACE_EXIT, TRACE_REAP };
+
+/* A traced event */
+typedef struct trace_record_
+{
+	unsigned long long seq;  /* Position + 1, written last: 0 or stale while being written */
+	long long ns;            /* CLOCK_MONOTONIC timestamp */
+	pid_t pid;               /* Process the event is about */
+	pid_t pgid;              /* Its process group, 0 if unknown */
+	int event;               /* enum trace_event */
+	int arg;                 /* Wait status, signal or backend, depending on the event */
+} trace_record;
+
+/* Layout of the ring, in memory and in the mirror file */
+typedef struct trace_ring_
+{
+	char magic[8];           /* TRACE_MAGIC */
+	unsigned int capacity;   /* Number of records */
+	unsigned int record_size;
+	unsigned long long head; /* Records written since the ring was created */
+	trace_record records[TRACE_CAPACITY];
+} trace_ring;
+
+/**
+ * Public Functions
+ **/
+int trace_init(void);
+void trace_record_at(long long ns, enum trace_event event, pid_t pid, pid_t pgid, int arg);
+long long trace_clock(void);
+void trace_dump(int last);
+void trace_clear(void);
+int trace_mirror(const char * file);
+const char * trace_event_name(enum trace_event event);
+
+/**
+ * Public macros
+ **/
+#define trace(event, pid, pgid, arg)  trace_record_at(trace_clock(), (event), (pid), (pgid), (arg))
+
+#endif
@@ -0,0 +1,733 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * utility_builtins module
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "builtin_registry.h"
+#include "utility_builtins.h"
+
+#define OUTPUT_BUFFER 4096 /* Output is written in blocks, not per argument */
+
+/* Buffered output on a descriptor of the builtin */
+typedef struct output_
+{
+	int fd;
+	int len;
+	int error;               /* errno of the first failed write, 0 if none */
+	char data[OUTPUT_BUFFER];
+} output;
+
+static void out_flush(output * out)
+{
+	char * p = out->data;
+	while (out->len > 0 && !out->error)
+	{
+		ssize_t n = write(out->fd, p, out->len);
+		if (n == -1)
+		{
+			if (errno != EINTR) out->error = errno;
+			continue;
+		}
+		p += n;
+		out->len -= n;
+	}
+	out->len = 0;
+}
+
+static void out_write(output * out, const char * s, size_t n)
+{
+	while (n > 0)
+	{
+		size_t chunk = OUTPUT_BUFFER - out->len;
+		if (chunk > n) chunk = n;
+		memcpy(out->data + out->len, s, chunk);
+		out->len += chunk;
+		s += chunk;
+		n -= chunk;
+		if (out->len == OUTPUT_BUFFER) out_flush(out);
+	}
+}
+
+static void out_char(output * out, char c)
+{
+	if (out->len == OUTPUT_BUFFER) out_flush(out);
+	out->data[out->len++] = c;
+}
+
+static void out_format(output * out, const char * format, ...)
+{
+	char buff[256], * text = buff;
+	va_list ap;
+	int n;
+
+	va_start(ap, format);
+	n = vsnprintf(buff, sizeof(buff), format, ap);
+	va_end(ap);
+	if (n >= (int) sizeof(buff))
+	{
+		text = (char *) malloc(n + 1);
+		if (!text) return;
+		va_start(ap, format);
+		vsnprintf(text, n + 1, format, ap);
+		va_end(ap);
+	}
+	if (n > 0) out_write(out, text, n);
+	if (text != buff) free(text);
+}
+
+/**
+ * Flushes the output and turns a write error into the exit status.
+ **/
+static int out_close(output * out, const char * name, int status)
+{
+	out_flush(out);
+	if (out->error)
+	{
+		dprintf(STDERR_FILENO, "%s: write error: %s\n", name, strerror(out->error));
+		return 1;
+	}
+	return status;
+}
+
+/**
+ * Writes the backslash escape at *s (just after the backslash) and
+ * advances *s past it. Octal escapes are \0NNN for echo and %b (zero_octal)
+ * and \NNN in printf formats.
+ * Returns 1 for \c, which ends all output.
+ **/
+static int write_escape(output * out, const char ** s, int zero_octal)
+{
+	const char * p = *s;
+	int value = 0, digits = 0;
+
+	switch (*p)
+	{
+	case 'a': out_char(out, '\a'); break;
+	case 'b': out_char(out, '\b'); break;
+	case 'c': *s = p + 1; return 1;
+	case 'e': out_char(out, 27); break;
+	case 'f': out_char(out, '\f'); break;
+	case 'n': out_char(out, '\n'); break;
+	case 'r': out_char(out, '\r'); break;
+	case 't': out_char(out, '\t'); break;
+	case 'v': out_char(out, '\v'); break;
+	case '\\': out_char(out, '\\'); break;
+	case 'x':
+		while (digits < 2 && ((p[1] >= '0' && p[1] <= '9') || ((p[1] | 32) >= 'a' && (p[1] | 32) <= 'f')))
+		{
+			p++;
+			value = value * 16 + (*p <= '9' ? *p - '0' : (*p | 32) - 'a' + 10);
+			digits++;
+		}
+		if (digits) out_char(out, (char) value);
+		else out_write(out, "\\x", 2);
+		break;
+	default:
+		if (*p >= '0' && *p <= '7' && (!zero_octal || *p == '0'))
+		{
+			if (zero_octal) p++; /* \0NNN */
+			while (digits < 3 && *p >= '0' && *p <= '7')
+			{
+				value = value * 8 + (*p++ - '0');
+				digits++;
+			}
+			out_char(out, (char) value);
+			*s = p;
+			return 0;
+		}
+		out_char(out, '\\'); /* Not an escape: kept as is */
+		if (*p == '\0')
+		{
+			*s = p;
+			return 0;
+		}
+		out_char(out, *p);
+	}
+	*s = p + 1;
+	return 0;
+}
+
+/**
+ * Writes s interpreting echo escapes. Returns 1 if \c was found.
+ **/
+static int write_escaped(output * out, const char * s)
+{
+	while (*s)
+	{
+		const char * backslash = strchr(s, '\\');
+		if (!backslash)
+		{
+			out_write(out, s, strlen(s));
+			break;
+		}
+		out_write(out, s, backslash - s);
+		s = backslash + 1;
+		if (write_escape(out, &s, 1)) return 1;
+	}
+	return 0;
+}
+
+/**
+ * Built-in command: echo [-n] [-e] [-E] [args...]
+ * -n omits the final newline, -e interprets backslash escapes (-E does not).
+ **/
+static int builtin_echo(int argc, char ** argv, builtin_context * ctx)
+{
+	output out;
+	int newline = 1, escapes = 0, i = 1;
+
+	out.fd = ctx->fd_out;
+	out.len = out.error = 0;
+	/* Options are only recognized if every letter is one of them, as in bash */
+	for (; i < argc && argv[i][0] == '-' && argv[i][1] && strspn(argv[i] + 1, "neE") == strlen(argv[i] + 1); i++)
+	{
+		const char * p;
+		for (p = argv[i] + 1; *p; p++)
+		{
+			if (*p == 'n') newline = 0;
+			else escapes = (*p == 'e');
+		}
+	}
+	for (; i < argc; i++)
+	{
+		if (escapes)
+		{
+			if (write_escaped(&out, argv[i])) return out_close(&out, "echo", 0);
+		}
+		else out_write(&out, argv[i], strlen(argv[i]));
+		if (i < argc - 1) out_char(&out, ' ');
+	}
+	if (newline) out_char(&out, '\n');
+	return out_close(&out, "echo", 0);
+}
+
+/**
+ * Integer argument of printf: a number (decimal, 0octal or 0xhex) or a
+ * quote followed by a character, whose code is the value.
+ * Sets *status to 1 if arg is not a valid number.
+ **/
+static long long printf_integer(const char * arg, int * status)
+{
+	char * end;
+	long long value;
+
+	if (arg == NULL) return 0;
+	if (arg[0] == '\'' || arg[0] == '"') return (unsigned char) arg[1];
+	errno = 0;
+	value = strtoll(arg, &end, 0);
+	if (end == arg || *end || errno)
+	{
+		dprintf(STDERR_FILENO, "printf: %s: invalid number\n", arg);
+		*status = 1;
+	}
+	return value;
+}
+
+/**
+ * Built-in command: printf <format> [args...]
+ * Conversions %d %i %u %o %x %X %c %s %b %f %e %g %E %G %a and %%, with
+ * flags, width and precision ('*' takes them from the arguments), plus the
+ * backslash escapes of the format. The format is reused while arguments
+ * remain; missing arguments are empty strings or zero.
+ **/
+static int builtin_printf(int argc, char ** argv, builtin_context * ctx)
+{
+	output out;
+	char ** args = argv + 2;
+	int num_args = argc - 2, next = 0, status = 0;
+
+	if (argc < 2)
+	{
+		dprintf(STDERR_FILENO, "Usage: printf <format> [args...]\n");
+		return 2;
+	}
+	out.fd = ctx->fd_out;
+	out.len = out.error = 0;
+
+	do
+	{
+		const char * p = argv[1];
+		int round_start = next;
+		while (*p)
+		{
+			char spec[64], * w = spec;
+			const char * arg;
+
+			if (*p == '\\')
+			{
+				p++;
+				if (write_escape(&out, &p, 0)) return out_close(&out, "printf", status);
+				continue;
+			}
+			if (*p != '%')
+			{
+				const char * end = strpbrk(p, "\\%");
+				size_t n = end ? (size_t) (end - p) : strlen(p);
+				out_write(&out, p, n);
+				p += n;
+				continue;
+			}
+			if (p[1] == '%')
+			{
+				out_char(&out, '%');
+				p += 2;
+				continue;
+			}
+
+			/* Conversion specification, rebuilt for snprintf() with '*' resolved */
+			*w++ = *p++;
+			while (*p && strchr("-+ #0", *p) && w < spec + 8) *w++ = *p++;
+			if (*p == '*')
+			{
+				w += sprintf(w, "%d", (int) printf_integer(next < num_args ? args[next++] : NULL, &status));
+				p++;
+			}
+			else while (*p >= '0' && *p <= '9' && w < spec + 24) *w++ = *p++;
+			if (*p == '.')
+			{
+				*w++ = *p++;
+				if (*p == '*')
+				{
+					w += sprintf(w, "%d", (int) printf_integer(next < num_args ? args[next++] : NULL, &status));
+					p++;
+				}
+				else while (*p >= '0' && *p <= '9' && w < spec + 48) *w++ = *p++;
+			}
+			arg = next < num_args ? args[next++] : NULL;
+
+			switch (*p)
+			{
+			case 'd': case 'i':
+				strcpy(w, "lld");
+				out_format(&out, spec, printf_integer(arg, &status));
+				break;
+			case 'u': case 'o': case 'x': case 'X':
+				w[0] = w[1] = 'l';
+				w[2] = *p;
+				w[3] = '\0';
+				out_format(&out, spec, (unsigned long long) printf_integer(arg, &status));
+				break;
+			case 'c':
+				if (arg && *arg) out_char(&out, *arg);
+				break;
+			case 's':
+				strcpy(w, "s");
+				out_format(&out, spec, arg ? arg : "");
+				break;
+			case 'b':
+				if (arg && write_escaped(&out, arg)) return out_close(&out, "printf", status);
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			{
+				char * end = NULL;
+				double value = arg ? strtod(arg, &end) : 0;
+				if (arg && (end == arg || *end))
+				{
+					dprintf(STDERR_FILENO, "printf: %s: invalid number\n", arg);
+					status = 1;
+				}
+				w[0] = *p;
+				w[1] = '\0';
+				out_format(&out, spec, value);
+				break;
+			}
+			default:
+				out_flush(&out);
+				dprintf(STDERR_FILENO, "printf: %%%c: invalid conversion\n", *p ? *p : ' ');
+				return 1;
+			}
+			p++;
+		}
+		if (next == round_start) break; /* The format takes no arguments */
+	} while (next < num_args);
+
+	return out_close(&out, "printf", status);
+}
+
+/* Parser state of test: the arguments and the next one to examine */
+typedef struct test_state_
+{
+	char ** argv;
+	int argc;
+	int pos;
+	int error;      /* 1 after a syntax error, already printed */
+} test_state;
+
+static int test_or(test_state * t);
+
+static int test_syntax_error(test_state * t, const char * message, const char * arg)
+{
+	if (!t->error) dprintf(STDERR_FILENO, "test: %s%s%s\n", arg ? arg : "", arg ? ": " : "", message);
+	t->error = 1;
+	return 0;
+}
+
+static int test_integer(test_state * t, const char * arg, long long * value)
+{
+	char * end;
+	errno = 0;
+	*value = strtoll(arg, &end, 10);
+	while (*end == ' ' || *end == '\t') end++;
+	if (end == arg || *end || errno) return test_syntax_error(t, "integer expression expected", arg);
+	return 1;
+}
+
+static int is_binary_operator(const char * op)
+{
+	static const char * ops[] = { "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt",
+		"-ge", "-nt", "-ot", "-ef", NULL };
+	int i;
+	for (i = 0; ops[i]; i++) if (!strcmp(op, ops[i])) return 1;
+	return 0;
+}
+
+static int test_binary(test_state * t, const char * a, const char * op, const char * b)
+{
+	long long x, y;
+	struct stat sa, sb;
+
+	if (!strcmp(op, "=") || !strcmp(op, "==")) return strcmp(a, b) == 0;
+	if (!strcmp(op, "!=")) return strcmp(a, b) != 0;
+	if (!strcmp(op, "<")) return strcmp(a, b) < 0;
+	if (!strcmp(op, ">")) return strcmp(a, b) > 0;
+	if (!strcmp(op, "-nt") || !strcmp(op, "-ot") || !strcmp(op, "-ef"))
+	{
+		int ha = stat(a, &sa) == 0, hb = stat(b, &sb) == 0;
+		if (!strcmp(op, "-ef")) return ha && hb && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+		if (!strcmp(op, "-nt")) return ha && (!hb || sa.st_mtim.tv_sec > sb.st_mtim.tv_sec ||
+			(sa.st_mtim.tv_sec == sb.st_mtim.tv_sec && sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec));
+		return hb && (!ha || sa.st_mtim.tv_sec < sb.st_mtim.tv_sec ||
+			(sa.st_mtim.tv_sec == sb.st_mtim.tv_sec && sa.st_mtim.tv_nsec < sb.st_mtim.tv_nsec));
+	}
+	if (!test_integer(t, a, &x) || !test_integer(t, b, &y)) return 0;
+	if (!strcmp(op, "-eq")) return x == y;
+	if (!strcmp(op, "-ne")) return x != y;
+	if (!strcmp(op, "-lt")) return x < y;
+	if (!strcmp(op, "-le")) return x <= y;
+	if (!strcmp(op, "-gt")) return x > y;
+	return x >= y;
+}
+
+/**
+ * Evaluates a unary operator. Returns -1 if op is not one.
+ **/
+static int test_unary(const char * op, const char * arg)
+{
+	struct stat st;
+
+	if (op[0] != '-' || !op[1] || op[2]) return -1;
+	switch (op[1])
+	{
+	case 'n': return *arg != '\0';
+	case 'z': return *arg == '\0';
+	case 't': return isatty(atoi(arg));
+	case 'r': return access(arg, R_OK) == 0;
+	case 'w': return access(arg, W_OK) == 0;
+	case 'x': return access(arg, X_OK) == 0;
+	case 'L': case 'h': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+	case 'e': case 'f': case 'd': case 's': case 'b': case 'c': case 'p': case 'S':
+	case 'u': case 'g': case 'k':
+		if (stat(arg, &st) != 0) return 0;
+		switch (op[1])
+		{
+		case 'f': return S_ISREG(st.st_mode);
+		case 'd': return S_ISDIR(st.st_mode);
+		case 's': return st.st_size > 0;
+		case 'b': return S_ISBLK(st.st_mode);
+		case 'c': return S_ISCHR(st.st_mode);
+		case 'p': return S_ISFIFO(st.st_mode);
+		case 'S': return S_ISSOCK(st.st_mode);
+		case 'u': return (st.st_mode & S_ISUID) != 0;
+		case 'g': return (st.st_mode & S_ISGID) != 0;
+		case 'k': return (st.st_mode & S_ISVTX) != 0;
+		default: return 1;
+		}
+	}
+	return -1;
+}
+
+/**
+ * primary := '(' expr ')' | operand binop operand | unop operand | operand
+ * A binary operator is looked for first, so "test -f = -f" compares strings.
+ **/
+static int test_primary(test_state * t)
+{
+	char ** a = t->argv + t->pos;
+	int left = t->argc - t->pos, result;
+
+	if (left <= 0) return test_syntax_error(t, "argument expected", NULL);
+	if (left >= 3 && is_binary_operator(a[1]))
+	{
+		t->pos += 3;
+		return test_binary(t, a[0], a[1], a[2]);
+	}
+	if (!strcmp(a[0], "(") && left >= 2)
+	{
+		t->pos++;
+		result = test_or(t);
+		if (t->pos >= t->argc || strcmp(t->argv[t->pos], ")")) return test_syntax_error(t, "')' expected", NULL);
+		t->pos++;
+		return result;
+	}
+	if (left >= 2 && (result = test_unary(a[0], a[1])) != -1)
+	{
+		t->pos += 2;
+		return result;
+	}
+	if (left >= 2 && a[0][0] == '-' && a[0][1] && !a[0][2] && strcmp(a[1], "-a") && strcmp(a[1], "-o") && strcmp(a[1], ")"))
+		return test_syntax_error(t, "unary operator expected", a[0]);
+	t->pos++;
+	return a[0][0] != '\0'; /* A lone string is true if not empty */
+}
+
+static int test_not(test_state * t)
+{
+	if (t->pos < t->argc - 1 && !strcmp(t->argv[t->pos], "!"))
+	{
+		t->pos++;
+		return !test_not(t);
+	}
+	return test_primary(t);
+}
+
+static int test_and(test_state * t)
+{
+	int result = test_not(t);
+	while (t->pos < t->argc && !strcmp(t->argv[t->pos], "-a"))
+	{
+		t->pos++;
+		result = test_not(t) && result;
+	}
+	return result;
+}
+
+static int test_or(test_state * t)
+{
+	int result = test_and(t);
+	while (t->pos < t->argc && !strcmp(t->argv[t->pos], "-o"))
+	{
+		t->pos++;
+		result = test_and(t) || result;
+	}
+	return result;
+}
+
+/**
+ * Built-in command: test <expression> | [ <expression> ]
+ * Exit status 0 if the expression is true, 1 if false, 2 on syntax errors.
+ **/
+static int builtin_test(int argc, char ** argv, builtin_context * ctx)
+{
+	test_state t = { argv + 1, argc - 1, 0, 0 };
+	int result;
+
+	if (!strcmp(argv[0], "["))
+	{
+		if (argc < 2 || strcmp(argv[argc - 1], "]"))
+		{
+			dprintf(STDERR_FILENO, "[: missing ']'\n");
+			return 2;
+		}
+		t.argc--;
+	}
+	if (t.argc == 0) return 1;
+	result = test_or(&t);
+	if (!t.error && t.pos < t.argc) test_syntax_error(&t, "too many arguments", t.argv[t.pos]);
+	return t.error ? 2 : !result;
+}
+
+static int builtin_true(int argc, char ** argv, builtin_context * ctx)
+{
+	return 0;
+}
+
+static int builtin_false(int argc, char ** argv, builtin_context * ctx)
+{
+	return 1;
+}
+
+/**
+ * Built-in command: pwd
+ **/
+static int builtin_pwd(int argc, char ** argv, builtin_context * ctx)
+{
+	char path[PATH_MAX + 1];
+	size_t len;
+
+	if (!getcwd(path, PATH_MAX))
+	{
+		dprintf(STDERR_FILENO, "pwd: %s\n", strerror(errno));
+		return 1;
+	}
+	len = strlen(path);
+	path[len++] = '\n';
+	return write(ctx->fd_out, path, len) == (ssize_t) len ? 0 : 1;
+}
+
+/**
+ * Signal number of a name (TERM, SIGTERM, term) or number, -1 if unknown
+ **/
+static int signal_number(const char * name)
+{
+	int sig;
+	if (*name >= '0' && *name <= '9')
+	{
+		char * end;
+		sig = (int) strtol(name, &end, 10);
+		return *end || sig >= NSIG ? -1 : sig;
+	}
+	if (!strncasecmp(name, "SIG", 3)) name += 3;
+	for (sig = 1; sig < NSIG; sig++)
+	{
+		const char * abbrev = sigabbrev_np(sig);
+		if (abbrev && !strcasecmp(name, abbrev)) return sig;
+	}
+	return -1;
+}
+
+/**
+ * Built-in command: kill [-s SIG | -SIG] <pid | %n> ...  |  kill -l [status]
+ * Sends a signal (TERM by default) to processes or to the process group of
+ * job n of the job list (as numbered by jobs). A stopped job is also
+ * continued when it is sent TERM or HUP, so it can act on them.
+ * -l lists the signal names, or gives the name of the signal of an exit
+ * status (128 + N).
+ **/
+static int builtin_kill(int argc, char ** argv, builtin_context * ctx)
+{
+	int sig = SIGTERM, status = 0, i = 1;
+
+	if (argc > 1 && !strcmp(argv[1], "-l"))
+	{
+		output out;
+		out.fd = ctx->fd_out;
+		out.len = out.error = 0;
+		if (argc > 2)
+		{
+			int n = atoi(argv[2]);
+			if (n > 128) n -= 128;
+			if (n <= 0 || n >= NSIG || !sigabbrev_np(n))
+			{
+				dprintf(STDERR_FILENO, "kill: %s: invalid signal specification\n", argv[2]);
+				return 1;
+			}
+			out_format(&out, "%s\n", sigabbrev_np(n));
+		}
+		else
+		{
+			int n;
+			for (n = 1; n < SIGRTMIN; n++)
+				if (sigabbrev_np(n)) out_format(&out, "%2d) SIG%s\n", n, sigabbrev_np(n));
+		}
+		return out_close(&out, "kill", 0);
+	}
+
+	if (i < argc && (!strcmp(argv[i], "-s") || !strcmp(argv[i], "-n")))
+	{
+		sig = i + 1 < argc ? signal_number(argv[i + 1]) : -1;
+		if (sig == -1)
+		{
+			dprintf(STDERR_FILENO, "kill: %s: invalid signal specification\n", i + 1 < argc ? argv[i + 1] : "");
+			return 1;
+		}
+		i += 2;
+	}
+	else if (i < argc && argv[i][0] == '-' && argv[i][1] && strcmp(argv[i], "--"))
+	{
+		sig = signal_number(argv[i] + 1);
+		if (sig == -1)
+		{
+			dprintf(STDERR_FILENO, "kill: %s: invalid signal specification\n", argv[i] + 1);
+			return 1;
+		}
+		i++;
+	}
+	if (i < argc && !strcmp(argv[i], "--")) i++;
+	if (i >= argc)
+	{
+		dprintf(STDERR_FILENO, "Usage: kill [-s SIG | -SIG] <pid | %%n> ... | kill -l [status]\n");
+		return 2;
+	}
+
+	for (; i < argc; i++)
+	{
+		char * end;
+		if (argv[i][0] == '%')
+		{
+			builtin_job job;
+			int pos = (int) strtol(argv[i] + 1, &end, 10);
+			if (argv[i][1] == '\0') pos = 1, end = argv[i] + 1; /* % is the current job */
+			if (*end || !ctx->get_job(pos, &job))
+			{
+				dprintf(STDERR_FILENO, "kill: %s: no such job\n", argv[i]);
+				status = 1;
+				continue;
+			}
+			if (killpg(job.pgid, sig) == -1)
+			{
+				dprintf(STDERR_FILENO, "kill: %s: %s\n", argv[i], strerror(errno));
+				status = 1;
+			}
+			else if (job.state == BUILTIN_JOB_STOPPED && (sig == SIGTERM || sig == SIGHUP))
+				killpg(job.pgid, SIGCONT);
+		}
+		else
+		{
+			pid_t pid = (pid_t) strtol(argv[i], &end, 10);
+			if (end == argv[i] || *end)
+			{
+				dprintf(STDERR_FILENO, "kill: %s: arguments must be process or job IDs\n", argv[i]);
+				status = 1;
+			}
+			else if (kill(pid, sig) == -1)
+			{
+				dprintf(STDERR_FILENO, "kill: (%d) - %s\n", (int) pid, strerror(errno));
+				status = 1;
+			}
+		}
+	}
+	return status;
+}
+
+/**
+ * Returns 1 if def is one of the utilities. They have no job control of
+ * their own: with & the shell runs them in a background job.
+ **/
+int is_utility_builtin(const builtin_definition * def)
+{
+	return def->function == builtin_echo || def->function == builtin_printf || def->function == builtin_test ||
+		def->function == builtin_true || def->function == builtin_false || def->function == builtin_pwd ||
+		def->function == builtin_kill;
+}
+
+/**
+ * Registers the utilities. The shell's own builtins are registered after
+ * them, so a name in both runs the shell's one.
+ **/
+void register_utility_builtins(void)
+{
+	register_builtin("echo", builtin_echo, "echo [-neE] [args...]");
+	register_builtin("printf", builtin_printf, "printf <format> [args...]");
+	register_builtin("test", builtin_test, "test <expression>");
+	register_builtin("[", builtin_test, "[ <expression> ]");
+	register_builtin("true", builtin_true, "true");
+	register_builtin("false", builtin_false, "false");
+	register_builtin("pwd", builtin_pwd, "pwd");
+	register_builtin("kill", builtin_kill, "kill [-s SIG | -SIG] <pid | %n> ... | kill -l [status]");
+}
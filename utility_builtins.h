@@ -0,0 +1,29 @@
+// FELIPE OEHLER GUZMÁN
+
+/**
+ * Linux Job Control Shell Project
+ * Function prototypes for the utility_builtins module
+ *
+ * Native versions of small utilities that scripts run over and over: echo,
+ * printf, test (and [), true, false, pwd and kill. They run inside the
+ * shell, with no fork() or exec(), and write to the descriptors of their
+ * builtin_context, so redirections work as for the external programs.
+ * They only use the builtin ABI (builtin_registry.h), as a loaded library
+ * would.
+ *
+ * Operating Systems
+ * Grados Ing. Informatica & Software
+ * Dept. de Arquitectura de Computadores - UMA
+ **/
+#ifndef _UTILITY_BUILTINS_H
+#define _UTILITY_BUILTINS_H
+
+#include "builtin_registry.h"
+
+/**
+ * Public Functions
+ **/
+void register_utility_builtins(void);
+int is_utility_builtin(const builtin_definition * def);
+
+#endif